@@ -2374,6 +2374,10 @@ static const uint8_t rewind_fetch_tab[] = {
 
         SET_LAST_ADDR(reg_pc);
 
+        if (monitor_coverage_exec[CALLER] != NULL) {
+            monitor_coverage_exec_hit(CALLER, (uint16_t)reg_pc);
+        }
+
         /* HACK: The real CPU would stop fetching opcodes all together when
          * "jammed" - however, our code may rely on FETCH_OPCODE being called
          * here, so we can not simply skip it. What we do instead is remembering
@@ -1647,6 +1647,11 @@
 #endif
 #endif
         SET_LAST_ADDR(reg_pc);
+
+        if (monitor_coverage_exec[CALLER] != NULL) {
+            monitor_coverage_exec_hit(CALLER, (uint16_t)reg_pc);
+        }
+
         FETCH_OPCODE(opcode);
 
 #ifdef FEATURE_CPUMEMHISTORY
@@ -54,6 +54,7 @@ void alarm_context_init(alarm_context_t *context, const char *name)
 
     context->num_pending_alarms = 0;
     context->next_pending_alarm_clk = CLOCK_MAX;
+    context->next_pending_alarm_idx = -1;
 }
 
 void alarm_context_destroy(alarm_context_t *context)
@@ -164,6 +165,35 @@ void alarm_destroy(alarm_t *alarm)
     lib_free(alarm);
 }
 
+#ifdef ALARM_HEAP
+
+void alarm_unset(alarm_t *alarm)
+{
+    alarm_context_t *context;
+    unsigned int last;
+    int idx;
+
+    idx = alarm->pending_idx;
+
+    if (idx < 0) {
+        return;                 /* Not pending.  */
+    }
+    context = alarm->context;
+
+    /* Fill the hole with the last entry of the heap and put that one back
+       in order.  */
+    last = --context->num_pending_alarms;
+    if ((unsigned int)idx != last) {
+        context->pending_alarms[idx] = context->pending_alarms[last];
+        alarm_context_heap_sift(context, (unsigned int)idx);
+    }
+    alarm_context_update_next_pending(context);
+
+    alarm->pending_idx = -1;
+}
+
+#else
+
 void alarm_unset(alarm_t *alarm)
 {
     alarm_context_t *context;
@@ -206,6 +236,8 @@ void alarm_unset(alarm_t *alarm)
     alarm->pending_idx = -1;
 }
 
+#endif
+
 void alarm_log_too_many_alarms(void)
 {
     log_error(LOG_DEFAULT, "alarm_set(): Too many alarms set!");
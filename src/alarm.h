@@ -107,6 +107,69 @@ inline static CLOCK alarm_context_next_pending_clk(alarm_context_t *context)
     return context->next_pending_alarm_clk;
 }
 
+#ifdef ALARM_HEAP
+
+/* With ALARM_HEAP (configure --enable-alarm-heap) the pending alarm array is
+   kept as a binary min-heap ordered by clock, so setting, modifying and
+   unsetting an alarm costs O(log n) instead of a scan over all pending
+   alarms.  `pending_idx' is the position of the alarm in the heap and the
+   next pending alarm is always the one at index 0.  */
+
+/* Move the entry at `idx' up or down until the heap order holds again.  */
+inline static void alarm_context_heap_sift(alarm_context_t *context,
+                                           unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    unsigned int num = context->num_pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
+
+    while (idx > 0) {
+        unsigned int parent = (idx - 1) >> 1;
+
+        if (heap[parent].clk <= clk) {
+            break;
+        }
+        heap[idx] = heap[parent];
+        heap[idx].alarm->pending_idx = (int)idx;
+        idx = parent;
+    }
+
+    while (1) {
+        unsigned int child = (idx << 1) + 1;
+
+        if (child >= num) {
+            break;
+        }
+        if (child + 1 < num && heap[child + 1].clk < heap[child].clk) {
+            child++;
+        }
+        if (heap[child].clk >= clk) {
+            break;
+        }
+        heap[idx] = heap[child];
+        heap[idx].alarm->pending_idx = (int)idx;
+        idx = child;
+    }
+
+    heap[idx].alarm = alarm;
+    heap[idx].clk = clk;
+    alarm->pending_idx = (int)idx;
+}
+
+inline static void alarm_context_update_next_pending(alarm_context_t *context)
+{
+    if (context->num_pending_alarms > 0) {
+        context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+        context->next_pending_alarm_idx = 0;
+    } else {
+        context->next_pending_alarm_clk = CLOCK_MAX;
+        context->next_pending_alarm_idx = -1;
+    }
+}
+
+#else
+
 inline static void alarm_context_update_next_pending(alarm_context_t *context)
 {
     CLOCK next_pending_alarm_clk = CLOCK_MAX;
@@ -128,6 +191,8 @@ inline static void alarm_context_update_next_pending(alarm_context_t *context)
     context->next_pending_alarm_idx = next_pending_alarm_idx;
 }
 
+#endif
+
 inline static void alarm_context_dispatch(alarm_context_t *context,
                                           CLOCK cpu_clk)
 {
@@ -143,6 +208,36 @@ inline static void alarm_context_dispatch(alarm_context_t *context,
     (alarm->callback)(offset, alarm->data);
 }
 
+#ifdef ALARM_HEAP
+
+inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
+{
+    alarm_context_t *context;
+    int idx;
+
+    context = alarm->context;
+    idx = alarm->pending_idx;
+
+    if (idx < 0) {
+        /* Not pending yet: add at the bottom of the heap.  */
+
+        idx = (int)(context->num_pending_alarms);
+        if (idx >= (int)ALARM_CONTEXT_MAX_PENDING_ALARMS) {
+            alarm_log_too_many_alarms();
+            return;
+        }
+
+        context->pending_alarms[idx].alarm = alarm;
+        context->num_pending_alarms++;
+    }
+
+    context->pending_alarms[idx].clk = cpu_clk;
+    alarm_context_heap_sift(context, (unsigned int)idx);
+    alarm_context_update_next_pending(context);
+}
+
+#else
+
 inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
 {
     alarm_context_t *context;
@@ -185,3 +280,5 @@ inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
 }
 
 #endif
+
+#endif
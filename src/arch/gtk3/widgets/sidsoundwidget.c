@@ -136,6 +136,7 @@ static const vice_gtk3_radiogroup_entry_t resid_sampling_modes[] = {
     { "Interpolation",   SID_RESID_SAMPLING_INTERPOLATION },
     { "Resampling",      SID_RESID_SAMPLING_RESAMPLING },
     { "Fast resampling", SID_RESID_SAMPLING_FAST_RESAMPLING },
+    { "Two-stage resampling", SID_RESID_SAMPLING_TWOSTAGE_RESAMPLING },
     { NULL,              -1 }
 };
 #endif
@@ -0,0 +1,388 @@
+/** \file   forkserver.c
+ * \brief   Headless fork server
+ *
+ * Starting an emulator instance means loading ROMs, setting up resources
+ * and letting the KERNAL boot to READY, which is paid again by every
+ * instance of a large fleet. With -forkserver the headless emulator does
+ * all that once, stops at the first frame that shows the READY prompt and
+ * listens on a control socket instead of running on. Each connection
+ * fork()s a copy of the booted machine, sharing ROMs and machine tables
+ * copy-on-write with the server.
+ *
+ * The control protocol is line based: the client sends the address the
+ * new instance's binary monitor should listen on, e.g.
+ * "ip4://127.0.0.1:6510\n". The child binds its binary monitor there and
+ * then answers with its pid, or -1 if that failed, before it continues
+ * emulating. The server keeps the booted machine paused and never runs it.
+ *
+ * With -binarymonitorshm each child exports its frames to an object of its
+ * own, the server's name followed by "-<pid>", instead of writing into the
+ * server's mapping.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(HAVE_FORK) && defined(HAVE_NETWORK)
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "archdep.h"
+#include "autostart.h"
+#include "cmdline.h"
+#include "lib.h"
+#include "log.h"
+#include "resources.h"
+#include "sound.h"
+#include "util.h"
+#include "vicesocket.h"
+#include "vsync.h"
+
+#include "forkserver.h"
+
+#if defined(HAVE_FORK) && defined(HAVE_NETWORK)
+
+/* how long a client may take to send its request line */
+#define FORKSERVER_REQUEST_US   1000000
+
+/* maximum length of a request line */
+#define FORKSERVER_REQUEST_MAX  256
+
+/* control connections whose request line is still arriving */
+#define FORKSERVER_PENDING_MAX  8
+
+typedef struct forkserver_pending_s {
+    vice_network_socket_t *conn;
+    char request[FORKSERVER_REQUEST_MAX];
+    size_t len;
+    tick_t start;
+} forkserver_pending_t;
+
+static forkserver_pending_t pending[FORKSERVER_PENDING_MAX];
+
+static char *fork_server_address = NULL;
+
+/* set once the server has run, the children must never start it again */
+static int fork_server_done = 0;
+
+static log_t forkserver_log = LOG_DEFAULT;
+
+
+/** \brief  Read what arrived of the request line of a control connection
+ *
+ * Only reads what is there, a client that sends its request slowly must
+ * not hold up the others.
+ *
+ * \param[in,out]  p   control connection, the line is terminated in place
+ *                      without the line terminator once complete
+ *
+ * \return  1 once the line is complete, 0 while it is not, -1 on error or
+ *          if the line is too long
+ */
+static int forkserver_read_request(forkserver_pending_t *p)
+{
+    char *eol;
+    ssize_t n;
+
+    n = vice_network_receive(p->conn, p->request + p->len, sizeof p->request - 1 - p->len, 0);
+    if (n <= 0) {
+        return -1;
+    }
+    p->len += (size_t)n;
+
+    eol = memchr(p->request, '\n', p->len);
+    if (eol == NULL) {
+        return (p->len < sizeof p->request - 1) ? 0 : -1;
+    }
+    if (eol > p->request && eol[-1] == '\r') {
+        eol--;
+    }
+    *eol = 0;
+
+    return (eol > p->request) ? 1 : -1;
+}
+
+
+static void forkserver_reply(vice_network_socket_t *conn, long pid)
+{
+    char reply[32];
+
+    sprintf(reply, "%ld\n", pid);
+    vice_network_send(conn, reply, strlen(reply), 0);
+}
+
+
+/** \brief  Collect the exit status of finished instances
+ */
+static void forkserver_reap(void)
+{
+    pid_t pid;
+    int status;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        log_message(forkserver_log, "Instance %ld exited with status %d.",
+                    (long)pid, WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    }
+}
+
+
+/** \brief  Turn a freshly forked child into an independent instance
+ *
+ * \param[in]   conn    control connection, closed on return
+ * \param[in]   address binary monitor address for this instance
+ */
+static void forkserver_child(vice_network_socket_t *conn, const char *address)
+{
+    const char *shm_name = NULL;
+    char *instance_shm_name;
+    int i;
+
+    /* the requests still arriving belong to the server */
+    for (i = 0; i < FORKSERVER_PENDING_MAX; i++) {
+        if (pending[i].conn != NULL && pending[i].conn != conn) {
+            vice_network_socket_close(pending[i].conn);
+        }
+        pending[i].conn = NULL;
+    }
+
+    /* the mapping of the server is shared, export to an object of our own */
+    resources_get_string("BinaryMonitorShm", &shm_name);
+    if (shm_name != NULL && *shm_name != 0) {
+        instance_shm_name = lib_msprintf("%s-%ld", shm_name, (long)getpid());
+        if (resources_set_string("BinaryMonitorShm", instance_shm_name) < 0) {
+            resources_set_string("BinaryMonitorShm", "");
+            log_error(forkserver_log, "Could not export frames to %s.", instance_shm_name);
+        }
+        lib_free(instance_shm_name);
+    }
+
+    /* disable first so a failing bind is reported by the enable below */
+    resources_set_int("BinaryMonitorServer", 0);
+    if (resources_set_string("BinaryMonitorServerAddress", address) < 0
+        || resources_set_int("BinaryMonitorServer", 1) < 0) {
+        log_error(forkserver_log, "Could not start binary monitor on %s.", address);
+        forkserver_reply(conn, -1);
+        vice_network_socket_close(conn);
+        /* remove our own export, the atexit handlers that would are skipped
+           since they belong to the server */
+        resources_set_string("BinaryMonitorShm", "");
+        _exit(1);
+    }
+
+    forkserver_reply(conn, (long)getpid());
+    vice_network_socket_close(conn);
+
+    /* the time spent waiting in the server must not be caught up */
+    vsync_suspend_speed_eval();
+}
+
+
+/** \brief  Serve fork requests until a child returns from this function
+ *
+ * Only returns in a new instance, or if the control socket cannot be set
+ * up, in which case emulation simply goes on.
+ */
+static void forkserver_serve(void)
+{
+    vice_network_socket_address_t *server_addr;
+    vice_network_socket_t *server;
+
+    server_addr = vice_network_address_generate(fork_server_address, 0);
+    if (server_addr == NULL) {
+        log_error(forkserver_log, "Invalid address %s.", fork_server_address);
+        return;
+    }
+    server = vice_network_server(server_addr);
+    vice_network_address_close(server_addr);
+    if (server == NULL) {
+        log_error(forkserver_log, "Could not listen on %s.", fork_server_address);
+        return;
+    }
+
+    /* the sound device may run threads of its own, which fork() does not
+       duplicate, so each instance opens its own device again */
+    sound_close();
+
+    log_message(forkserver_log, "Machine ready, forking instances on %s.", fork_server_address);
+
+    while (1) {
+        vice_network_socket_t *sockets[FORKSERVER_PENDING_MAX + 2];
+        forkserver_pending_t *p;
+        int count = 0;
+        int free_slot = -1;
+        int result;
+        int i;
+        pid_t pid;
+
+        forkserver_reap();
+
+        /* wait up to 250ms for a connection or more of a request */
+        for (i = 0; i < FORKSERVER_PENDING_MAX; i++) {
+            if (pending[i].conn != NULL) {
+                sockets[count++] = pending[i].conn;
+            } else if (free_slot < 0) {
+                free_slot = i;
+            }
+        }
+        if (free_slot >= 0) {
+            sockets[count++] = server;
+        }
+        sockets[count] = NULL;
+        vice_network_select_multiple(sockets);
+
+        if (free_slot >= 0 && vice_network_select_poll_one(server) > 0) {
+            p = &pending[free_slot];
+            p->conn = vice_network_accept(server);
+            p->len = 0;
+            p->start = tick_now();
+        }
+
+        for (i = 0; i < FORKSERVER_PENDING_MAX; i++) {
+            p = &pending[i];
+            if (p->conn == NULL) {
+                continue;
+            }
+
+            result = 0;
+            if (vice_network_select_poll_one(p->conn) > 0) {
+                result = forkserver_read_request(p);
+            }
+            if (result == 0
+                && tick_now_delta(p->start) > (tick_t)((double)FORKSERVER_REQUEST_US * tick_per_second() / 1000000)) {
+                result = -1;
+            }
+            if (result == 0) {
+                continue;
+            }
+            if (result < 0) {
+                vice_network_socket_close(p->conn);
+                p->conn = NULL;
+                continue;
+            }
+
+            /* don't let the instance write out our buffered output again */
+            fflush(NULL);
+            pid = fork();
+            if (pid == 0) {
+                vice_network_socket_close(server);
+                forkserver_child(p->conn, p->request);
+                return;
+            }
+
+            if (pid < 0) {
+                log_error(forkserver_log, "fork() failed: %s.", strerror(errno));
+                forkserver_reply(p->conn, -1);
+            } else {
+                log_message(forkserver_log, "Instance %ld for %s.", (long)pid, p->request);
+            }
+            vice_network_socket_close(p->conn);
+            p->conn = NULL;
+        }
+    }
+}
+
+
+/** \brief  Start the fork server once the machine has booted
+ *
+ * Called once per frame from vsyncarch_postsync().
+ */
+void forkserver_check(void)
+{
+    if (fork_server_done || fork_server_address == NULL || *fork_server_address == 0) {
+        return;
+    }
+    if (!autostart_ready_prompt()) {
+        return;
+    }
+
+    fork_server_done = 1;
+    forkserver_log = log_open("ForkServer");
+    forkserver_serve();
+}
+
+
+static int set_fork_server_address(const char *val, void *param)
+{
+    util_string_set(&fork_server_address, val);
+
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "ForkServerAddress", "", RES_EVENT_NO, NULL,
+      &fork_server_address, set_fork_server_address, NULL },
+    RESOURCE_STRING_LIST_END
+};
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-forkserver", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "ForkServerAddress", NULL,
+      "<Name>", "Boot, then fork an instance for each connection to this address" },
+    CMDLINE_LIST_END
+};
+
+
+int forkserver_resources_init(void)
+{
+    return resources_register_string(resources_string);
+}
+
+void forkserver_resources_shutdown(void)
+{
+    lib_free(fork_server_address);
+    fork_server_address = NULL;
+}
+
+int forkserver_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
+#else
+
+void forkserver_check(void)
+{
+}
+
+int forkserver_resources_init(void)
+{
+    return 0;
+}
+
+void forkserver_resources_shutdown(void)
+{
+}
+
+int forkserver_cmdline_options_init(void)
+{
+    return 0;
+}
+
+#endif
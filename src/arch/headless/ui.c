@@ -67,6 +67,7 @@
 /* for the fullscreen_capability() stub */
 #include "fullscreen.h"
 
+#include "forkserver.h"
 #include "ui.h"
 
 
@@ -103,7 +104,11 @@ int ui_cmdline_options_init(void)
 {
     /* printf("%s\n", __func__); */
 
-    return cmdline_register_options(cmdline_options_common);
+    if (cmdline_register_options(cmdline_options_common) < 0) {
+        return -1;
+    }
+
+    return forkserver_cmdline_options_init();
 }
 
 
@@ -224,7 +229,7 @@ int ui_resources_init(void)
         return -1;
     }
 
-    return 0;
+    return forkserver_resources_init();
 }
 
 
@@ -233,6 +238,8 @@ int ui_resources_init(void)
 void ui_resources_shutdown(void)
 {
     /* log_verbose(LOG_DEFAULT, "%s", __func__); */
+
+    forkserver_resources_shutdown();
 }
 
 /** \brief Clean up memory used by the UI system itself
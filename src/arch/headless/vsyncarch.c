@@ -30,6 +30,7 @@
 
 #include "vice.h"
 
+#include "forkserver.h"
 #include "kbdbuf.h"
 #include "mainlock.h"
 #include "ui.h"
@@ -75,6 +76,8 @@ void vsyncarch_postsync(void)
         ui_pause_enable();
         pause_pending = 0;
     }
+
+    forkserver_check();
 }
 
 void vsyncarch_advance_frame(void)
@@ -89,6 +89,11 @@ static const ui_menu_entry_t sid_sampling_menu[] = {
         .callback = radio_SidResidSampling_callback,
         .data     = (ui_callback_data_t)SID_RESID_SAMPLING_FAST_RESAMPLING
     },
+    {   .string   = "Two-stage Resampling",
+        .type     = MENU_ENTRY_RESOURCE_RADIO,
+        .callback = radio_SidResidSampling_callback,
+        .data     = (ui_callback_data_t)SID_RESID_SAMPLING_TWOSTAGE_RESAMPLING
+    },
     SDL_MENU_LIST_END
 };
 
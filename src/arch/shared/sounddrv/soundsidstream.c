@@ -0,0 +1,344 @@
+/** \file   soundsidstream.c
+ * \brief   Binary stream of sound chip writes
+ *
+ * Like the dump device this records every write to the sound chips instead
+ * of playing anything, but as compact binary records collected in a block
+ * buffer, optionally deflated, so multi-hour captures stay small and cheap.
+ * The stream can go to a file, a FIFO or a Unix domain socket, so another
+ * process, e.g. one driving a real SID over ASID, can consume it live.
+ *
+ * -soundarg selects the target: "[z:]<path>" writes a file or FIFO,
+ * "[z:]unix://<path>" connects to a listening Unix domain socket, and the
+ * "z:" prefix deflates the stream. The default is "vicesnd.sidstream".
+ *
+ * The stream starts with a 16 byte header, all values little endian:
+ *
+ *   0  "VSST"
+ *   4  version (1)
+ *   5  flags, bit 0: everything after the header is a zlib stream
+ *   6  reserved (0, 2 bytes)
+ *   8  machine cycles per second (4 bytes)
+ *   12 reserved (0, 4 bytes)
+ *
+ * followed by one record per write, with unsigned LEB128 varints:
+ *
+ *   varint  cycles since the previous write
+ *   varint  (address << 3) | chip number
+ *   byte    value
+ *   varint  cycles since the last IRQ
+ *   varint  cycles since the last NMI
+ *
+ * Live targets get whatever is buffered at least once per emulated frame,
+ * a zlib stream is sync-flushed at that point so the reader can decode it.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#else
+/* only tell how to flush the stream */
+#define Z_NO_FLUSH      0
+#define Z_SYNC_FLUSH    2
+#define Z_FINISH        4
+#endif
+
+#include "log.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "sound.h"
+#include "types.h"
+#include "vicesocket.h"
+
+#define SIDSTREAM_MAGIC         "VSST"
+#define SIDSTREAM_VERSION       1
+#define SIDSTREAM_FLAG_ZLIB     0x01
+#define SIDSTREAM_HEADER_SIZE   16
+
+#define SIDSTREAM_BLOCK_SIZE    0x10000
+
+/* longest record: three 64 bit varints, a 19 bit varint and a byte */
+#define SIDSTREAM_RECORD_MAX    (3 * 10 + 3 + 1)
+
+static FILE *sidstream_fd = NULL;
+#ifdef HAVE_NETWORK
+static vice_network_socket_t *sidstream_socket = NULL;
+#endif
+static int sidstream_live = 0;
+
+static uint8_t sidstream_block[SIDSTREAM_BLOCK_SIZE];
+static size_t sidstream_used = 0;
+static CLOCK sidstream_flush_clk = 0;
+
+#ifdef HAVE_ZLIB
+static int sidstream_zlib = 0;
+static z_stream sidstream_z;
+static uint8_t sidstream_zblock[SIDSTREAM_BLOCK_SIZE];
+#endif
+
+static log_t sidstream_log = LOG_DEFAULT;
+
+static int sidstream_send(const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return 0;
+    }
+#ifdef HAVE_NETWORK
+    if (sidstream_socket != NULL) {
+        return (vice_network_send(sidstream_socket, data, len, 0) == (ssize_t)len) ? 0 : -1;
+    }
+#endif
+    if (fwrite(data, 1, len, sidstream_fd) != len) {
+        return -1;
+    }
+    return sidstream_live ? fflush(sidstream_fd) : 0;
+}
+
+/* pass the block on, deflated if requested, with zflush Z_NO_FLUSH, Z_SYNC_FLUSH or Z_FINISH */
+static int sidstream_flush(int zflush)
+{
+    int result = 0;
+
+#ifdef HAVE_ZLIB
+    if (sidstream_zlib) {
+        int zresult;
+
+        sidstream_z.next_in = sidstream_block;
+        sidstream_z.avail_in = (uInt)sidstream_used;
+        do {
+            sidstream_z.next_out = sidstream_zblock;
+            sidstream_z.avail_out = sizeof sidstream_zblock;
+            zresult = deflate(&sidstream_z, zflush);
+            if (zresult == Z_STREAM_ERROR) {
+                return -1;
+            }
+            if (sidstream_send(sidstream_zblock, sizeof sidstream_zblock - sidstream_z.avail_out) < 0) {
+                result = -1;
+            }
+        } while (sidstream_z.avail_out == 0);
+        sidstream_used = 0;
+        return result;
+    }
+#endif
+
+    result = sidstream_send(sidstream_block, sidstream_used);
+    sidstream_used = 0;
+    return result;
+}
+
+static void sidstream_put_varint(uint64_t value)
+{
+    while (value >= 0x80) {
+        sidstream_block[sidstream_used++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    sidstream_block[sidstream_used++] = (uint8_t)value;
+}
+
+static int sidstream_open_target(const char *target)
+{
+#ifdef HAVE_NETWORK
+    if (strncmp(target, "unix://", sizeof "unix://" - 1) == 0) {
+        vice_network_socket_address_t *address;
+
+        address = vice_network_address_generate(target, 0);
+        if (address == NULL) {
+            log_error(sidstream_log, "Invalid address %s.", target);
+            return -1;
+        }
+        sidstream_socket = vice_network_client(address);
+        vice_network_address_close(address);
+        if (sidstream_socket == NULL) {
+            log_error(sidstream_log, "Could not connect to %s.", target);
+            return -1;
+        }
+        sidstream_live = 1;
+        return 0;
+    }
+#endif
+
+    /* blocks until a reader opens a FIFO */
+    sidstream_fd = fopen(target, "wb");
+    if (sidstream_fd == NULL) {
+        log_error(sidstream_log, "Could not open %s.", target);
+        return -1;
+    }
+#ifdef S_ISFIFO
+    {
+        struct stat st;
+
+        if (fstat(fileno(sidstream_fd), &st) == 0 && S_ISFIFO(st.st_mode)) {
+            sidstream_live = 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+static void sidstream_close_target(void)
+{
+#ifdef HAVE_NETWORK
+    if (sidstream_socket != NULL) {
+        vice_network_socket_close(sidstream_socket);
+        sidstream_socket = NULL;
+    }
+#endif
+    if (sidstream_fd != NULL) {
+        fclose(sidstream_fd);
+        sidstream_fd = NULL;
+    }
+    sidstream_live = 0;
+}
+
+static int sidstream_init(const char *param, int *speed, int *fragsize, int *fragnr, int *channels)
+{
+    uint8_t header[SIDSTREAM_HEADER_SIZE];
+    const char *target = param;
+    uint32_t cycles = (uint32_t)machine_get_cycles_per_second();
+    int flags = 0;
+
+    if (sidstream_log == LOG_DEFAULT) {
+        sidstream_log = log_open("SIDStream");
+    }
+
+    /* No stereo capability. */
+    *channels = 1;
+
+    if (target == NULL || *target == 0) {
+        target = "vicesnd.sidstream";
+    }
+    if (strncmp(target, "z:", 2) == 0) {
+        target += 2;
+#ifdef HAVE_ZLIB
+        flags |= SIDSTREAM_FLAG_ZLIB;
+#else
+        log_warning(sidstream_log, "No zlib support, writing %s uncompressed.", target);
+#endif
+    }
+
+    if (sidstream_open_target(target) < 0) {
+        return -1;
+    }
+
+    memset(header, 0, sizeof header);
+    memcpy(header, SIDSTREAM_MAGIC, 4);
+    header[4] = SIDSTREAM_VERSION;
+    header[5] = (uint8_t)flags;
+    header[8] = (uint8_t)cycles;
+    header[9] = (uint8_t)(cycles >> 8);
+    header[10] = (uint8_t)(cycles >> 16);
+    header[11] = (uint8_t)(cycles >> 24);
+    if (sidstream_send(header, sizeof header) < 0) {
+        sidstream_close_target();
+        return -1;
+    }
+
+#ifdef HAVE_ZLIB
+    sidstream_zlib = (flags & SIDSTREAM_FLAG_ZLIB) != 0;
+    if (sidstream_zlib) {
+        memset(&sidstream_z, 0, sizeof sidstream_z);
+        if (deflateInit(&sidstream_z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            sidstream_close_target();
+            return -1;
+        }
+    }
+#endif
+
+    sidstream_used = 0;
+    sidstream_flush_clk = maincpu_clk;
+
+    log_message(sidstream_log, "Writing %s%s.", target, (flags & SIDSTREAM_FLAG_ZLIB) ? ", deflated" : "");
+    return 0;
+}
+
+/* called once per sound fragment, used to keep live readers up to date */
+static int sidstream_write(int16_t *pbuf, size_t nr)
+{
+    if (!sidstream_live || sidstream_used == 0) {
+        return 0;
+    }
+    if (maincpu_clk - sidstream_flush_clk < (CLOCK)machine_get_cycles_per_frame()) {
+        return 0;
+    }
+    sidstream_flush_clk = maincpu_clk;
+
+    return sidstream_flush(Z_SYNC_FLUSH);
+}
+
+static int sidstream_dump2(CLOCK clks, CLOCK irq_clks, CLOCK nmi_clks, uint8_t chipno, uint16_t addr, uint8_t byte)
+{
+    if (sidstream_used > sizeof sidstream_block - SIDSTREAM_RECORD_MAX) {
+        if (sidstream_flush(Z_NO_FLUSH) < 0) {
+            return -1;
+        }
+    }
+
+    sidstream_put_varint(clks);
+    sidstream_put_varint(((uint32_t)addr << 3) | (chipno & 7));
+    sidstream_block[sidstream_used++] = byte;
+    sidstream_put_varint(irq_clks);
+    sidstream_put_varint(nmi_clks);
+
+    return 0;
+}
+
+static void sidstream_close(void)
+{
+    if (sidstream_flush(Z_FINISH) < 0) {
+        log_error(sidstream_log, "Error writing the end of the stream.");
+    }
+#ifdef HAVE_ZLIB
+    if (sidstream_zlib) {
+        deflateEnd(&sidstream_z);
+        sidstream_zlib = 0;
+    }
+#endif
+    sidstream_close_target();
+}
+
+static const sound_device_t sidstream_device =
+{
+    "sidstream",
+    sidstream_init,
+    sidstream_write,
+    NULL,
+    sidstream_dump2,
+    NULL,
+    NULL,
+    sidstream_close,
+    NULL,
+    NULL,
+    0,
+    1,
+    false
+};
+
+int sound_init_sidstream_device(void)
+{
+    return sound_register_device(&sidstream_device);
+}
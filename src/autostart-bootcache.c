@@ -0,0 +1,205 @@
+/** \file   autostart-bootcache.c
+ * \brief   Cache of machines booted to the READY prompt for autostart
+ *
+ * Autostarting a disk image or program file resets the machine and waits
+ * for the KERNAL to boot to the READY prompt before it types LOAD. With
+ * AutostartBootCache autostart saves a snapshot of the machine at that
+ * prompt the first time, and later autostarts restore it instead of booting.
+ *
+ * Entries are snapshot files named after the machine and the SHA1 of
+ * everything that makes the booted machine differ: the VICE version, the
+ * resources tagged as relevant for identical emulation (models, drive
+ * types, true drive emulation, memory expansions, cartridges, ...), the
+ * names of the ROM images and their contents. A changed setting or ROM
+ * gives a new entry, stale entries are never used, only left behind.
+ *
+ * Entries are written to a temporary file first and then renamed, so
+ * instances sharing the cache never read a partial entry.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "archdep.h"
+#include "autostart-bootcache.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "resources.h"
+#include "sha1.h"
+#include "snapshot.h"
+#include "sysfile.h"
+#include "util.h"
+#include "version.h"
+
+
+static void bootcache_hash_string(SHA1_CTX *ctx, const char *s)
+{
+    /* include the terminator, so the strings can't run into each other */
+    SHA1Update(ctx, (const unsigned char *)s, (uint32_t)strlen(s) + 1);
+}
+
+/* hash the contents of the ROM image a resource names */
+static void bootcache_hash_rom(SHA1_CTX *ctx, const char *resource)
+{
+    const char *name;
+    unsigned char buffer[4096];
+    size_t len;
+    FILE *f;
+
+    if (resources_get_string(resource, &name) < 0 || name == NULL || *name == '\0') {
+        return;
+    }
+
+    f = sysfile_open(name, machine_name, NULL, MODE_READ);
+    if (f == NULL) {
+        f = sysfile_open(name, "DRIVES", NULL, MODE_READ);
+    }
+    if (f == NULL) {
+        return;
+    }
+    while ((len = fread(buffer, 1, sizeof buffer, f)) > 0) {
+        SHA1Update(ctx, buffer, (uint32_t)len);
+    }
+    fclose(f);
+}
+
+/** \brief  Get the cache entry for the current machine configuration
+ *
+ * \param[in]   dir     cache directory, the "bootcache" directory in the
+ *                      VICE cache directory if NULL or empty
+ *
+ * \return  heap-allocated path of the entry, which may not exist yet
+ */
+char *autostart_bootcache_path(const char *dir)
+{
+    SHA1_CTX ctx;
+    unsigned char digest[20];
+    char hex[41];
+    char *list;
+    char *line;
+    char *next;
+    char *end;
+    char *file;
+    char *path;
+    int i;
+
+    SHA1Init(&ctx);
+    bootcache_hash_string(&ctx, VERSION);
+    bootcache_hash_string(&ctx, machine_name);
+
+    list = resources_write_event_relevant_to_string("\n");
+    bootcache_hash_string(&ctx, list);
+    lib_free(list);
+
+    /* "name=value" lines of the ROM image resources */
+    list = machine_romset_file_list();
+    bootcache_hash_string(&ctx, list);
+    for (line = list; *line != '\0'; line = next) {
+        next = strchr(line, '\n');
+        if (next == NULL) {
+            next = line + strlen(line);
+        } else {
+            *next++ = '\0';
+        }
+        end = strchr(line, '=');
+        if (end != NULL) {
+            *end = '\0';
+            bootcache_hash_rom(&ctx, line);
+        }
+    }
+    lib_free(list);
+
+    SHA1Final(digest, &ctx);
+    for (i = 0; i < 20; i++) {
+        sprintf(hex + i * 2, "%02x", (unsigned int)digest[i]);
+    }
+
+    file = lib_msprintf("%s-%s.vsf", machine_name, hex);
+    if (dir == NULL || *dir == '\0') {
+        path = util_join_paths(archdep_user_cache_path(), "bootcache", file, NULL);
+    } else {
+        path = util_join_paths(dir, file, NULL);
+    }
+    lib_free(file);
+
+    return path;
+}
+
+/** \brief  Restore the booted machine from a cache entry
+ *
+ * An entry that cannot be restored is removed, so the next boot replaces it.
+ *
+ * \return  0 on success, -1 on error
+ */
+int autostart_bootcache_load(const char *path, log_t log)
+{
+    if (machine_read_snapshot(path, 0) < 0) {
+        log_warning(log, "Could not restore boot cache entry %s, removing it.", path);
+        archdep_remove(path);
+        return -1;
+    }
+    log_message(log, "Restored the booted machine from %s.", path);
+    return 0;
+}
+
+/** \brief  Save the booted machine as a cache entry
+ *
+ * \return  0 on success, -1 on error
+ */
+int autostart_bootcache_save(const char *path, log_t log)
+{
+    char *dir;
+    char *temp;
+    int result = 0;
+
+    util_fname_split(path, &dir, NULL);
+    if (dir != NULL && *dir != '\0' && !util_file_exists(dir)) {
+        archdep_mkdir_recursive(dir, 0755);
+    }
+    lib_free(dir);
+
+#ifdef HAVE_UNISTD_H
+    temp = lib_msprintf("%s.%ld.tmp", path, (long)getpid());
+#else
+    temp = lib_msprintf("%s.tmp", path);
+#endif
+    if (machine_write_snapshot(temp, 0, 0, 0) < 0
+        || archdep_rename(temp, path) < 0) {
+        log_warning(log, "Could not write boot cache entry %s.", path);
+        archdep_remove(temp);
+        result = -1;
+    } else {
+        log_message(log, "Saved the booted machine to %s.", path);
+    }
+    lib_free(temp);
+
+    return result;
+}
@@ -41,6 +41,7 @@
 
 #include "archdep.h"
 #include "autostart.h"
+#include "autostart-bootcache.h"
 #include "autostart-prg.h"
 #include "attach.h"
 #include "cartridge.h"
@@ -204,6 +205,14 @@ static char *AutostartPrgDiskImage = NULL;
 
 static int AutostartDropMode = AUTOSTART_DROP_MODE_RUN;
 
+static int AutostartBootCache = 0;
+
+static char *AutostartBootCacheDir = NULL;
+
+/* boot cache entry to save when the machine is booted, NULL if none */
+static char *bootcache_path = NULL;
+static int bootcache_saving = 0;
+
 
 static const char * const AutostartRunCommandsAvailable[] = {
     "RUN\r", "RUN:\r"
@@ -312,6 +321,20 @@ static int set_autostart_delayrandom(int val, void *param)
     return 0;
 }
 
+/*! \internal \brief set if autostart should use the boot cache */
+static int set_autostart_bootcache(int val, void *param)
+{
+    AutostartBootCache = val ? 1 : 0;
+    return 0;
+}
+
+/*! \internal \brief set the boot cache directory. empty means default. */
+static int set_autostart_bootcache_dir(const char *val, void *param)
+{
+    util_string_set(&AutostartBootCacheDir, val);
+    return 0;
+}
+
 /*! \internal \brief set autostart prg mode */
 static int set_autostart_prg_mode(int val, void *param)
 {
@@ -384,6 +407,8 @@ static resource_string_t resources_string[] = {
     /* caution: position is hardcoded below */
     { "AutostartPrgDiskImage", NULL, RES_EVENT_NO, NULL,
       &AutostartPrgDiskImage, set_autostart_prg_disk_image, NULL },
+    { "AutostartBootCacheDir", "", RES_EVENT_NO, NULL,
+      &AutostartBootCacheDir, set_autostart_bootcache_dir, NULL },
     RESOURCE_STRING_LIST_END
 };
 
@@ -420,6 +445,8 @@ static resource_int_t resources_int[] = {
       &AutostartDelayRandom, set_autostart_delayrandom, NULL },
     { "AutostartDropMode",  AUTOSTART_DROP_MODE_RUN, RES_EVENT_NO, (resource_value_t)0,
       &AutostartDropMode, set_autostart_drop_mode, NULL },
+    { "AutostartBootCache", 0, RES_EVENT_NO, (resource_value_t)0,
+      &AutostartBootCache, set_autostart_bootcache, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -462,6 +489,8 @@ void autostart_resources_shutdown(void)
 {
     lib_free(AutostartPrgDiskImage);
     lib_free(autostart_default_diskimage);
+    lib_free(AutostartBootCacheDir);
+    lib_free(bootcache_path);
 }
 
 /* ------------------------------------------------------------------------- */
@@ -552,6 +581,15 @@ static const cmdline_option_t cmdline_options[] =
       &cmdline_set_autostart_drop_mode, NULL, NULL, NULL, "<Mode>",
       "Set autostart drop mode (0/attach: attach only, 1/load: attach and load, "
       "2/run: attach, load and run)" },
+    { "-autostartbootcache", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "AutostartBootCache", (resource_value_t)1,
+      NULL, "On autostart, restore the machine booted to the READY prompt from the boot cache" },
+    { "+autostartbootcache", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "AutostartBootCache", (resource_value_t)0,
+      NULL, "On autostart, always boot the machine" },
+    { "-autostartbootcachedir", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "AutostartBootCacheDir", NULL,
+      "<Path>", "Set the boot cache directory (empty: use default)" },
     CMDLINE_LIST_END
 };
 
@@ -881,6 +919,59 @@ static void restore_drive_emulation_state(int unit, int drive)
 
 /* ------------------------------------------------------------------------- */
 
+static void bootcache_save_trap(uint16_t unused_addr, void *unused_data)
+{
+    if (bootcache_path != NULL) {
+        autostart_bootcache_save(bootcache_path, autostart_log);
+        lib_free(bootcache_path);
+        bootcache_path = NULL;
+    }
+    bootcache_saving = 0;
+}
+
+/* Save the booted machine if the boot cache missed. Returns nonzero while
+   the save is pending, autostart must not advance until it is done.  */
+static int bootcache_store(void)
+{
+    if (bootcache_path == NULL) {
+        return 0;
+    }
+    if (!bootcache_saving) {
+        bootcache_saving = 1;
+        interrupt_maincpu_trigger_trap(bootcache_save_trap, 0);
+    }
+    return 1;
+}
+
+static void bootcache_load_trap(uint16_t unused_addr, void *unused_data)
+{
+    int rnd;
+
+    if (bootcache_path == NULL) {
+        return;
+    }
+
+    if (autostart_bootcache_load(bootcache_path, autostart_log) < 0) {
+        /* boot as usual, the entry is saved again when it is done */
+        machine_trigger_reset(MACHINE_RESET_MODE_POWER_CYCLE);
+        return;
+    }
+    lib_free(bootcache_path);
+    bootcache_path = NULL;
+
+    /* there is no reset to wait for, the machine is at the READY prompt */
+    autostart_ignore_reset = 0;
+    autostart_wait_for_reset = 0;
+    autostart_initial_delay_cycles = maincpu_clk;
+
+    resources_get_int("AutostartDelayRandom", &rnd);
+    if (rnd) {
+        autostart_initial_delay_cycles += lib_unsigned_rand(1, (int)machine_get_cycles_per_frame() * 10);
+    }
+
+    mon_update_all_checkpoint_state();
+}
+
 static void load_snapshot_trap(uint16_t unused_addr, void *unused_data)
 {
     if (autostart_program_name
@@ -1163,6 +1254,10 @@ static void advance_hasdisk(int unit, int drive)
 
     switch (check("READY.", AUTOSTART_WAIT_BLINK)) {
         case YES:
+            if (bootcache_store()) {
+                break;
+            }
+
             /* complete the drive setup */
             setup_for_disk_ready(unit, drive);
 
@@ -1414,6 +1509,10 @@ static void advance_waitloadready(void)
 /* After a reset a PRG file has to be injected into RAM */
 static void advance_inject(void)
 {
+    if (bootcache_store()) {
+        return;
+    }
+
     if (autostart_prg_perform_injection(autostart_log) < 0) {
         disable_warp_if_was_requested();
         autostart_disable();
@@ -1538,7 +1637,20 @@ static void reboot_for_autostart(const char *program_name, unsigned int mode,
     }
     DBG(("reboot_for_autostart - autostart_initial_delay_cycles: %"PRIu64, autostart_initial_delay_cycles));
 
-    machine_trigger_reset(MACHINE_RESET_MODE_POWER_CYCLE);
+    /* the tape modes are left out, they depend on the datasette state */
+    lib_free(bootcache_path);
+    bootcache_path = NULL;
+    bootcache_saving = 0;
+    if (AutostartBootCache
+        && (mode == AUTOSTART_HASDISK || mode == AUTOSTART_INJECT)) {
+        bootcache_path = autostart_bootcache_path(AutostartBootCacheDir);
+    }
+
+    if (bootcache_path != NULL && util_file_exists(bootcache_path)) {
+        interrupt_maincpu_trigger_trap(bootcache_load_trap, 0);
+    } else {
+        machine_trigger_reset(MACHINE_RESET_MODE_POWER_CYCLE);
+    }
 
     /* enable warp before reset */
     if (mode != AUTOSTART_HASSNAPSHOT) {
@@ -2237,6 +2349,13 @@ int autostart_in_progress(void)
     return ((autostartmode != AUTOSTART_NONE) && (autostartmode != AUTOSTART_DONE));
 }
 
+/* Return nonzero if the machine waits at the "READY." prompt with nothing
+   left to type and no autostart going on, i.e. it has finished booting.  */
+int autostart_ready_prompt(void)
+{
+    return !autostart_in_progress() && (check("READY.", AUTOSTART_WAIT_BLINK) == YES);
+}
+
 /* Disable autostart on reset.  */
 /* FIXME: pass device nr into this function */
 void autostart_reset(void)
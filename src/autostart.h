@@ -77,6 +77,7 @@ extern int autostart_ignore_reset;
 extern int autostart_tape_basic_load;
 
 int autostart_in_progress(void);
+int autostart_ready_prompt(void);
 
 void autostart_trigger_monitor(int enable);
 
@@ -0,0 +1,564 @@
+/** \file   vsid-batch.c
+ * \brief   Render a list of PSID tunes to sound files
+ *
+ * Rendering a large set of tunes with one vsid process per tune pays for
+ * loading ROMs and setting up the machine every time, and renders each
+ * tune at the speed of the sound device. With -sidbatch vsid reads a list
+ * of PSID files once the machine is up and becomes a server that never
+ * runs the machine itself. Each tune is rendered by a fork()ed copy of
+ * the server, an isolated instance that shares ROMs and machine tables
+ * copy-on-write. Up to -sidbatchjobs instances render at the same time,
+ * the server starts the next tune as soon as one finishes.
+ *
+ * Each line of the list names a PSID file, optionally followed by white
+ * space and a tune number; all tunes of the file are rendered if there
+ * is none. Empty lines and lines starting with '#' are skipped. An
+ * instance plays its tune in warp mode, records it with the sound
+ * recording device named by -sidbatchformat and exits once the tune has
+ * played for its length in the HVSC song length database, or for
+ * -sidbatchlength seconds if it has no entry there.
+ *
+ * The output file is named after the path of the PSID file, relative to
+ * the HVSC root if it is inside the HVSC, with the directory separators
+ * replaced by '_' and the tune number appended, e.g.
+ * "MUSICIANS_H_Hubbard_Rob_Commando-1.wav".
+ *
+ * Only built without USE_VICE_THREAD: with the machine on a thread of its
+ * own the server would fork() while the UI thread holds or waits for the
+ * main lock, an instance would deadlock in mainlock_yield_begin() and the
+ * server would block the UI in waitpid().
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(HAVE_FORK) && !defined(USE_VICE_THREAD)
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "archdep.h"
+#include "archdep_get_hvsc_dir.h"
+#include "cmdline.h"
+#include "hvsc.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "psid.h"
+#include "resources.h"
+#include "sound.h"
+#include "util.h"
+#include "vsync.h"
+
+#include "vsid-batch.h"
+
+#if defined(HAVE_FORK) && !defined(USE_VICE_THREAD)
+
+/* longest line of the tune list */
+#define VSID_BATCH_LINE_MAX     1024
+
+typedef struct vsid_batch_job_s {
+    char *path;
+    int tune;
+} vsid_batch_job_t;
+
+static char *batch_list = NULL;
+static char *batch_output_dir = NULL;
+static char *batch_format = NULL;
+static int batch_workers = 0;
+static int batch_default_length = 180;
+
+/* set once the server has run, the instances must never start it again */
+static int batch_done = 0;
+
+static vsid_batch_job_t *jobs = NULL;
+static int jobs_count = 0;
+static int jobs_size = 0;
+
+/* the tune rendered by this instance, NULL in the server */
+static const vsid_batch_job_t *batch_job = NULL;
+static long batch_length_ms = 0;
+static char *batch_output = NULL;
+
+static log_t vsid_batch_log = LOG_DEFAULT;
+
+
+static void vsid_batch_add_job(const char *path, int tune)
+{
+    if (jobs_count == jobs_size) {
+        jobs_size = jobs_size ? jobs_size * 2 : 64;
+        jobs = lib_realloc(jobs, jobs_size * sizeof *jobs);
+    }
+    jobs[jobs_count].path = lib_strdup(path);
+    jobs[jobs_count].tune = tune;
+    jobs_count++;
+}
+
+
+/** \brief  Add the tunes of one line of the tune list to the jobs
+ *
+ * \param[in,out]   line    line without the line terminator
+ *
+ * \return  0 on success, -1 if the file is not a valid PSID file
+ */
+static int vsid_batch_parse_line(char *line)
+{
+    char *p;
+    int tune = 0;
+    int songs;
+    int default_tune;
+    int i;
+
+    /* an optional tune number follows the last white space */
+    p = line + strlen(line);
+    while (p > line && p[-1] >= '0' && p[-1] <= '9') {
+        p--;
+    }
+    if (*p != '\0' && p > line && (p[-1] == ' ' || p[-1] == '\t')) {
+        tune = atoi(p);
+        while (p > line && (p[-1] == ' ' || p[-1] == '\t')) {
+            p--;
+        }
+        *p = '\0';
+    }
+
+    if (psid_load_file(line) < 0) {
+        log_error(vsid_batch_log, "%s is not a valid PSID file.", line);
+        return -1;
+    }
+    songs = psid_tunes(&default_tune);
+
+    if (tune > 0) {
+        if (tune > songs) {
+            log_error(vsid_batch_log, "%s has no tune %d.", line, tune);
+            return -1;
+        }
+        vsid_batch_add_job(line, tune);
+    } else {
+        for (i = 1; i <= songs; i++) {
+            vsid_batch_add_job(line, i);
+        }
+    }
+    return 0;
+}
+
+
+/** \brief  Read the tune list into the jobs
+ *
+ * \return  number of lines that could not be used, or -1 if the list
+ *          cannot be read
+ */
+static int vsid_batch_read_list(void)
+{
+    FILE *f;
+    char line[VSID_BATCH_LINE_MAX];
+    int failed = 0;
+
+    f = fopen(batch_list, "r");
+    if (f == NULL) {
+        log_error(vsid_batch_log, "Could not open tune list %s.", batch_list);
+        return -1;
+    }
+
+    while (util_get_line(line, sizeof line, f) >= 0) {
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+        if (vsid_batch_parse_line(line) < 0) {
+            failed++;
+        }
+    }
+    fclose(f);
+
+    /* the server never plays a tune itself */
+    machine_play_psid(-1);
+
+    return failed;
+}
+
+
+/** \brief  Get the output file name of a job
+ *
+ * \param[in]   job     job
+ *
+ * \return  heap-allocated file name
+ */
+static char *vsid_batch_output_name(const vsid_batch_job_t *job)
+{
+    const char *hvsc_dir = archdep_get_hvsc_dir();
+    const char *relative = job->path;
+    char *name;
+    char *file;
+    char *result;
+    char *p;
+
+    if (hvsc_dir != NULL && *hvsc_dir != '\0'
+        && strncmp(relative, hvsc_dir, strlen(hvsc_dir)) == 0) {
+        relative += strlen(hvsc_dir);
+    }
+    while (*relative == '/' || *relative == '\\' || *relative == '.') {
+        relative++;
+    }
+    name = lib_strdup(relative);
+
+    for (p = name; *p != '\0'; p++) {
+        if (*p == '/' || *p == '\\') {
+            *p = '_';
+        }
+    }
+    p = strrchr(name, '.');
+    if (p != NULL && util_strcasecmp(p, ".sid") == 0) {
+        *p = '\0';
+    }
+
+    file = lib_msprintf("%s-%d.%s", name, job->tune, batch_format);
+    lib_free(name);
+    if (batch_output_dir == NULL || *batch_output_dir == '\0') {
+        return file;
+    }
+    result = util_join_paths(batch_output_dir, file, NULL);
+    lib_free(file);
+    return result;
+}
+
+
+/** \brief  Turn a freshly forked instance into the player of a job
+ *
+ * \param[in]   job     tune to render
+ */
+static void vsid_batch_start_job(const vsid_batch_job_t *job)
+{
+    long *lengths;
+    int songs;
+
+    batch_job = job;
+    batch_output = vsid_batch_output_name(job);
+
+    songs = hvsc_sldb_get_lengths(job->path, &lengths);
+    if (songs >= job->tune && lengths[job->tune - 1] > 0) {
+        batch_length_ms = lengths[job->tune - 1];
+    } else {
+        batch_length_ms = batch_default_length * 1000L;
+        log_warning(vsid_batch_log, "No song length for %s tune %d, rendering %d seconds.",
+                    job->path, job->tune, batch_default_length);
+    }
+    if (songs >= 0) {
+        lib_free(lengths);
+    }
+
+    if (psid_load_file(job->path) < 0) {
+        log_error(vsid_batch_log, "Could not load %s.", job->path);
+        /* skip the atexit handlers, they belong to the server */
+        _exit(1);
+    }
+    machine_play_psid(job->tune);
+
+    resources_set_int("Sound", 1);
+    resources_set_string("SoundDeviceName", "dummy");
+    resources_set_string("SoundRecordDeviceArg", batch_output);
+    resources_set_string("SoundRecordDeviceName", batch_format);
+    vsync_set_warp_mode(1);
+
+    machine_trigger_reset(MACHINE_RESET_MODE_POWER_CYCLE);
+}
+
+
+/** \brief  Finish the job of this instance once its tune has played
+ *
+ * Closing the sound device completes the output file.
+ */
+static void vsid_batch_finish_job(void)
+{
+    int status = 0;
+
+    sound_close();
+    if (!util_file_exists(batch_output)) {
+        log_error(vsid_batch_log, "Could not record %s.", batch_output);
+        status = 1;
+    }
+    fflush(NULL);
+    _exit(status);
+}
+
+
+/** \brief  Render all jobs on a pool of instances, then exit
+ *
+ * Only returns in a new instance.
+ */
+static void vsid_batch_serve(void)
+{
+    pid_t *pids;
+    int *slot_job;
+    int workers;
+    int running = 0;
+    int next = 0;
+    int rendered = 0;
+    int failed;
+    int i;
+    tick_t start;
+
+    failed = vsid_batch_read_list();
+    if (failed < 0 || jobs_count == 0) {
+        log_error(vsid_batch_log, "No tunes to render.");
+        archdep_vice_exit(EXIT_FAILURE);
+    }
+
+    workers = batch_workers;
+    if (workers <= 0) {
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (workers < 1) {
+        workers = 1;
+    } else if (workers > jobs_count) {
+        workers = jobs_count;
+    }
+    pids = lib_calloc(workers, sizeof *pids);
+    slot_job = lib_calloc(workers, sizeof *slot_job);
+
+    /* the sound device may run threads of its own, which fork() does not
+       duplicate, so each instance opens its own device again */
+    sound_close();
+
+    log_message(vsid_batch_log, "Rendering %d tunes on %d instances.", jobs_count, workers);
+    start = tick_now();
+
+    while (next < jobs_count || running > 0) {
+        pid_t pid;
+        int status;
+
+        for (i = 0; i < workers && next < jobs_count; i++) {
+            if (pids[i] != 0) {
+                continue;
+            }
+            /* don't let the instance write out our buffered output again */
+            fflush(NULL);
+            pid = fork();
+            if (pid == 0) {
+                vsid_batch_start_job(&jobs[next]);
+                return;
+            }
+            if (pid < 0) {
+                log_error(vsid_batch_log, "fork() failed: %s.", strerror(errno));
+                failed++;
+            } else {
+                pids[i] = pid;
+                slot_job[i] = next;
+                running++;
+            }
+            next++;
+        }
+        if (running == 0) {
+            continue;
+        }
+
+        pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            log_error(vsid_batch_log, "waitpid() failed: %s.", strerror(errno));
+            break;
+        }
+        for (i = 0; i < workers && pids[i] != pid; i++) {
+        }
+        if (i == workers) {
+            continue;
+        }
+        pids[i] = 0;
+        running--;
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            log_message(vsid_batch_log, "Rendered %s tune %d.",
+                        jobs[slot_job[i]].path, jobs[slot_job[i]].tune);
+            rendered++;
+        } else {
+            log_error(vsid_batch_log, "Rendering %s tune %d failed.",
+                      jobs[slot_job[i]].path, jobs[slot_job[i]].tune);
+            failed++;
+        }
+    }
+
+    log_message(vsid_batch_log, "Rendered %d of %d tunes in %.1f seconds.",
+                rendered, jobs_count,
+                (double)tick_now_delta(start) / TICK_PER_SECOND);
+    archdep_vice_exit(failed ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+
+/** \brief  Start the server, or finish the job of an instance
+ *
+ * Called once per frame from the vsync hook of the machine.
+ *
+ * \param[in]   frames          frames played since the tune was started
+ * \param[in]   rfsh_per_sec    frames per second
+ */
+void vsid_batch_check(unsigned int frames, double rfsh_per_sec)
+{
+    if (batch_job != NULL) {
+        if (frames * 1000.0 / rfsh_per_sec >= batch_length_ms) {
+            vsid_batch_finish_job();
+        }
+        return;
+    }
+    if (batch_done || batch_list == NULL || *batch_list == '\0') {
+        return;
+    }
+
+    batch_done = 1;
+    vsid_batch_log = log_open("VSIDBatch");
+    vsid_batch_serve();
+}
+
+
+static int set_batch_list(const char *val, void *param)
+{
+    util_string_set(&batch_list, val);
+
+    return 0;
+}
+
+static int set_batch_output_dir(const char *val, void *param)
+{
+    util_string_set(&batch_output_dir, val);
+
+    return 0;
+}
+
+static int set_batch_format(const char *val, void *param)
+{
+    if (val == NULL || *val == '\0') {
+        return -1;
+    }
+    util_string_set(&batch_format, val);
+
+    return 0;
+}
+
+static int set_batch_workers(int val, void *param)
+{
+    if (val < 0) {
+        return -1;
+    }
+    batch_workers = val;
+
+    return 0;
+}
+
+static int set_batch_default_length(int val, void *param)
+{
+    if (val <= 0) {
+        return -1;
+    }
+    batch_default_length = val;
+
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "VSIDBatchList", "", RES_EVENT_NO, NULL,
+      &batch_list, set_batch_list, NULL },
+    { "VSIDBatchOutputDir", "", RES_EVENT_NO, NULL,
+      &batch_output_dir, set_batch_output_dir, NULL },
+    { "VSIDBatchFormat", "wav", RES_EVENT_NO, NULL,
+      &batch_format, set_batch_format, NULL },
+    RESOURCE_STRING_LIST_END
+};
+
+static const resource_int_t resources_int[] = {
+    { "VSIDBatchJobs", 0, RES_EVENT_NO, NULL,
+      &batch_workers, set_batch_workers, NULL },
+    { "VSIDBatchDefaultLength", 180, RES_EVENT_NO, NULL,
+      &batch_default_length, set_batch_default_length, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-sidbatch", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "VSIDBatchList", NULL,
+      "<Name>", "Render the PSID tunes listed in this file to sound files, then exit" },
+    { "-sidbatchjobs", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "VSIDBatchJobs", NULL,
+      "<number>", "Render this many tunes at the same time (0: one per CPU core)" },
+    { "-sidbatchdir", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "VSIDBatchOutputDir", NULL,
+      "<Path>", "Write the rendered tunes to this directory" },
+    { "-sidbatchformat", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "VSIDBatchFormat", NULL,
+      "<Name>", "Record the rendered tunes with this sound recording device, e.g. wav or flac" },
+    { "-sidbatchlength", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "VSIDBatchDefaultLength", NULL,
+      "<seconds>", "Render tunes without a song length database entry for this long" },
+    CMDLINE_LIST_END
+};
+
+
+int vsid_batch_resources_init(void)
+{
+    if (resources_register_string(resources_string) < 0) {
+        return -1;
+    }
+    return resources_register_int(resources_int);
+}
+
+void vsid_batch_resources_shutdown(void)
+{
+    lib_free(batch_list);
+    batch_list = NULL;
+    lib_free(batch_output_dir);
+    batch_output_dir = NULL;
+    lib_free(batch_format);
+    batch_format = NULL;
+}
+
+int vsid_batch_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
+
+#else
+
+void vsid_batch_check(unsigned int frames, double rfsh_per_sec)
+{
+}
+
+int vsid_batch_resources_init(void)
+{
+    return 0;
+}
+
+void vsid_batch_resources_shutdown(void)
+{
+}
+
+int vsid_batch_cmdline_options_init(void)
+{
+    return 0;
+}
+
+#endif
@@ -68,6 +68,7 @@
 #include "video.h"
 #include "vsid-cmdline-options.h"
 #include "vsidui.h"
+#include "vsid-batch.h"
 #include "vsid-debugcart.h"
 #include "vsync.h"
 
@@ -133,6 +134,10 @@ int machine_resources_init(void)
         init_resource_fail("bustrace");
         return -1;
     }
+    if (vsid_batch_resources_init() < 0) {
+        init_resource_fail("vsid batch");
+        return -1;
+    }
 #ifdef DEBUG
     if (debug_resources_init() < 0) {
         init_resource_fail("debug");
@@ -146,6 +151,7 @@ void machine_resources_shutdown(void)
 {
     c64_resources_shutdown();
     debugcart_resources_shutdown();
+    vsid_batch_resources_shutdown();
 }
 
 /* C64-specific command-line option initialization.  */
@@ -177,6 +183,10 @@ int machine_cmdline_options_init(void)
         init_cmdline_options_fail("bustrace");
         return -1;
     }
+    if (vsid_batch_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("vsid batch");
+        return -1;
+    }
     return 0;
 }
 
@@ -325,6 +335,7 @@ void machine_handle_pending_alarms(CLOCK num_write_cycles)
 static void machine_vsync_hook(void)
 {
     int i;
+    unsigned int frames;
     unsigned int playtime;
     static unsigned int time = 0;
 
@@ -342,12 +353,15 @@ static void machine_vsync_hook(void)
         }
     }
 
+    frames = psid_increment_frames();
+    vsid_batch_check(frames, machine_timing.rfsh_per_sec);
+
 #if 0
-    playtime = (psid_increment_frames() * machine_timing.cycles_per_rfsh)
+    playtime = (frames * machine_timing.cycles_per_rfsh)
         / machine_timing.cycles_per_sec;
 #else
     /* Count deciseconds */
-    playtime = (double)psid_increment_frames()
+    playtime = (double)frames
         / machine_timing.rfsh_per_sec * 10.0;
 #endif
     if (playtime != time) {
@@ -145,6 +145,7 @@ unsigned int disk_image_header_gap_size(unsigned int format, unsigned int track)
 unsigned int disk_image_sync_size(unsigned int format, unsigned int track);
 
 int disk_image_read_image(const disk_image_t *image);
+int disk_image_load_half_track(const disk_image_t *image, unsigned int half_track);
 int disk_image_write_p64_image(const disk_image_t *image);
 int disk_image_write_half_track(disk_image_t *image, unsigned int half_track, const struct disk_track_s *raw);
 
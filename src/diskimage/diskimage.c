@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "cmdline.h"
 #include "diskconstants.h"
 #include "diskimage.h"
 #include "fsimage-check.h"
@@ -49,6 +50,7 @@
 #include "lib.h"
 #include "log.h"
 #include "realimage.h"
+#include "resources.h"
 #include "types.h"
 #include "p64.h"
 
@@ -734,6 +736,25 @@ int disk_image_read_image(const disk_image_t *image)
     }
 }
 
+/* Make sure the GCR track of a drive for `half_track' is built, tracks are
+   only built from the image when the drive first accesses them.  */
+int disk_image_load_half_track(const disk_image_t *image, unsigned int half_track)
+{
+    if (image->device != DISK_IMAGE_DEVICE_FS || image->gcr == NULL) {
+        return 0;
+    }
+
+    switch (image->type) {
+        case DISK_IMAGE_TYPE_P64:
+            return 0;
+        case DISK_IMAGE_TYPE_G64:
+        case DISK_IMAGE_TYPE_G71:
+            return fsimage_gcr_load_half_track(image, half_track);
+        default:
+            return fsimage_dxx_load_half_track(image, half_track);
+    }
+}
+
 int disk_image_write_p64_image(const disk_image_t *image)
 {
     return fsimage_write_p64_image(image);
@@ -752,18 +773,49 @@ void disk_image_init(void)
 #endif
 }
 
-int disk_image_resources_init(void)
+static int disk_image_copy_on_write = FSIMAGE_COW_OFF;
+
+static int set_disk_image_copy_on_write(int val, void *param)
 {
+    switch (val) {
+        case FSIMAGE_COW_OFF:
+        case FSIMAGE_COW_DISCARD:
+        case FSIMAGE_COW_FLUSH:
+            break;
+        default:
+            return -1;
+    }
+    disk_image_copy_on_write = val;
+    fsimage_set_copy_on_write(val);
     return 0;
 }
 
+static const resource_int_t resources_int[] = {
+    { "DiskImageCopyOnWrite", FSIMAGE_COW_OFF, RES_EVENT_NO, NULL,
+      &disk_image_copy_on_write, set_disk_image_copy_on_write, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+int disk_image_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
 void disk_image_resources_shutdown(void)
 {
 }
 
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-diskimagecow", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "DiskImageCopyOnWrite", NULL,
+      "<Mode>", "Share disk images copy-on-write (0: off, 1: discard changes on detach, 2: write changes back on detach)" },
+    CMDLINE_LIST_END
+};
+
 int disk_image_cmdline_options_init(void)
 {
-    return 0;
+    return cmdline_register_options(cmdline_options);
 }
 
 /*-----------------------------------------------------------------------*/
@@ -108,7 +108,7 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
         offset += X64_HEADER_LENGTH;
     }
 #endif
-    if (util_fpwrite(fsimage->fd, buffer, max_sector * 256, offset) < 0) {
+    if (fsimage_fpwrite(fsimage, buffer, max_sector * 256, offset) < 0) {
         log_error(fsimage_dxx_log, "Error writing T:%u to disk image.",
                   track);
         lib_free(buffer);
@@ -126,10 +126,10 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
 #endif
             fsimage->error_info.dirty = 0;
             if (error_info_created) {
-                res = util_fpwrite(fsimage->fd, fsimage->error_info.map,
+                res = fsimage_fpwrite(fsimage, fsimage->error_info.map,
                                    fsimage->error_info.len, fsimage->error_info.len * 256);
             } else {
-                res = util_fpwrite(fsimage->fd, fsimage->error_info.map + sectors,
+                res = fsimage_fpwrite(fsimage, fsimage->error_info.map + sectors,
                                    max_sector, offset);
             }
             if (res < 0) {
@@ -146,23 +146,18 @@ int fsimage_dxx_write_half_track(disk_image_t *image, unsigned int half_track,
     return 0;
 }
 
+/* Set up the GCR tracks of the drive for the image. The tracks are only
+   built when the drive first accesses them, see fsimage_dxx_load_half_track(),
+   but from the image as it was attached.  */
 int fsimage_read_dxx_image(const disk_image_t *image)
 {
     uint8_t buffer[256], *bam_id;
     int gap, headergap, synclen;
-    unsigned int track, sector, track_size;
-    gcr_header_t header;
-    fdc_err_t rf;
-    int image_has_two_single_sides = 0;
+    unsigned int track, track_size, max_sector, max_track, half_track;
     int double_sided_drive = 0;
     fsimage_t *fsimage = image->media.fsimage;
-    unsigned int max_sector;
-    uint8_t *ptr;
-    int half_track;
     int sectors;
-    long offset;
     unsigned long trackoffset = 0;
-    uint8_t *tempgcr;
 
     if (image->type == DISK_IMAGE_TYPE_D80
         || image->type == DISK_IMAGE_TYPE_D82) {
@@ -175,161 +170,169 @@ int fsimage_read_dxx_image(const disk_image_t *image)
 
     bam_id[0] = bam_id[1] = 0xa0;
     if (sectors >= 0) {
-        util_fpread(fsimage->fd, buffer, 256, sectors << 8);
+        fsimage_fpread(fsimage, buffer, 256, sectors << 8);
     } else {
         return -1;
     }
-    header.id1 = bam_id[0];
-    header.id2 = bam_id[1];
+    fsimage->lazy_gcr.id[0][0] = fsimage->lazy_gcr.id[1][0] = bam_id[0];
+    fsimage->lazy_gcr.id[0][1] = fsimage->lazy_gcr.id[1][1] = bam_id[1];
 
     /* check double sided images */
-    image_has_two_single_sides = (image->type == DISK_IMAGE_TYPE_D71) && !(buffer[0x03] & 0x80);
+    fsimage->lazy_gcr.two_single_sides = (image->type == DISK_IMAGE_TYPE_D71) && !(buffer[0x03] & 0x80);
     double_sided_drive = (drive_get_disk_drive_type(image->device) == DRIVE_TYPE_1571) ||
                          (drive_get_disk_drive_type(image->device) == DRIVE_TYPE_1571CR);
 
+    /* special case for second side of the 1571. If each side was formatted
+       separately in one-sided mode, we must start from track 1 again and use
+       the ID from the BAM on the second side. */
+    if (fsimage->lazy_gcr.two_single_sides) {
+        sectors = disk_image_check_sector(image, BAM_TRACK_1571 + 35, BAM_SECTOR_1571);
+
+        buffer[BAM_ID_1571] = buffer[BAM_ID_1571 + 1] = 0xa0;
+        if (sectors >= 0) {
+            fsimage_fpread(fsimage, buffer, 256, sectors << 8);
+        }
+        fsimage->lazy_gcr.id[1][0] = buffer[BAM_ID_1571];
+        fsimage->lazy_gcr.id[1][1] = buffer[BAM_ID_1571 + 1];
+    }
+
     /* special case for 1571: if we are inserting a d64 image into a 1571, fill
        the second side with "unformatted" data */
-    if (double_sided_drive && (image->type != DISK_IMAGE_TYPE_D71)) {
-        for (header.track = track = 1; track <= image->max_half_tracks / 2; track++, header.track++) {
-            half_track = (36 + track) * 2 - 2;
-
-            track_size = disk_image_raw_track_size(image->type, track);
-            if (image->gcr->tracks[half_track].data == NULL) {
-                image->gcr->tracks[half_track].data = lib_malloc(track_size);
-            } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-                image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
-            }
-            ptr = image->gcr->tracks[half_track].data;
-            image->gcr->tracks[half_track].size = track_size;
-            /* regular track */
-            memset(ptr, 0, track_size);
-
-            /* Clear odd track */
-            half_track++;
-
-            /* create an (empty) half track */
-            if (image->gcr->tracks[half_track].data == NULL) {
-                image->gcr->tracks[half_track].data = lib_malloc(track_size);
-            } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-                image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
-            }
-            image->gcr->tracks[half_track].size = track_size;
-            ptr = image->gcr->tracks[half_track].data;
-            memset(ptr, 0, track_size);
+    fsimage->lazy_gcr.blank_side = double_sided_drive && (image->type != DISK_IMAGE_TYPE_D71);
+
+    /* On real disks, the track skew depends on many factors of which
+       none is exactly defined: the mechanical properties of the drive,
+       and last not least the code used for formatting the disk. Thus
+       the offset we use here is somewhat arbitrary, the choosen values
+       are tweaked to be somewhat close to what the skew1.prg program
+       shows for the first few tracks. */
+    max_track = image->max_half_tracks / 2;
+    fsimage->lazy_gcr.tracks = image->tracks;
+    lib_free(fsimage->lazy_gcr.skew);
+    fsimage->lazy_gcr.skew = lib_calloc(max_track + 1, sizeof(unsigned int));
+    for (track = 1; track <= max_track && track <= image->tracks; track++) {
+        track_size = disk_image_raw_track_size(image->type, track);
+        gap = disk_image_gap_size(image->type, track);
+        headergap = disk_image_header_gap_size(image->type, track);
+        synclen = disk_image_sync_size(image->type, track);
+        max_sector = disk_image_sector_per_track(image->type, track);
+
+        /* bytes we have written */
+        trackoffset += max_sector * (SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2)) - gap;
+        trackoffset += (track_size * 100) / 270; /* time it takes to step */
+        trackoffset %= track_size;
+        fsimage->lazy_gcr.skew[track] = (unsigned int)trackoffset;
+    }
+
+    if (fsimage->lazy_gcr.pending == NULL) {
+        fsimage->lazy_gcr.pending = lib_malloc(MAX_GCR_TRACKS);
+    }
+    for (half_track = 0; half_track < MAX_GCR_TRACKS; half_track++) {
+        fsimage->lazy_gcr.pending[half_track] = (half_track < max_track * 2)
+            || (fsimage->lazy_gcr.blank_side
+                && half_track >= 72 && half_track < 72 + max_track * 2);
+        if (fsimage->lazy_gcr.pending[half_track]
+            && image->gcr->tracks[half_track].data != NULL) {
+            lib_free(image->gcr->tracks[half_track].data);
+            image->gcr->tracks[half_track].data = NULL;
+            image->gcr->tracks[half_track].size = 0;
         }
     }
+    return 0;
+}
 
-    for (header.track = track = 1; track <= image->max_half_tracks / 2; track++, header.track++) {
-        half_track = track * 2 - 2;
+/* Build a GCR track of the drive from the image, unless it is built already
+   or was restored from a snapshot.  */
+int fsimage_dxx_load_half_track(const disk_image_t *image, unsigned int half_track)
+{
+    uint8_t buffer[256];
+    int gap, headergap, synclen;
+    unsigned int index, track, side, sector, max_sector, track_size, trackoffset;
+    gcr_header_t header;
+    fdc_err_t rf;
+    fsimage_t *fsimage = image->media.fsimage;
+    disk_track_t *raw;
+    uint8_t *ptr, *tempgcr;
+    int sectors;
+    long offset;
 
-        track_size = disk_image_raw_track_size(image->type, track);
-        if (image->gcr->tracks[half_track].data == NULL) {
-            image->gcr->tracks[half_track].data = lib_malloc(track_size);
-        } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-            image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
-        }
-        ptr = image->gcr->tracks[half_track].data;
-        image->gcr->tracks[half_track].size = track_size;
-
-        if (track <= image->tracks) {
-            /* get temp buffer */
-            ptr = tempgcr = lib_malloc(track_size);
-
-            /* special case for second side of the 1571. If each side was formatted
-               separately in one-sided mode, we must start from track 1 again and use
-               the ID from the BAM on the second side. */
-            if (image_has_two_single_sides && track == 36) {
-                sectors = disk_image_check_sector(image, BAM_TRACK_1571 + 35, BAM_SECTOR_1571);
-
-                buffer[BAM_ID_1571] = buffer[BAM_ID_1571 + 1] = 0xa0;
-                if (sectors >= 0) {
-                    util_fpread(fsimage->fd, buffer, 256, sectors << 8);
-                }
-                header.id1 = buffer[BAM_ID_1571]; /* second side, update id and track */
-                header.id2 = buffer[BAM_ID_1571 + 1];
-                header.track = 1;
-            }
+    index = half_track - 2;
+    if (fsimage->lazy_gcr.pending == NULL || index >= MAX_GCR_TRACKS
+        || !fsimage->lazy_gcr.pending[index]) {
+        return 0;
+    }
+    fsimage->lazy_gcr.pending[index] = 0;
 
-            gap = disk_image_gap_size(image->type, track);
-            headergap = disk_image_header_gap_size(image->type, track);
-            synclen = disk_image_sync_size(image->type, track);
+    raw = &image->gcr->tracks[index];
+    if (raw->data != NULL) {
+        return 0;
+    }
 
-            max_sector = disk_image_sector_per_track(image->type, track);
+    if (index >= (image->max_half_tracks / 2) * 2) {
+        /* empty second side of a 1571 */
+        raw->size = disk_image_raw_track_size(image->type, index / 2 - 35);
+        raw->data = lib_calloc(1, raw->size);
+        return 0;
+    }
 
-            /* Clear track to avoid read errors.  */
-            memset(ptr, 0x55, track_size);
+    track = index / 2 + 1;
+    track_size = disk_image_raw_track_size(image->type, track);
+    raw->data = lib_malloc(track_size);
+    raw->size = track_size;
 
-            for (sector = 0; sector < max_sector; sector++) {
-                sectors = disk_image_check_sector(image, track, sector);
-                offset = sectors * 256;
+    if (index & 1) {
+        /* create an (empty) half track */
+        memset(raw->data, 0, track_size);
+        return 0;
+    }
+    if (track > fsimage->lazy_gcr.tracks) {
+        memset(raw->data, 0x55, track_size);
+        return 0;
+    }
 
-#ifdef HAVE_X64_IMAGE
-                if (image->type == DISK_IMAGE_TYPE_X64) {
-                    offset += X64_HEADER_LENGTH;
-                }
-#endif
-                if (sectors >= 0) {
-                    rf = CBMDOS_FDC_ERR_DRIVE;
-                    if (util_fpread(fsimage->fd, buffer, 256, offset) >= 0) {
-                        if (fsimage->error_info.map != NULL) {
-                            rf = fsimage->error_info.map[sectors];
-                        }
-                    }
-                    header.sector = sector;
-                    gcr_convert_sector_to_GCR(buffer, ptr, &header, headergap, synclen, rf);
-                }
+    side = fsimage->lazy_gcr.two_single_sides && track >= 36;
+    header.track = side ? track - 35 : track;
+    header.id1 = fsimage->lazy_gcr.id[side][0];
+    header.id2 = fsimage->lazy_gcr.id[side][1];
 
-                ptr += SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2);
-            }
+    gap = disk_image_gap_size(image->type, track);
+    headergap = disk_image_header_gap_size(image->type, track);
+    synclen = disk_image_sync_size(image->type, track);
 
-#if 0
-            /* copy gcr data to buffer (this creates perfectly aligned tracks) */
-            ptr = image->gcr->tracks[half_track].data;
-            memcpy(ptr, tempgcr, track_size);
-#else
-            /* copy gcr data to final buffer with offset + wraparound */
-            /* On real disks, the track skew depends on many factors of which
-               none is exactly defined: the mechanical properties of the drive,
-               and last not least the code used for formatting the disk. Thus
-               the offset we use here is somewhat arbitrary, the choosen values
-               are tweaked to be somewhat close to what the skew1.prg program
-               shows for the first few tracks. */
-            trackoffset += (ptr - tempgcr) - gap; /* bytes we have written */
-            trackoffset += (track_size * 100) / 270; /* time it takes to step */
-            trackoffset %= track_size;
-            /*printf("track: %2u sectors: %2u size: %5u offset: %5lu\n", track, max_sector, track_size, trackoffset);*/
-            ptr = image->gcr->tracks[half_track].data;
-            memset(ptr, 0x55, track_size);
-            memcpy(ptr + trackoffset, tempgcr, track_size - trackoffset);
-            memcpy(ptr, tempgcr + (track_size - trackoffset), track_size - (track_size - trackoffset));
-#endif
-            lib_free(tempgcr);
-        } else {
-            memset(ptr, 0x55, track_size);
-        }
+    max_sector = disk_image_sector_per_track(image->type, track);
 
-        /* Clear odd track */
-        half_track++;
-#if 0
-        /* this does not work for some reason (skew.d64 fails) */
-        if (image->gcr->tracks[half_track].data) {
-            image->gcr->tracks[half_track].size = track_size;
-            ptr = image->gcr->tracks[half_track].data;
-            memset(ptr, 0, track_size);
-        }
-#else
-        /* create an (empty) half track */
-        if (image->gcr->tracks[half_track].data == NULL) {
-            image->gcr->tracks[half_track].data = lib_malloc(track_size);
-        } else if (image->gcr->tracks[half_track].size != (int)track_size) {
-            image->gcr->tracks[half_track].data = lib_realloc(image->gcr->tracks[half_track].data, track_size);
+    /* Clear track to avoid read errors.  */
+    ptr = tempgcr = lib_malloc(track_size);
+    memset(ptr, 0x55, track_size);
+
+    for (sector = 0; sector < max_sector; sector++) {
+        sectors = disk_image_check_sector(image, track, sector);
+        offset = sectors * 256;
+
+#ifdef HAVE_X64_IMAGE
+        if (image->type == DISK_IMAGE_TYPE_X64) {
+            offset += X64_HEADER_LENGTH;
         }
-        image->gcr->tracks[half_track].size = track_size;
-        ptr = image->gcr->tracks[half_track].data;
-        memset(ptr, 0, track_size);
 #endif
+        if (sectors >= 0) {
+            rf = CBMDOS_FDC_ERR_DRIVE;
+            if (fsimage_fpread(fsimage, buffer, 256, offset) >= 0) {
+                if (fsimage->error_info.map != NULL) {
+                    rf = fsimage->error_info.map[sectors];
+                }
+            }
+            header.sector = sector;
+            gcr_convert_sector_to_GCR(buffer, ptr, &header, headergap, synclen, rf);
+        }
 
+        ptr += SECTOR_GCR_SIZE_WITH_HEADER + headergap + gap + (synclen * 2);
     }
+
+    /* copy gcr data to final buffer with offset + wraparound */
+    trackoffset = fsimage->lazy_gcr.skew[track];
+    memcpy(raw->data + trackoffset, tempgcr, track_size - trackoffset);
+    memcpy(raw->data, tempgcr + (track_size - trackoffset), trackoffset);
+    lib_free(tempgcr);
     return 0;
 }
 
@@ -373,7 +376,7 @@ int fsimage_dxx_read_sector(const disk_image_t *image, uint8_t *buf, const disk_
 
     if (harderror == 0) {
         if (image->gcr == NULL) {
-            if (util_fpread(fsimage->fd, buf, 256, offset) < 0) {
+            if (fsimage_fpread(fsimage, buf, 256, offset) < 0) {
                 log_error(fsimage_dxx_log,
                         "Error reading T:%u S:%u from disk image.",
                         dadr->track, dadr->sector);
@@ -382,6 +385,7 @@ int fsimage_dxx_read_sector(const disk_image_t *image, uint8_t *buf, const disk_
                 rf = fsimage->error_info.map ? fsimage->error_info.map[sectors] : CBMDOS_FDC_ERR_OK;
             }
         } else {
+            fsimage_dxx_load_half_track(image, dadr->track * 2);
             rf = gcr_read_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector);
             /* HACK: if the image has an error map, and the "FDC" did not detect an
             error in the GCR stream, use the error from the error map instead.
@@ -450,12 +454,13 @@ int fsimage_dxx_write_sector(disk_image_t *image, const uint8_t *buf, const disk
         offset += X64_HEADER_LENGTH;
     }
 #endif
-    if (util_fpwrite(fsimage->fd, buf, 256, offset) < 0) {
+    if (fsimage_fpwrite(fsimage, buf, 256, offset) < 0) {
         log_error(fsimage_dxx_log, "Error writing T:%u S:%u to disk image.",
                   dadr->track, dadr->sector);
         return -1;
     }
-    if (image->gcr != NULL) {
+    /* a track that is not built yet is built from the image later */
+    if (image->gcr != NULL && image->gcr->tracks[(dadr->track * 2) - 2].data != NULL) {
         gcr_write_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector);
     }
 
@@ -469,7 +474,7 @@ int fsimage_dxx_write_sector(disk_image_t *image, const uint8_t *buf, const disk
         }
 #endif
         fsimage->error_info.map[sectors] = CBMDOS_FDC_ERR_OK;
-        if (util_fpwrite(fsimage->fd, &fsimage->error_info.map[sectors], 1, offset) < 0) {
+        if (fsimage_fpwrite(fsimage, &fsimage->error_info.map[sectors], 1, offset) < 0) {
             log_error(fsimage_dxx_log,
                     "Error writing T:%u S:%u error info to disk image.",
                     dadr->track, dadr->sector);
@@ -50,10 +50,16 @@ static const uint8_t gcr_image_header_expected_1571[] =
 /*-----------------------------------------------------------------------*/
 /* Intial GCR buffer setup.  */
 
+/* The tracks are only read when the drive first accesses them, see
+   fsimage_gcr_load_half_track().  */
 int fsimage_read_gcr_image(const disk_image_t *image)
 {
+    fsimage_t *fsimage = image->media.fsimage;
     unsigned int half_track;
 
+    if (fsimage->lazy_gcr.pending == NULL) {
+        fsimage->lazy_gcr.pending = lib_malloc(MAX_GCR_TRACKS);
+    }
     for (half_track = 0; half_track < MAX_GCR_TRACKS; half_track++) {
         /* free existing track */
         if (image->gcr->tracks[half_track].data) {
@@ -61,18 +67,40 @@ int fsimage_read_gcr_image(const disk_image_t *image)
             image->gcr->tracks[half_track].data = NULL;
             image->gcr->tracks[half_track].size = 0;
         }
-        /* load new track from image */
-        if (half_track < image->max_half_tracks) {
-            fsimage_gcr_read_half_track(image, half_track + 2, &image->gcr->tracks[half_track]);
-        } else {
-            /* create empty tracks for non existing tracks */
-            image->gcr->tracks[half_track].size = disk_image_raw_track_size(image->type, half_track / 2);
-            image->gcr->tracks[half_track].data = lib_malloc(image->gcr->tracks[half_track].size);
-            memset(image->gcr->tracks[half_track].data, 0, image->gcr->tracks[half_track].size);
-        }
+        fsimage->lazy_gcr.pending[half_track] = 1;
     }
     return 0;
 }
+
+/* Read a GCR track of the drive from the image, unless it is read already
+   or was restored from a snapshot.  */
+int fsimage_gcr_load_half_track(const disk_image_t *image, unsigned int half_track)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+    unsigned int index = half_track - 2;
+    disk_track_t *raw;
+
+    if (fsimage->lazy_gcr.pending == NULL || index >= MAX_GCR_TRACKS
+        || !fsimage->lazy_gcr.pending[index]) {
+        return 0;
+    }
+    fsimage->lazy_gcr.pending[index] = 0;
+
+    raw = &image->gcr->tracks[index];
+    if (raw->data != NULL) {
+        return 0;
+    }
+
+    /* load new track from image */
+    if (index < image->max_half_tracks) {
+        return fsimage_gcr_read_half_track(image, half_track, raw);
+    }
+
+    /* create empty tracks for non existing tracks */
+    raw->size = disk_image_raw_track_size(image->type, index / 2);
+    raw->data = lib_calloc(1, raw->size);
+    return 0;
+}
 /*-----------------------------------------------------------------------*/
 /* Seek to half track */
 
@@ -85,7 +113,7 @@ static long fsimage_gcr_seek_half_track(fsimage_t *fsimage, unsigned int half_tr
         log_error(fsimage_gcr_log, "Attempt to read without disk image.");
         return -1;
     }
-    if (util_fpread(fsimage->fd, buf, 12, 0) < 0) {
+    if (fsimage_fpread(fsimage, buf, 12, 0) < 0) {
         log_error(fsimage_gcr_log, "Could not read GCR disk image.");
         return -1;
     }
@@ -112,7 +140,7 @@ static long fsimage_gcr_seek_half_track(fsimage_t *fsimage, unsigned int half_tr
     }
 #endif
 
-    if (util_fpread(fsimage->fd, buf, 4, 12 + (half_track - 2) * 4) < 0) {
+    if (fsimage_fpread(fsimage, buf, 4, 12 + (half_track - 2) * 4) < 0) {
         log_error(fsimage_gcr_log, "Could not read GCR disk image.");
         return -1;
     }
@@ -144,7 +172,7 @@ int fsimage_gcr_read_half_track(const disk_image_t *image, unsigned int half_tra
     }
 
     if (offset != 0) {
-        if (util_fpread(fsimage->fd, buf, 2, offset) < 0) {
+        if (fsimage_fpread(fsimage, buf, 2, offset) < 0) {
             log_error(fsimage_gcr_log, "Could not read GCR disk image.");
             return -1;
         }
@@ -161,7 +189,7 @@ int fsimage_gcr_read_half_track(const disk_image_t *image, unsigned int half_tra
         raw->data = lib_calloc(1, track_len);
         raw->size = track_len;
 
-        if (fread(raw->data, track_len, 1, fsimage->fd) < 1) {
+        if (fsimage_fpread(fsimage, raw->data, track_len, offset + 2) < 0) {
             log_error(fsimage_gcr_log, "Could not read GCR disk image.");
             return -1;
         }
@@ -213,11 +241,8 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
     }
 
     if (offset == 0) {
-        offset = fseek(fsimage->fd, 0, SEEK_END);
-        if (offset == 0) {
-            offset = ftell(fsimage->fd);
-        }
-        if (offset < 0) {
+        offset = (long)fsimage_size(image);
+        if (offset <= 0) {
             log_error(fsimage_gcr_log, "Could not extend GCR disk image.");
             return -1;
         }
@@ -227,14 +252,14 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
     if (raw->data != NULL) {
         util_word_to_le_buf(buf, (uint16_t)raw->size);
 
-        if (util_fpwrite(fsimage->fd, buf, 2, offset) < 0) {
+        if (fsimage_fpwrite(fsimage, buf, 2, offset) < 0) {
             log_error(fsimage_gcr_log, "Could not write GCR disk image.");
             return -1;
         }
 
         /* Clear gap between the end of the actual track and the start of
            the next track.  */
-        if (fwrite(raw->data, raw->size, 1, fsimage->fd) < 1) {
+        if (fsimage_fpwrite(fsimage, raw->data, raw->size, offset + 2) < 0) {
             log_error(fsimage_gcr_log, "Could not write GCR disk image.");
             return -1;
         }
@@ -242,9 +267,9 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
 
         if (gap > 0) {
             uint8_t *padding = lib_calloc(1, gap);
-            res = fwrite(padding, gap, 1, fsimage->fd);
+            res = fsimage_fpwrite(fsimage, padding, gap, offset + 2 + raw->size);
             lib_free(padding);
-            if (res < 1) {
+            if (res < 0) {
                 log_error(fsimage_gcr_log, "Could not write GCR disk image.");
                 return -1;
             }
@@ -257,13 +282,13 @@ int fsimage_gcr_write_half_track(disk_image_t *image, unsigned int half_track,
              *        -- compyx 2020-07-24
              */
             util_dword_to_le_buf(buf, (uint32_t)offset);
-            if (util_fpwrite(fsimage->fd, buf, 4, 12 + (half_track - 2) * 4) < 0) {
+            if (fsimage_fpwrite(fsimage, buf, 4, 12 + (half_track - 2) * 4) < 0) {
                 log_error(fsimage_gcr_log, "Could not write GCR disk image.");
                 return -1;
             }
 
             util_dword_to_le_buf(buf, disk_image_speed_map(image->type, half_track / 2));
-            if (util_fpwrite(fsimage->fd, buf, 4, 12 + (half_track - 2 + num_half_tracks) * 4) < 0) {
+            if (fsimage_fpwrite(fsimage, buf, 4, 12 + (half_track - 2 + num_half_tracks) * 4) < 0) {
                 log_error(fsimage_gcr_log, "Could not write GCR disk image.");
                 return -1;
             }
@@ -307,6 +332,7 @@ int fsimage_gcr_read_sector(const disk_image_t *image, uint8_t *buf, const disk_
         rf = gcr_read_sector(&raw, buf, (uint8_t)dadr->sector);
         lib_free(raw.data);
     } else {
+        fsimage_gcr_load_half_track(image, dadr->track * 2);
         rf = gcr_read_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector);
     }
     if (rf != CBMDOS_FDC_ERR_OK) {
@@ -376,6 +402,7 @@ int fsimage_gcr_write_sector(disk_image_t *image, const uint8_t *buf,
         }
         lib_free(raw.data);
     } else {
+        fsimage_gcr_load_half_track(image, dadr->track * 2);
         if (gcr_write_sector(&image->gcr->tracks[(dadr->track * 2) - 2], buf, (uint8_t)dadr->sector) != CBMDOS_FDC_ERR_OK) {
             log_error(fsimage_gcr_log,
                       "Could not find track %u sector %u in disk image",
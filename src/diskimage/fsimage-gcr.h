@@ -36,6 +36,7 @@ struct disk_addr_s;
 void fsimage_gcr_init(void);
 
 int fsimage_read_gcr_image(const disk_image_t *image);
+int fsimage_gcr_load_half_track(const disk_image_t *image, unsigned int half_track);
 
 int fsimage_gcr_read_sector(const struct disk_image_s *image, uint8_t *buf,
                             const struct disk_addr_s *dadr);
@@ -28,6 +28,11 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef UNIX_COMPILE
+#include <sys/mman.h>
+#endif
 
 #include "archdep.h"
 #include "diskconstants.h"
@@ -47,6 +52,9 @@
 
 static log_t fsimage_log = LOG_DEFAULT;
 
+/* copy-on-write mode for images opened from now on */
+static int fsimage_cow_mode = FSIMAGE_COW_OFF;
+
 
 /** \brief  Set image name
  *
@@ -122,14 +130,219 @@ void fsimage_media_destroy(disk_image_t *image)
 
 /*-----------------------------------------------------------------------*/
 
+/*-----------------------------------------------------------------------*/
+/* Copy-on-write images.
+
+   The image is mapped privately, so all instances attaching the same file
+   share its pages in the page cache until they write to them. Writes only
+   change this instance's copy and mark the 256 byte blocks they touch as
+   dirty, which are written back to the file on detach if asked to.  */
+
+void fsimage_set_copy_on_write(int mode)
+{
+    fsimage_cow_mode = mode;
+}
+
+/* images the sector and track code reads through fsimage_fpread(), CMDHD
+   images are accessed through the file directly */
+static int fsimage_cow_supported(const disk_image_t *image)
+{
+    switch (image->type) {
+        case DISK_IMAGE_TYPE_D64:
+        case DISK_IMAGE_TYPE_D67:
+        case DISK_IMAGE_TYPE_D71:
+        case DISK_IMAGE_TYPE_D81:
+        case DISK_IMAGE_TYPE_D80:
+        case DISK_IMAGE_TYPE_D82:
+#ifdef HAVE_X64_IMAGE
+        case DISK_IMAGE_TYPE_X64:
+#endif
+        case DISK_IMAGE_TYPE_D1M:
+        case DISK_IMAGE_TYPE_D2M:
+        case DISK_IMAGE_TYPE_D4M:
+        case DISK_IMAGE_TYPE_D90:
+        case DISK_IMAGE_TYPE_G64:
+        case DISK_IMAGE_TYPE_G71:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int fsimage_cow_open(fsimage_t *fsimage)
+{
+    off_t size;
+    uint8_t *data;
+
+    size = archdep_file_size(fsimage->fd);
+    if (size <= 0) {
+        return -1;
+    }
+
+#ifdef UNIX_COMPILE
+    fflush(fsimage->fd);
+    data = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                fileno(fsimage->fd), 0);
+    if (data != MAP_FAILED) {
+        fsimage->cow.mapped = 1;
+    } else
+#endif
+    {
+        /* no mmap(), keep a private copy in memory */
+        data = lib_malloc((size_t)size);
+        if (util_fpread(fsimage->fd, data, (size_t)size, 0) < 0) {
+            lib_free(data);
+            return -1;
+        }
+        fsimage->cow.mapped = 0;
+    }
+
+    fsimage->cow.data = data;
+    fsimage->cow.size = (size_t)size;
+    fsimage->cow.dirty = lib_calloc(((size_t)size + 255) / 256, 1);
+    return 0;
+}
+
+static void fsimage_cow_free_data(fsimage_t *fsimage)
+{
+#ifdef UNIX_COMPILE
+    if (fsimage->cow.mapped) {
+        munmap(fsimage->cow.data, fsimage->cow.size);
+    } else
+#endif
+    {
+        lib_free(fsimage->cow.data);
+    }
+    fsimage->cow.data = NULL;
+}
+
+/* make room for writes beyond the end of the image */
+static void fsimage_cow_grow(fsimage_t *fsimage, size_t size)
+{
+    uint8_t *data;
+    size_t blocks = (fsimage->cow.size + 255) / 256;
+
+    data = lib_malloc(size);
+    memcpy(data, fsimage->cow.data, fsimage->cow.size);
+    memset(data + fsimage->cow.size, 0, size - fsimage->cow.size);
+    fsimage_cow_free_data(fsimage);
+
+    fsimage->cow.dirty = lib_realloc(fsimage->cow.dirty, (size + 255) / 256);
+    memset(fsimage->cow.dirty + blocks, 0, (size + 255) / 256 - blocks);
+    fsimage->cow.data = data;
+    fsimage->cow.size = size;
+    fsimage->cow.mapped = 0;
+}
+
+/* write the dirty blocks back to the file */
+static int fsimage_cow_flush(disk_image_t *image)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+    size_t blocks = (fsimage->cow.size + 255) / 256;
+    size_t block, end, offset, len;
+    int result = 0;
+
+    for (block = 0; block < blocks; block = end) {
+        if (!fsimage->cow.dirty[block]) {
+            end = block + 1;
+            continue;
+        }
+        for (end = block + 1; end < blocks && fsimage->cow.dirty[end]; end++) {
+        }
+        if (image->read_only) {
+            log_error(fsimage_log, "Cannot write changes back to read-only file `%s'.",
+                      fsimage->name);
+            return -1;
+        }
+        offset = block * 256;
+        len = end * 256 < fsimage->cow.size ? end * 256 - offset : fsimage->cow.size - offset;
+        if (util_fpwrite(fsimage->fd, fsimage->cow.data + offset, len, (long)offset) < 0) {
+            result = -1;
+        }
+    }
+    fflush(fsimage->fd);
+    if (result < 0) {
+        log_error(fsimage_log, "Cannot write changes back to `%s'.", fsimage->name);
+    }
+    return result;
+}
+
+static void fsimage_cow_close(disk_image_t *image)
+{
+    fsimage_t *fsimage = image->media.fsimage;
+
+    if (fsimage->cow.data == NULL) {
+        return;
+    }
+    if (fsimage->cow.flush) {
+        fsimage_cow_flush(image);
+    }
+    fsimage_cow_free_data(fsimage);
+    lib_free(fsimage->cow.dirty);
+    fsimage->cow.dirty = NULL;
+    fsimage->cow.size = 0;
+    fsimage->cow.flush = 0;
+}
+
+/** \brief  Read bytes from a position in the image
+ *
+ * Reads from the private copy of a copy-on-write image, from the file
+ * otherwise.
+ *
+ * \return  0 on success, -1 on error
+ */
+int fsimage_fpread(fsimage_t *fsimage, void *buf, size_t num, long offset)
+{
+    if (fsimage->cow.data == NULL) {
+        return util_fpread(fsimage->fd, buf, num, offset);
+    }
+    if (offset < 0 || (size_t)offset + num > fsimage->cow.size) {
+        return -1;
+    }
+    memcpy(buf, fsimage->cow.data + offset, num);
+    return 0;
+}
+
+/** \brief  Write bytes to a position in the image
+ *
+ * Writes to the private copy of a copy-on-write image, to the file
+ * otherwise.
+ *
+ * \return  0 on success, -1 on error
+ */
+int fsimage_fpwrite(fsimage_t *fsimage, const void *buf, size_t num, long offset)
+{
+    size_t block, end;
+
+    if (fsimage->cow.data == NULL) {
+        return util_fpwrite(fsimage->fd, buf, num, offset);
+    }
+    if (offset < 0) {
+        return -1;
+    }
+    end = (size_t)offset + num;
+    if (end > fsimage->cow.size) {
+        fsimage_cow_grow(fsimage, end);
+    }
+    memcpy(fsimage->cow.data + offset, buf, num);
+    for (block = (size_t)offset / 256; block < (end + 255) / 256; block++) {
+        fsimage->cow.dirty[block] = 1;
+    }
+    return 0;
+}
+
+/*-----------------------------------------------------------------------*/
+
 int fsimage_open(disk_image_t *image)
 {
     fsimage_t *fsimage;
     size_t length;
     unsigned int isdir;
+    unsigned int read_only;
 
     fsimage = image->media.fsimage;
     fsimage->error_info.map = NULL;
+    read_only = image->read_only;
 
     /* stat file to find out if it exists or if it is a directory */
     if (archdep_stat(fsimage->name, &length, &isdir) < 0) {
@@ -162,6 +375,16 @@ int fsimage_open(disk_image_t *image)
     }
 
     if (fsimage_probe(image) == 0) {
+        if (fsimage_cow_mode != FSIMAGE_COW_OFF && fsimage_cow_supported(image)) {
+            if (fsimage_cow_open(fsimage) < 0) {
+                log_warning(fsimage_log, "Cannot open `%s' copy-on-write.", fsimage->name);
+            } else if (fsimage_cow_mode == FSIMAGE_COW_FLUSH) {
+                fsimage->cow.flush = 1;
+            } else {
+                /* nothing is written to the file, a read-only file will do */
+                image->read_only = read_only;
+            }
+        }
         return 0;
     }
 
@@ -190,6 +413,12 @@ int fsimage_close(disk_image_t *image)
         lib_free(fsimage->error_info.map);
         fsimage->error_info.map = NULL;
     }
+    lib_free(fsimage->lazy_gcr.pending);
+    fsimage->lazy_gcr.pending = NULL;
+    lib_free(fsimage->lazy_gcr.skew);
+    fsimage->lazy_gcr.skew = NULL;
+
+    fsimage_cow_close(image);
     zfile_fclose(fsimage->fd);
     fsimage->fd = NULL;
 
@@ -305,5 +534,8 @@ off_t fsimage_size(const disk_image_t *image)
     fsimage_t *fsimage;
 
     fsimage = image->media.fsimage;
+    if (fsimage->cow.data != NULL) {
+        return (off_t)fsimage->cow.size;
+    }
     return archdep_file_size(fsimage->fd);
 }
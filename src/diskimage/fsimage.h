@@ -42,8 +42,30 @@ typedef struct fsimage_s {
         int dirty;
         int len;
     } error_info;
+    /* private copy of the image, see fsimage_fpread() */
+    struct {
+        uint8_t *data;      /* NULL if reads and writes go to the file */
+        size_t size;
+        int mapped;         /* data is mmap()ed instead of allocated */
+        uint8_t *dirty;     /* per 256 byte block, set when written */
+        int flush;          /* write the dirty blocks back on close */
+    } cow;
+    /* GCR tracks built on first access, see disk_image_load_half_track() */
+    struct {
+        uint8_t *pending;   /* per half track, set until it is built */
+        unsigned int *skew; /* per track, offset of the first sector */
+        unsigned int tracks;
+        uint8_t id[2][2];   /* disk ID of each side */
+        int two_single_sides;
+        int blank_side;     /* empty second side for a 1571 */
+    } lazy_gcr;
 } fsimage_t;
 
+/* values of the "DiskImageCopyOnWrite" resource */
+#define FSIMAGE_COW_OFF     0   /* writes go to the file */
+#define FSIMAGE_COW_DISCARD 1   /* writes are private, dropped on detach */
+#define FSIMAGE_COW_FLUSH   2   /* writes are private, saved on detach */
+
 
 void fsimage_init(void);
 
@@ -61,4 +83,8 @@ int fsimage_write_sector(struct disk_image_s *image, const uint8_t *buf,
                          const struct disk_addr_s *dadr);
 off_t fsimage_size(const disk_image_t *image);
 
+void fsimage_set_copy_on_write(int mode);
+int fsimage_fpread(fsimage_t *fsimage, void *buf, size_t num, long offset);
+int fsimage_fpwrite(fsimage_t *fsimage, const void *buf, size_t num, long offset);
+
 #endif
@@ -838,6 +838,9 @@ static int drive_snapshot_write_gcrimage_module(snapshot_t *s, unsigned int dnr)
 
     /* Write half track data */
     for (i = 0; i < num_half_tracks; i++) {
+        if (drive->image != NULL) {
+            disk_image_load_half_track(drive->image, i + 2);
+        }
         data = drive->gcr->tracks[i].data;
         track_size = data ? drive->gcr->tracks[i].size : 0;
         if (0
@@ -718,6 +718,9 @@ void drive_set_half_track(int num, int side, drive_t *dptr)
     /* FIXME: why would the offset be different for D71 and G71? */
     tmp = (dptr->image && dptr->image->type == DISK_IMAGE_TYPE_G71) ? DRIVE_HALFTRACKS_1571 : 70;
 
+    if (dptr->image) {
+        disk_image_load_half_track(dptr->image, dptr->current_half_track + (dptr->side * tmp));
+    }
     dptr->GCR_track_start_ptr = dptr->gcr->tracks[dptr->current_half_track - 2 + (dptr->side * tmp)].data;
 
     if (dptr->GCR_current_track_size != 0) {
@@ -834,6 +837,7 @@ void drive_gcr_data_writeback(drive_t *drive)
         DBG(("extend track: %u drive->image->max_half_tracks: %u drive->image->tracks: %u", track, drive->image->max_half_tracks, drive->image->tracks));
         while (half_track < end_half_track) {
             DBG(("write halftrack: %u end: %u track: %u", half_track, end_half_track, half_track / 2));
+            disk_image_load_half_track(drive->image, half_track);
             disk_image_write_half_track(drive->image, half_track, &drive->gcr->tracks[half_track - 2]);
             half_track += 2;
         }
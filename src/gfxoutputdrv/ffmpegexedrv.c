@@ -68,6 +68,7 @@
 #include "lib.h"
 #include "log.h"
 #include "machine.h"
+#include "movieencoder.h"
 #include "palette.h"
 #include "resources.h"
 #include "screenshot.h"
@@ -240,6 +241,12 @@ typedef struct {
 } VIDEOFrame;
 static VIDEOFrame *video_st_frame;
 
+/* a job holds the palette, then the indexed frame */
+#define JOB_PALETTE_SIZE    (256 * 3)
+
+/* converts frames and writes them to the video socket */
+static movieencoder_t *encoder = NULL;
+
 /* input audio stream */
 #define AUDIO_BUFFER_SAMPLES        0x400
 #define AUDIO_BUFFER_MAX_CHANNELS   2
@@ -1081,36 +1088,99 @@ static soundmovie_funcs_t ffmpegexedrv_soundmovie_funcs = {
    video stream encoding
  *****************************************************************************/
 
-static int video_fill_rgb_image(screenshot_t *screenshot, VIDEOFrame *pic)
+/* copies palette and pixels into a job, the only work left on the emulation thread */
+static void video_fill_indexed_image(screenshot_t *screenshot, uint8_t *pal, uint8_t *screen)
 {
     int x, y;
     int dx, dy;
-    int colnum;
     int bufferoffset;
     int x_dim = screenshot->width;
     int y_dim = screenshot->height;
-    int pix = 0;
     /* center the screenshot in the video */
-    pic->linesize = video_width * INPUT_VIDEO_BPP;
     dx = (video_width - x_dim) / 2;
     dy = (video_height - y_dim) / 2;
     bufferoffset = screenshot->x_offset + (dx < 0 ? -dx : 0)
         + (screenshot->y_offset + (dy < 0 ? -dy : 0)) * screenshot->draw_buffer_line_size;
 
+    for (x = 0; x < 256; x++) {
+        pal[x * 3] = screenshot->palette->entries[x].red;
+        pal[x * 3 + 1] = screenshot->palette->entries[x].green;
+        pal[x * 3 + 2] = screenshot->palette->entries[x].blue;
+    }
+
+    for (y = 0; y < video_height; y++) {
+        memcpy(screen + y * video_width, screenshot->draw_buffer + bufferoffset, video_width);
+        bufferoffset += screenshot->draw_buffer_line_size;
+    }
+}
+
+/* converts a job to RGB, on the encoder thread */
+static int video_fill_rgb_image(const uint8_t *pal, const uint8_t *screen, VIDEOFrame *pic)
+{
+    int x, y;
+    int colnum;
+    int pix = 0;
+
+    pic->linesize = video_width * INPUT_VIDEO_BPP;
+
     for (y = 0; y < video_height; y++) {
         for (x = 0; x < video_width; x++) {
-            colnum = screenshot->draw_buffer[bufferoffset + x];
-            pic->data[pix + INPUT_VIDEO_BPP * x] = screenshot->palette->entries[colnum].red;
-            pic->data[pix + INPUT_VIDEO_BPP * x + 1] = screenshot->palette->entries[colnum].green;
-            pic->data[pix + INPUT_VIDEO_BPP * x + 2] = screenshot->palette->entries[colnum].blue;
+            colnum = screen[x];
+            pic->data[pix + INPUT_VIDEO_BPP * x] = pal[colnum * 3];
+            pic->data[pix + INPUT_VIDEO_BPP * x + 1] = pal[colnum * 3 + 1];
+            pic->data[pix + INPUT_VIDEO_BPP * x + 2] = pal[colnum * 3 + 2];
         }
-        bufferoffset += screenshot->draw_buffer_line_size;
+        screen += video_width;
         pix += pic->linesize;
     }
 
     return 0;
 }
 
+/* movieencoder callback, runs on the encoder thread */
+static int video_encode_job(movieencoder_job_t *job)
+{
+    unsigned int i;
+
+    /* frames dropped on the emulation thread repeat the last one */
+    for (i = 0; i < job->dropped; i++) {
+        if (write_video_frame(video_st_frame) < 0) {
+            return -1;
+        }
+    }
+
+    video_fill_rgb_image(job->data, job->data + JOB_PALETTE_SIZE, video_st_frame);
+
+    return (write_video_frame(video_st_frame) < 0) ? -1 : 0;
+}
+
+/* hands a frame over to the encoder thread */
+static int video_queue_frame(screenshot_t *screenshot)
+{
+    movieencoder_job_t *job;
+
+    if ((video_has_codec <= 0) || (video_codec == AV_CODEC_ID_NONE)) {
+        return 0;
+    }
+    if (ffmpeg_video_socket == 0) {
+        log_error(ffmpeg_log, "FFMPEG: video_queue_frame ffmpeg_video_socket is 0 (framecount:%"PRIu64")", framecounter);
+        return -1;
+    }
+
+    if (movieencoder_job_get(encoder, MOVIEENCODER_VIDEO, &job) < 0) {
+        return -1;
+    }
+    if (job == NULL) {
+        /* the encoder is behind, it repeats the last frame instead */
+        return 0;
+    }
+    video_fill_indexed_image(screenshot, job->data, job->data + JOB_PALETTE_SIZE);
+    job->size = JOB_PALETTE_SIZE + video_width * video_height;
+    movieencoder_job_put(encoder, job);
+
+    return 0;
+}
+
 /* called by ffmpegexedrv_open_video() */
 static VIDEOFrame* video_alloc_picture(int bpp, int width, int height)
 {
@@ -1151,6 +1221,8 @@ static int ffmpegexedrv_open_video(void)
         return -1;
     }
 
+    encoder = movieencoder_new("FFMPEG", JOB_PALETTE_SIZE + video_width * video_height, video_encode_job);
+
     return 0;
 }
 
@@ -1292,6 +1364,12 @@ static int ffmpegexedrv_close(screenshot_t *screenshot)
 
     soundmovie_stop();
 
+    /* write out what is queued before the streams are closed */
+    if (movieencoder_destroy(encoder) < 0) {
+        log_error(ffmpeg_log, "ffmpegexedrv: Error writing to VIDEO socket");
+    }
+    encoder = NULL;
+
     ffmpegexedrv_close_video();
     ffmpegexedrv_close_audio();
 
@@ -1341,9 +1419,7 @@ static int ffmpegexedrv_record(screenshot_t *screenshot)
     }
 
     /*DBGFRAMES(("ffmpegexedrv_record (%u)", framecounter));*/
-    video_fill_rgb_image(screenshot, video_st_frame);
-
-    if (write_video_frame(video_st_frame) < 0) {
+    if (video_queue_frame(screenshot) < 0) {
         return -1;
     }
 
@@ -1353,7 +1429,7 @@ static int ffmpegexedrv_record(screenshot_t *screenshot)
         framecounter++;
         DBG(("video is late, inserting a frame (framecount:%lu, audiocount:%lu frametime:%f, audiotime:%f)",
             framecounter, audio_input_counter, frametime, audiotime));
-        if (write_video_frame(video_st_frame) < 0) {
+        if (video_queue_frame(screenshot) < 0) {
             return -1;
         }
     }
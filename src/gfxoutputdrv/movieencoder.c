@@ -0,0 +1,284 @@
+/** \file   movieencoder.c
+ * \brief   Encoder thread for the movie drivers
+ *
+ * Converting, compressing and writing a movie frame inside the vsync hook
+ * stalls emulation for as long as the encoder takes. The drivers instead
+ * copy each frame into a slot of a small ring, which a dedicated thread
+ * empties in order. When the ring is full a video frame waits for a free
+ * slot in warp mode, so the encoder throttles the emulation, and is dropped
+ * at normal speed, where waiting would break the realtime sync. Drivers
+ * encode dropped frames as copies of the last frame so the movie keeps its
+ * timing. Audio chunks are never dropped.
+ *
+ * Without pthreads every job is encoded right away on the emulation thread.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(USE_VICE_THREAD) || defined(HAVE_PTHREAD)
+#define MOVIEENCODER_THREAD
+#include <pthread.h>
+#endif
+
+#include "lib.h"
+#include "log.h"
+#include "movieencoder.h"
+#include "vsync.h"
+
+struct movieencoder_s {
+    char *name;
+    movieencoder_encode_t encode;
+    movieencoder_job_t jobs[MOVIEENCODER_SLOTS];
+    unsigned int head;      /**< next slot to fill */
+    unsigned int tail;      /**< next slot to encode */
+    unsigned int count;     /**< slots queued */
+    unsigned int dropped;   /**< frames dropped since the last queued one */
+    int error;
+    int threaded;
+
+    /* statistics, logged when the encoder is destroyed */
+    unsigned long frames;
+    unsigned long frames_dropped;
+    unsigned long waits;
+
+#ifdef MOVIEENCODER_THREAD
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    int quit;
+#endif
+};
+
+static log_t movieencoder_log = LOG_DEFAULT;
+
+#ifdef MOVIEENCODER_THREAD
+#define LOCK(enc)   if ((enc)->threaded) { pthread_mutex_lock(&(enc)->lock); }
+#define UNLOCK(enc) if ((enc)->threaded) { pthread_mutex_unlock(&(enc)->lock); }
+
+static void *movieencoder_thread(void *param)
+{
+    movieencoder_t *enc = param;
+
+    pthread_mutex_lock(&enc->lock);
+    while (1) {
+        movieencoder_job_t *job;
+        int result = 0;
+
+        while (enc->count == 0 && !enc->quit) {
+            pthread_cond_wait(&enc->not_empty, &enc->lock);
+        }
+        if (enc->count == 0) {
+            /* asked to quit and everything is written */
+            break;
+        }
+        job = &enc->jobs[enc->tail];
+        pthread_mutex_unlock(&enc->lock);
+
+        /* after an error the queue is only drained */
+        if (!enc->error) {
+            result = enc->encode(job);
+        }
+
+        pthread_mutex_lock(&enc->lock);
+        if (result < 0) {
+            enc->error = 1;
+        }
+        enc->tail = (enc->tail + 1) % MOVIEENCODER_SLOTS;
+        enc->count--;
+        pthread_cond_signal(&enc->not_full);
+    }
+    pthread_mutex_unlock(&enc->lock);
+
+    return NULL;
+}
+#else
+#define LOCK(enc)
+#define UNLOCK(enc)
+#endif
+
+/** \brief  Create an encoder and start its thread
+ *
+ * \param[in]   name        driver name for the log
+ * \param[in]   slot_size   bytes per slot, enough for a frame or audio chunk
+ * \param[in]   encode      called on the encoder thread for each job
+ *
+ * \return  the encoder, or NULL on error
+ */
+movieencoder_t *movieencoder_new(const char *name, size_t slot_size, movieencoder_encode_t encode)
+{
+    movieencoder_t *enc;
+    int i;
+
+    if (movieencoder_log == LOG_DEFAULT) {
+        movieencoder_log = log_open("MovieEncoder");
+    }
+
+    enc = lib_calloc(1, sizeof(movieencoder_t));
+    enc->name = lib_strdup(name);
+    enc->encode = encode;
+    for (i = 0; i < MOVIEENCODER_SLOTS; i++) {
+        enc->jobs[i].data = lib_malloc(slot_size);
+    }
+
+#ifdef MOVIEENCODER_THREAD
+    pthread_mutex_init(&enc->lock, NULL);
+    pthread_cond_init(&enc->not_empty, NULL);
+    pthread_cond_init(&enc->not_full, NULL);
+    enc->threaded = 1;
+    if (pthread_create(&enc->thread, NULL, movieencoder_thread, enc) != 0) {
+        log_warning(movieencoder_log, "%s: could not start the encoder thread, encoding synchronously.", name);
+        enc->threaded = 0;
+    }
+#endif
+
+    return enc;
+}
+
+/** \brief  Get the next free slot
+ *
+ * Fill in job->size and job->data, then hand the job over with
+ * movieencoder_job_put(). A video frame is dropped instead of waiting for
+ * a slot outside of warp mode, *job is NULL then.
+ *
+ * \param[in]   enc     encoder
+ * \param[in]   type    MOVIEENCODER_VIDEO or MOVIEENCODER_AUDIO
+ * \param[out]  job     the slot, or NULL if the frame is dropped
+ *
+ * \return  0 on success, -1 if encoding failed earlier
+ */
+int movieencoder_job_get(movieencoder_t *enc, int type, movieencoder_job_t **job)
+{
+    movieencoder_job_t *j;
+
+    *job = NULL;
+
+    LOCK(enc);
+    if (enc->count == MOVIEENCODER_SLOTS && !enc->error) {
+        if (type == MOVIEENCODER_VIDEO && !vsync_get_warp_mode()) {
+            enc->dropped++;
+            enc->frames_dropped++;
+            UNLOCK(enc);
+            if (enc->frames_dropped == 1) {
+                log_warning(movieencoder_log, "%s: the encoder can't keep up, dropping frames.", enc->name);
+            }
+            return 0;
+        }
+        enc->waits++;
+#ifdef MOVIEENCODER_THREAD
+        while (enc->count == MOVIEENCODER_SLOTS && !enc->error) {
+            pthread_cond_wait(&enc->not_full, &enc->lock);
+        }
+#endif
+    }
+    if (enc->error) {
+        UNLOCK(enc);
+        return -1;
+    }
+
+    j = &enc->jobs[enc->head];
+    j->type = type;
+    j->size = 0;
+    j->dropped = 0;
+    if (type == MOVIEENCODER_VIDEO) {
+        j->dropped = enc->dropped;
+        enc->dropped = 0;
+    }
+    UNLOCK(enc);
+
+    *job = j;
+    return 0;
+}
+
+/** \brief  Queue a job filled in after movieencoder_job_get()
+ *
+ * \param[in]   enc     encoder
+ * \param[in]   job     the job
+ */
+void movieencoder_job_put(movieencoder_t *enc, movieencoder_job_t *job)
+{
+    if (job->type == MOVIEENCODER_VIDEO) {
+        enc->frames++;
+    }
+
+    if (!enc->threaded) {
+        if (enc->encode(job) < 0) {
+            enc->error = 1;
+        }
+        return;
+    }
+
+#ifdef MOVIEENCODER_THREAD
+    pthread_mutex_lock(&enc->lock);
+    enc->head = (enc->head + 1) % MOVIEENCODER_SLOTS;
+    enc->count++;
+    pthread_cond_signal(&enc->not_empty);
+    pthread_mutex_unlock(&enc->lock);
+#endif
+}
+
+/** \brief  Encode what is still queued, stop the thread and free the encoder
+ *
+ * \param[in]   enc     encoder
+ *
+ * \return  0 on success, -1 if encoding failed at some point
+ */
+int movieencoder_destroy(movieencoder_t *enc)
+{
+    int result;
+    int i;
+
+    if (enc == NULL) {
+        return 0;
+    }
+
+#ifdef MOVIEENCODER_THREAD
+    if (enc->threaded) {
+        pthread_mutex_lock(&enc->lock);
+        enc->quit = 1;
+        pthread_cond_signal(&enc->not_empty);
+        pthread_mutex_unlock(&enc->lock);
+        pthread_join(enc->thread, NULL);
+    }
+    pthread_cond_destroy(&enc->not_full);
+    pthread_cond_destroy(&enc->not_empty);
+    pthread_mutex_destroy(&enc->lock);
+#endif
+
+    log_message(movieencoder_log, "%s: %lu frames, %lu dropped, waited %lu times for the encoder.",
+                enc->name, enc->frames, enc->frames_dropped, enc->waits);
+
+    result = enc->error ? -1 : 0;
+
+    for (i = 0; i < MOVIEENCODER_SLOTS; i++) {
+        lib_free(enc->jobs[i].data);
+    }
+    lib_free(enc->name);
+    lib_free(enc);
+
+    return result;
+}
@@ -0,0 +1,57 @@
+/** \file   movieencoder.h
+ * \brief   Encoder thread for the movie drivers - header
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_MOVIEENCODER_H
+#define VICE_MOVIEENCODER_H
+
+#include <stddef.h>
+
+#include "types.h"
+
+/* job types */
+#define MOVIEENCODER_VIDEO  0
+#define MOVIEENCODER_AUDIO  1
+
+/* frames that can wait for the encoder */
+#define MOVIEENCODER_SLOTS  8
+
+typedef struct movieencoder_job_s {
+    int type;
+    unsigned int dropped;   /**< video frames dropped right before this one */
+    size_t size;            /**< bytes used in data */
+    uint8_t *data;          /**< slot_size bytes, layout defined by the driver */
+} movieencoder_job_t;
+
+/* runs on the encoder thread, must not log, returns < 0 on error */
+typedef int (*movieencoder_encode_t)(movieencoder_job_t *job);
+
+typedef struct movieencoder_s movieencoder_t;
+
+movieencoder_t *movieencoder_new(const char *name, size_t slot_size, movieencoder_encode_t encode);
+int movieencoder_job_get(movieencoder_t *enc, int type, movieencoder_job_t **job);
+void movieencoder_job_put(movieencoder_t *enc, movieencoder_job_t *job);
+int movieencoder_destroy(movieencoder_t *enc);
+
+#endif
@@ -41,6 +41,7 @@
 #include "machine.h"
 #include "maincpu.h"
 #include "math.h"
+#include "movieencoder.h"
 #include "palette.h"
 #include "resources.h"
 #include "screenshot.h"
@@ -89,8 +90,6 @@ static int no_zlib = 0;
 
 static uint8_t cur_pal[PALETTE_SIZE];
 
-static int16_t cur_audio[MAX_AUDIO_BUFFER_SIZE];
-
 static zmbv_avi_t zavi;
 static zmbv_codec_t zcodec;
 static zmbv_format_t fmt;
@@ -103,6 +102,9 @@ static int audio_codec;
 
 static uint8_t *cur_screen = NULL;
 
+/* converts, compresses and writes frames and audio chunks in order */
+static movieencoder_t *encoder = NULL;
+
 /* general */
 static int file_init_done = 1;
 
@@ -121,6 +123,7 @@ static unsigned int framecounter;
 /* resources */
 static int format_index = 0;
 static char *zmbv_format = NULL;
+static int frame_interval = 1;  /* record every Nth emulated frame */
 
 /* these are dictated by the emulator */
 static int audio_freq = 48000;    /* initialized by zmbv_soundmovie_init */
@@ -218,6 +221,20 @@ static int set_video_codec(int val, void *param)
     return 0;
 }
 
+static int set_frame_interval(int val, void *param)
+{
+    if (val < 1 || val > 50) {
+        return -1;
+    }
+    if (frame_interval != val && screenshot_is_recording()) {
+        ui_error("Can't change framerate while recording. Try again later.");
+        return 0;
+    }
+
+    frame_interval = val;
+    return 0;
+}
+
 /*---------- Resources ------------------------------------------------*/
 
 static const resource_string_t resources_string[] = {
@@ -231,6 +248,8 @@ static const resource_int_t resources_int[] = {
       &audio_codec, set_audio_codec, NULL },
     { "ZMBVVideoCodec", AV_CODEC_ID_ZMBV, RES_EVENT_NO, NULL,
       &video_codec, set_video_codec, NULL },
+    { "ZMBVFrameInterval", 1, RES_EVENT_NO, NULL,
+      &frame_interval, set_frame_interval, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -248,6 +267,9 @@ static int zmbvdrv_resources_init(void)
 
 static const cmdline_option_t cmdline_options[] =
 {
+    { "-zmbvframeinterval", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "ZMBVFrameInterval", NULL,
+      "<1-50>", "Record every Nth emulated frame, the movie frame rate is divided accordingly" },
     CMDLINE_LIST_END
 };
 
@@ -325,6 +347,7 @@ static int zmbv_soundmovie_init(int speed, int channels, soundmovie_buffer_t **
 /* triggered by soundffmpegaudio->write */
 static int zmbv_soundmovie_encode(soundmovie_buffer_t *audio_in)
 {
+    movieencoder_job_t *job;
     int ret = 0;
 
     clk_last_audio_frame = clk_this_audio_frame;
@@ -333,37 +356,33 @@ static int zmbv_soundmovie_encode(soundmovie_buffer_t *audio_in)
     LOGFRAMES(("zmbv_soundmovie_encode(size:%d used:%d channels:%d) clk:%ld frame:%d",
                audio_in->size, audio_in->used, audio_channels, clk_this_audio_frame, frameno));
 
+    if (encoder == NULL) {
+        audio_in->used = 0;
+        return 0;
+    }
+    if (movieencoder_job_get(encoder, MOVIEENCODER_AUDIO, &job) < 0) {
+        audio_in->used = 0;
+        return -1;
+    }
+
     /* FIXME: we might have an endianess problem here, we might have to swap lo/hi on BE machines */
     if (audio_channels == 1) {
+        int16_t *out = (int16_t *)job->data;
         int i, o;
-#if 1
         /* convert mono -> stereo */
         for (i = o = 0; i < audio_in->used; i++, o+=2) {
-            cur_audio[o] = audio_in->buffer[i];
-            cur_audio[o+1] = audio_in->buffer[i];
-        }
-        /* write avi chunks */
-        if (zmbv_avi_write_chunk_audio(zavi, &cur_audio[0], audio_in->used * 4) < 0) {
-            LOG(("FATAL: can't write audio frame for screen #%d", frameno));
-            ret = -1;
+            out[o] = audio_in->buffer[i];
+            out[o+1] = audio_in->buffer[i];
         }
-#else
-        /* FIXME: we should write the mono stream into the avi instead */
-#endif
+        job->size = audio_in->used * 4;
     } else if (audio_channels == 2) {
-        int i, o;
-        for (i = o = 0; i < audio_in->used; i+=2, o+=2) {
-            cur_audio[o] = audio_in->buffer[i];
-            cur_audio[o+1] = audio_in->buffer[i+1];
-        }
-        /* write avi chunks */
-        if (zmbv_avi_write_chunk_audio(zavi, &audio_in->buffer[0], audio_in->used * 2) < 0) {
-            LOG(("FATAL: can't write audio frame for screen #%d", frameno));
-            ret = -1;
-        }
+        memcpy(job->data, audio_in->buffer, audio_in->used * 2);
+        job->size = audio_in->used * 2;
     } else {
         ret = -1;
     }
+    /* an empty chunk is not written */
+    movieencoder_job_put(encoder, job);
 
     audio_in->used = 0;
     return ret;
@@ -387,7 +406,8 @@ static soundmovie_funcs_t zmbvdrv_soundmovie_funcs = {
 /*-----------------------*/
 /* video stream encoding */
 /*-----------------------*/
-static int zmbvdrv_fill_rgb_image(screenshot_t *screenshot)
+/* copies palette and pixels into a job, the only work left on the emulation thread */
+static int zmbvdrv_fill_rgb_image(screenshot_t *screenshot, uint8_t *pal, uint8_t *screen)
 {
     int x, y;
     int dx, dy;
@@ -406,16 +426,14 @@ static int zmbvdrv_fill_rgb_image(screenshot_t *screenshot)
         + (screenshot->y_offset + (dy < 0 ? -dy : 0)) * screenshot->draw_buffer_line_size;
 
     for (x = 0; x < PALETTE_NUM_COLORS; x++) {
-        cur_pal[(x * (PALETTE_COLORS_BPP / 8)) + 0] = screenshot->palette->entries[x].red;
-        cur_pal[(x * (PALETTE_COLORS_BPP / 8)) + 1] = screenshot->palette->entries[x].green;
-        cur_pal[(x * (PALETTE_COLORS_BPP / 8)) + 2] = screenshot->palette->entries[x].blue;
+        pal[(x * (PALETTE_COLORS_BPP / 8)) + 0] = screenshot->palette->entries[x].red;
+        pal[(x * (PALETTE_COLORS_BPP / 8)) + 1] = screenshot->palette->entries[x].green;
+        pal[(x * (PALETTE_COLORS_BPP / 8)) + 2] = screenshot->palette->entries[x].blue;
     }
 
     LOGFRAMES(("zmbvdrv_fill_rgb_image video_width/height: %dx%d", video_width, video_height));
     for (y = 0; y < video_height; y++) {
-        for (x = 0; x < video_width; x++) {
-            cur_screen[(y * video_width) + x] = screenshot->draw_buffer[bufferoffset + x];
-        }
+        memcpy(screen + (y * video_width), screenshot->draw_buffer + bufferoffset, video_width);
         bufferoffset += screenshot->draw_buffer_line_size;
     }
     LOGFRAMES(("zmbvdrv_fill_rgb_image done"));
@@ -444,6 +462,68 @@ static int zmbvdrv_open_video(int width, int height)
     return 0;
 }
 
+/* compresses cur_screen and writes it to the file, on the encoder thread */
+static int zmbvdrv_encode_frame(void)
+{
+    int32_t written;
+    int flags;
+    int y;
+
+    flags = ((frameno % KEYFRAME_INTERVAL == 0) ? ZMBV_PREP_FLAG_KEYFRAME : ZMBV_PREP_FLAG_NONE);
+
+    frameno++;
+
+    LOGFRAMES(("zmbvdrv_encode_frame: frame %d", frameno));
+
+    /* encode video frame */
+    if (zmbv_encode_prepare_frame(zcodec, flags, fmt, cur_pal, video_work_buffer, work_buffer_size) < 0) {
+        LOG(("FATAL: can't prepare frame for screen #%d", frameno));
+        return -1;
+    }
+    for (y = 0; y < video_height; ++y) {
+        if (zmbv_encode_line(zcodec, cur_screen+(y*video_width)) < 0) {
+            LOG(("FATAL: can't encode line #%d for screen #%d", y, frameno));
+            return -1;
+        }
+    }
+    written = zmvb_encode_finish_frame(zcodec);
+    if (written < 0) {
+        LOG(("FATAL: can't finish frame for screen #%d", frameno));
+        return -1;
+    }
+    /* write avi chunk */
+    if (zmbv_avi_write_chunk_video(zavi, video_work_buffer, written) < 0) {
+        LOG(("FATAL: can't write compressed frame for screen #%d", frameno));
+        return -1;
+    }
+    return 0;
+}
+
+/* movieencoder callback, runs on the encoder thread */
+static int zmbvdrv_encode_job(movieencoder_job_t *job)
+{
+    unsigned int i;
+
+    if (job->type == MOVIEENCODER_AUDIO) {
+        if (job->size == 0) {
+            return 0;
+        }
+        return zmbv_avi_write_chunk_audio(zavi, job->data, (int)job->size);
+    }
+
+    /* frames dropped on the emulation thread repeat the last one */
+    for (i = 0; i < job->dropped; i++) {
+        if (zmbvdrv_encode_frame() < 0) {
+            return -1;
+        }
+    }
+
+    memcpy(cur_pal, job->data, PALETTE_SIZE);
+    memcpy(cur_screen, job->data + PALETTE_SIZE, video_width * video_height);
+
+    return zmbvdrv_encode_frame();
+}
+
 /* called by zmbvdrv_close() */
 static void zmbvdrv_close_video(void)
 {
@@ -463,8 +543,8 @@ static void zmbvdrv_init_video(screenshot_t *screenshot)
     video_init_done = 1;
     {
         double time_base, fps;
-        clk_frame_cycles = machine_get_cycles_per_frame();
-        time_base = ((double)machine_get_cycles_per_frame()) / ((double) machine_get_cycles_per_second());
+        clk_frame_cycles = machine_get_cycles_per_frame() * frame_interval;
+        time_base = ((double)clk_frame_cycles) / ((double) machine_get_cycles_per_second());
         fps = 1.0f / time_base;
         LOG(("zmbvdrv_init_video fps: %f timebase: %f", fps, time_base));
         video_framerate = fps;
@@ -479,6 +559,8 @@ static void zmbvdrv_init_video(screenshot_t *screenshot)
 /* called by zmbvdrv_init_video */
 static int zmbvdrv_init_file(void)
 {
+    size_t slot_size;
+
     LOG(("zmbvdrv_init_file() video_init_done:%d audio_init_done:%d", video_init_done, audio_init_done));
     if (!video_init_done || !audio_init_done) {
         return 0;
@@ -496,6 +578,13 @@ static int zmbvdrv_init_file(void)
         return -1;
     }
 
+    /* a slot holds a palette and frame, or an audio chunk */
+    slot_size = PALETTE_SIZE + video_width * video_height;
+    if (slot_size < MAX_AUDIO_BUFFER_SIZE * sizeof(int16_t)) {
+        slot_size = MAX_AUDIO_BUFFER_SIZE * sizeof(int16_t);
+    }
+    encoder = movieencoder_new("ZMBV", slot_size, zmbvdrv_encode_job);
+
     log_debug(LOG_DEFAULT, "zmbvdrv: Initialized file successfully");
 
     file_init_done = 1;
@@ -567,6 +656,12 @@ static int zmbvdrv_close(screenshot_t *screenshot)
 
     soundmovie_stop();
 
+    /* everything queued goes into the file before it is closed */
+    if (movieencoder_destroy(encoder) < 0) {
+        log_debug(LOG_DEFAULT, "Error while writing video frame");
+    }
+    encoder = NULL;
+
     zmbvdrv_close_video();
     zmbvdrv_close_audio();
 
@@ -590,15 +685,18 @@ static int zmbvdrv_close(screenshot_t *screenshot)
 /* triggered by screenshot_record, periodically called to output video data stream */
 static int zmbvdrv_record(screenshot_t *screenshot)
 {
-    int ret = -1;
-    int32_t written;
-    int flags;
+    movieencoder_job_t *job;
     CLOCK clk_diff;
 
     if (audio_init_done && video_init_done && !file_init_done) {
         zmbvdrv_init_file();
     }
 
+    /* frames are counted in emulated time, so this also holds in warp mode */
+    if ((framecounter++ % frame_interval) != 0) {
+        return 0;
+    }
+
     clk_last_video_frame = clk_this_video_frame;
     clk_this_video_frame = maincpu_clk;
 
@@ -617,41 +715,21 @@ static int zmbvdrv_record(screenshot_t *screenshot)
         }
     }
 
-    zmbvdrv_fill_rgb_image(screenshot);
-
-    flags = ((frameno % KEYFRAME_INTERVAL == 0) ? ZMBV_PREP_FLAG_KEYFRAME : ZMBV_PREP_FLAG_NONE);
-
-    frameno++;
-
-    LOGFRAMES(("zmbvdrv_record: frame %d (clk:%ld)", frameno, clk_this_video_frame));
-
-    /* encode video frame */
-    if (zmbv_encode_prepare_frame(zcodec, flags, fmt, cur_pal, video_work_buffer, work_buffer_size) < 0) {
-        LOG(("FATAL: can't prepare frame for screen #%d", frameno));
-        goto quit;
-    }
-    for (int y = 0; y < video_height; ++y) {
-        if (zmbv_encode_line(zcodec, cur_screen+(y*video_width)) < 0) {
-            LOG(("FATAL: can't encode line #%d for screen #%d", y, frameno));
-            goto quit;
-        }
-    }
-    written = zmvb_encode_finish_frame(zcodec);
-    if (written < 0) {
-        LOG(("FATAL: can't finish frame for screen #%d", frameno));
-        goto quit;
-    }
-    /* write avi chunk */
-    if (zmbv_avi_write_chunk_video(zavi, video_work_buffer, written) < 0) {
-        LOG(("FATAL: can't write compressed frame for screen #%d", frameno));
-        goto quit;
+    if (encoder == NULL) {
+        return 0;
     }
-    ret = 0;
-quit:
-    if (ret < 0) {
+    if (movieencoder_job_get(encoder, MOVIEENCODER_VIDEO, &job) < 0) {
         log_debug(LOG_DEFAULT, "Error while writing video frame");
         return -1;
     }
+    if (job == NULL) {
+        /* the encoder is behind, it repeats the last frame instead */
+        return 0;
+    }
+
+    zmbvdrv_fill_rgb_image(screenshot, job->data, job->data + PALETTE_SIZE);
+    job->size = PALETTE_SIZE + video_width * video_height;
+    movieencoder_job_put(encoder, job);
 
     return 0;
 }
@@ -48,14 +48,16 @@
 #define DBG(x)
 #endif
 
-#ifdef USE_VICE_THREAD
+#if defined(USE_VICE_THREAD) || defined(HAVE_PTHREAD)
 /*
  * It was observed that stdout logging from the UI thread under Windows
  * wasn't reliable, possibly only when the vice mainlock has not been
  * obtained.
  *
  * This lock serialises access to logging functions without requiring
- * ownership of the main lock.
+ * ownership of the main lock. Builds without the VICE thread need it as
+ * well when they run helper threads, e.g. the sound output thread, whose
+ * sound device callbacks log.
  *
  *******************************************************************
  * ANY NEW NON-STATIC FUNCTIONS NEED CALLS TO LOCK() and UNLOCK(). *
@@ -69,13 +71,13 @@ static pthread_mutex_t log_lock;
 #define UNLOCK() { pthread_mutex_unlock(&log_lock); }
 #define UNLOCK_AND_RETURN_INT(i) { int result = (i); UNLOCK(); return result; }
 
-#else /* #ifdef USE_VICE_THREAD */
+#else /* #if defined(USE_VICE_THREAD) || defined(HAVE_PTHREAD) */
 
 #define LOCK()
 #define UNLOCK()
 #define UNLOCK_AND_RETURN_INT(i) return (i)
 
-#endif /* #ifdef USE_VICE_THREAD */
+#endif /* #if defined(USE_VICE_THREAD) || defined(HAVE_PTHREAD) */
 
 static int log_locks_initialized = 0;
 static void log_init_locks(void);
@@ -212,7 +214,7 @@ int log_set_limit_early(int n)
 static void log_init_locks(void)
 {
     if (log_locks_initialized == 0) {
-#ifdef USE_VICE_THREAD
+#if defined(USE_VICE_THREAD) || defined(HAVE_PTHREAD)
         pthread_mutexattr_t lock_attributes;
         pthread_mutexattr_init(&lock_attributes);
         pthread_mutexattr_settype(&lock_attributes, PTHREAD_MUTEX_RECURSIVE);
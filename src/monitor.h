@@ -161,6 +161,14 @@ typedef struct monitor_interface_s monitor_interface_t;
 /* Externals */
 extern unsigned monitor_mask[NUM_MEMSPACES];
 
+/* Exec coverage bitmaps, NULL while exec coverage is off (see monitor/mon_coverage.c).  */
+extern uint8_t *monitor_coverage_exec[NUM_MEMSPACES];
+
+/* Per-page flags returned by monitor_watch_pages(), a page with a flag set
+   needs the load/store watch trampolines.  */
+#define MONITOR_WATCH_PAGE_LOAD     (1 << 0)
+#define MONITOR_WATCH_PAGE_STORE    (1 << 1)
+
 
 /* Prototypes */
 monitor_cpu_type_t* monitor_find_cpu_type_from_string(const char *cpu_type);
@@ -184,6 +192,8 @@ void monitor_abort(void);
 void monitor_check_icount(uint16_t a);
 void monitor_check_icount_interrupt(void);
 void monitor_check_watchpoints(unsigned int lastpc, unsigned int pc);
+void monitor_coverage_exec_hit(MEMSPACE mem, uint16_t addr);
+const uint8_t *monitor_watch_pages(MEMSPACE mem);
 
 void monitor_cpu_type_set(const char *cpu_type);
 void monitor_cpu_type_set_value(int searchcpu);
@@ -37,6 +37,8 @@
 #include "lib.h"
 #include "log.h"
 #include "mon_breakpoint.h"
+#include "mon_coverage.h"
+#include "mon_stream.h"
 #include "mon_disassemble.h"
 #include "mon_util.h"
 #include "montypes.h"
@@ -68,6 +70,11 @@ static checkpoint_list_t *breakpoints[NUM_MEMSPACES];
 static checkpoint_list_t *watchpoints_load[NUM_MEMSPACES];
 static checkpoint_list_t *watchpoints_store[NUM_MEMSPACES];
 
+/* MONITOR_WATCH_PAGE_* flags for every page that overlaps a load/store
+   watchpoint, rebuilt by update_checkpoint_state(). Lets the machine memory
+   code route only those pages through the watch trampolines.  */
+static uint8_t watch_pages[NUM_MEMSPACES][0x100];
+
 
 void mon_breakpoint_init(void)
 {
@@ -156,16 +163,79 @@ mon_checkpoint_t *mon_breakpoint_find_checkpoint(int brknum)
     return NULL;
 }
 
+static void mark_watch_pages(uint8_t *pages, checkpoint_list_t *list, uint8_t flag)
+{
+    mon_checkpoint_t *cp;
+    unsigned int start, end, page;
+
+    for (; list != NULL; list = list->next) {
+        cp = list->checkpt;
+        start = addr_location(cp->start_addr) & 0xffff;
+        end = start;
+        if (mon_is_valid_addr(cp->end_addr)) {
+            end = addr_location(cp->end_addr) & 0xffff;
+        }
+        if (end < start) {
+            /* range wraps around $ffff */
+            end += 0x10000;
+        }
+        for (page = start >> 8; page <= (end >> 8); page++) {
+            pages[page & 0xff] |= flag;
+        }
+    }
+}
+
+static void update_watch_pages(MEMSPACE mem)
+{
+    uint8_t *pages = watch_pages[mem];
+    unsigned int coverage = mon_coverage_get_flags(mem);
+    uint8_t all = 0;
+
+    /* load/store coverage needs to see every access */
+    if (coverage & MON_COVERAGE_LOAD) {
+        all |= MONITOR_WATCH_PAGE_LOAD;
+    }
+    if (coverage & MON_COVERAGE_STORE) {
+        all |= MONITOR_WATCH_PAGE_STORE;
+    }
+    memset(pages, all, sizeof watch_pages[mem]);
+    mon_stream_mark_watch_pages(mem, pages);
+
+    mark_watch_pages(pages, watchpoints_load[mem], MONITOR_WATCH_PAGE_LOAD);
+    mark_watch_pages(pages, watchpoints_store[mem], MONITOR_WATCH_PAGE_STORE);
+}
+
+/** \brief  Get the pages of a memspace that need the watch trampolines
+ *
+ * \param[in]   mem     memspace
+ *
+ * \return  0x100 MONITOR_WATCH_PAGE_* flags, one per page
+ */
+const uint8_t *monitor_watch_pages(MEMSPACE mem)
+{
+    return watch_pages[mem];
+}
+
 static void update_checkpoint_state(MEMSPACE mem)
 {
+    update_watch_pages(mem);
+
     /* calls mem_toggle_watchpoints() */
     if (watchpoints_load[mem] != NULL ||
         watchpoints_store[mem] != NULL) {
         monitor_mask[mem] |= MI_WATCH;
+    } else {
+        monitor_mask[mem] &= ~MI_WATCH;
+    }
+
+    /* load/store coverage and stream subscriptions are collected through
+       the same trampolines, but without MI_WATCH, so no checkpoint lists
+       are walked for them */
+    if ((monitor_mask[mem] & MI_WATCH) || mon_coverage_wants_watch(mem) ||
+        mon_stream_wants_watch(mem)) {
         mon_interfaces[mem]->toggle_watchpoints_func(
             1 | (break_on_dummy_access << 1), mon_interfaces[mem]->context);
     } else {
-        monitor_mask[mem] &= ~MI_WATCH;
         mon_interfaces[mem]->toggle_watchpoints_func(
             0, mon_interfaces[mem]->context);
     }
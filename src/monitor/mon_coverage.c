@@ -0,0 +1,215 @@
+/** \file   mon_coverage.c
+ *  \brief  The VICE built-in monitor, execution/memory coverage bitmaps.
+ *
+ * Byte-granular coverage used to be harvested by setting one silent
+ * checkpoint per address, which makes every instruction walk the sorted
+ * checkpoint lists in mon_breakpoint.c. Here each memspace instead gets
+ * up to three 64K-bit maps (exec, load, store) plus optional saturating
+ * 8-bit exec hit counters:
+ *
+ * - exec is marked straight from the CPU core opcode fetch, through
+ *   monitor_coverage_exec_hit(), whenever monitor_coverage_exec[mem] is set.
+ * - load/store are marked from the watch trampolines (see
+ *   monitor_watch_push_load_addr()), which mon_breakpoint.c enables while
+ *   mon_coverage_wants_watch() is true.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <string.h>
+
+#include "lib.h"
+#include "mon_coverage.h"
+#include "monitor.h"
+#include "montypes.h"
+#include "types.h"
+
+struct mon_coverage_s {
+    unsigned int flags;
+    uint8_t *maps[e_MON_COVERAGE_MAP_NUM];
+};
+typedef struct mon_coverage_s mon_coverage_t;
+
+static mon_coverage_t coverage[NUM_MEMSPACES];
+
+/* Checked by the CPU cores on every opcode fetch, NULL while exec coverage is off. */
+uint8_t *monitor_coverage_exec[NUM_MEMSPACES];
+
+#define COVERAGE_MARK(map, addr) ((map)[(addr) >> 3] |= (uint8_t)(1 << ((addr) & 7)))
+
+/* bits set per nibble, used to count covered addresses */
+static const uint8_t nibble_bits[16] = {
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+};
+
+/* called by cpu core */
+void monitor_coverage_exec_hit(MEMSPACE mem, uint16_t addr)
+{
+    uint8_t *hits = coverage[mem].maps[e_MON_COVERAGE_MAP_HITS];
+
+    COVERAGE_MARK(monitor_coverage_exec[mem], addr);
+
+    if (hits != NULL && hits[addr] != 0xff) {
+        hits[addr]++;
+    }
+}
+
+void mon_coverage_mark_load(MEMSPACE mem, uint16_t addr)
+{
+    uint8_t *map = coverage[mem].maps[e_MON_COVERAGE_MAP_LOAD];
+
+    if (map != NULL) {
+        COVERAGE_MARK(map, addr);
+    }
+}
+
+void mon_coverage_mark_store(MEMSPACE mem, uint16_t addr)
+{
+    uint8_t *map = coverage[mem].maps[e_MON_COVERAGE_MAP_STORE];
+
+    if (map != NULL) {
+        COVERAGE_MARK(map, addr);
+    }
+}
+
+uint32_t mon_coverage_map_size(mon_coverage_map_t map)
+{
+    return (map == e_MON_COVERAGE_MAP_HITS) ? MON_COVERAGE_HITS_SIZE : MON_COVERAGE_BITMAP_SIZE;
+}
+
+/** \brief  Enable or disable coverage collection for a memspace
+ *
+ * Maps that are switched on are allocated cleared, maps that are switched
+ * off are freed. Maps that stay on keep their contents. Hit counters are
+ * updated from the exec path, so MON_COVERAGE_HITS implies MON_COVERAGE_EXEC.
+ *
+ * \param[in]   mem     memspace
+ * \param[in]   flags   MON_COVERAGE_* flags, 0 turns coverage off
+ */
+void mon_coverage_set(MEMSPACE mem, unsigned int flags)
+{
+    static const unsigned int map_flags[e_MON_COVERAGE_MAP_NUM] = {
+        MON_COVERAGE_EXEC, MON_COVERAGE_LOAD, MON_COVERAGE_STORE, MON_COVERAGE_HITS
+    };
+    mon_coverage_t *cov;
+    int i;
+
+    if (mem == e_default_space) {
+        mem = default_memspace;
+    }
+    cov = &coverage[mem];
+
+    flags &= MON_COVERAGE_ALL;
+    if (flags & MON_COVERAGE_HITS) {
+        flags |= MON_COVERAGE_EXEC;
+    }
+
+    for (i = 0; i < e_MON_COVERAGE_MAP_NUM; i++) {
+        if ((flags & map_flags[i]) && cov->maps[i] == NULL) {
+            cov->maps[i] = lib_calloc(1, mon_coverage_map_size((mon_coverage_map_t)i));
+        } else if (!(flags & map_flags[i]) && cov->maps[i] != NULL) {
+            lib_free(cov->maps[i]);
+            cov->maps[i] = NULL;
+        }
+    }
+
+    cov->flags = flags;
+    monitor_coverage_exec[mem] = cov->maps[e_MON_COVERAGE_MAP_EXEC];
+
+    /* switches the watch trampolines on or off for load/store coverage */
+    mon_update_all_checkpoint_state();
+}
+
+unsigned int mon_coverage_get_flags(MEMSPACE mem)
+{
+    return coverage[mem].flags;
+}
+
+/** \brief  Check whether load/store coverage needs the watch trampolines
+ *
+ * \param[in]   mem     memspace
+ *
+ * \return  true if load or store coverage is enabled for \a mem
+ */
+bool mon_coverage_wants_watch(MEMSPACE mem)
+{
+    return (coverage[mem].flags & (MON_COVERAGE_LOAD | MON_COVERAGE_STORE)) != 0;
+}
+
+/** \brief  Copy out a coverage map
+ *
+ * \param[in]   mem     memspace
+ * \param[in]   map     map to copy
+ * \param[out]  dest    destination, mon_coverage_map_size(\a map) bytes
+ * \param[in]   clear   clear the map after copying it
+ * \param[out]  covered number of addresses covered in the map
+ *
+ * \return  0 on success, -1 if the map is not enabled
+ */
+int mon_coverage_read(MEMSPACE mem, mon_coverage_map_t map, uint8_t *dest,
+                      bool clear, uint32_t *covered)
+{
+    uint8_t *src;
+    uint32_t size, count = 0, i;
+
+    if (map >= e_MON_COVERAGE_MAP_NUM) {
+        return -1;
+    }
+
+    src = coverage[mem].maps[map];
+    if (src == NULL) {
+        return -1;
+    }
+
+    size = mon_coverage_map_size(map);
+    memcpy(dest, src, size);
+    if (clear) {
+        memset(src, 0, size);
+    }
+
+    for (i = 0; i < size; i++) {
+        if (map == e_MON_COVERAGE_MAP_HITS) {
+            count += (dest[i] != 0);
+        } else {
+            count += nibble_bits[dest[i] & 0x0f] + nibble_bits[dest[i] >> 4];
+        }
+    }
+    *covered = count;
+
+    return 0;
+}
+
+void mon_coverage_shutdown(void)
+{
+    int mem, i;
+
+    for (mem = 0; mem < NUM_MEMSPACES; mem++) {
+        for (i = 0; i < e_MON_COVERAGE_MAP_NUM; i++) {
+            lib_free(coverage[mem].maps[i]);
+            coverage[mem].maps[i] = NULL;
+        }
+        coverage[mem].flags = 0;
+        monitor_coverage_exec[mem] = NULL;
+    }
+}
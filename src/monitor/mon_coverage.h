@@ -0,0 +1,64 @@
+/** \file   mon_coverage.h
+ *  \brief  The VICE built-in monitor, execution/memory coverage bitmaps.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_MON_COVERAGE_H
+#define VICE_MON_COVERAGE_H
+
+#include "montypes.h"
+#include "types.h"
+
+/* coverage flags, as passed to mon_coverage_set() */
+#define MON_COVERAGE_EXEC   (1 << 0)
+#define MON_COVERAGE_LOAD   (1 << 1)
+#define MON_COVERAGE_STORE  (1 << 2)
+#define MON_COVERAGE_HITS   (1 << 3)    /**< saturating 8-bit exec counters */
+#define MON_COVERAGE_ALL    (MON_COVERAGE_EXEC | MON_COVERAGE_LOAD | MON_COVERAGE_STORE | MON_COVERAGE_HITS)
+
+/* size of a single bitmap (one bit per address) and of the hit counter map */
+#define MON_COVERAGE_BITMAP_SIZE    (0x10000 / 8)
+#define MON_COVERAGE_HITS_SIZE      0x10000
+
+enum mon_coverage_map_e {
+    e_MON_COVERAGE_MAP_EXEC = 0,
+    e_MON_COVERAGE_MAP_LOAD,
+    e_MON_COVERAGE_MAP_STORE,
+    e_MON_COVERAGE_MAP_HITS,
+    e_MON_COVERAGE_MAP_NUM
+};
+typedef enum mon_coverage_map_e mon_coverage_map_t;
+
+void mon_coverage_set(MEMSPACE mem, unsigned int flags);
+unsigned int mon_coverage_get_flags(MEMSPACE mem);
+bool mon_coverage_wants_watch(MEMSPACE mem);
+uint32_t mon_coverage_map_size(mon_coverage_map_t map);
+int mon_coverage_read(MEMSPACE mem, mon_coverage_map_t map, uint8_t *dest,
+                      bool clear, uint32_t *covered);
+
+void mon_coverage_mark_load(MEMSPACE mem, uint16_t addr);
+void mon_coverage_mark_store(MEMSPACE mem, uint16_t addr);
+
+void mon_coverage_shutdown(void);
+
+#endif
@@ -0,0 +1,247 @@
+/** \file   mon_shm.c
+ *  \brief  The VICE built-in monitor, shared memory frame export.
+ *
+ * Reading the screen, RAM and registers every frame through the binary
+ * monitor costs a request, a conversion into a freshly allocated buffer
+ * and a copy through the socket each time. A client on the same host can
+ * instead map a POSIX shared memory region that is rewritten at every
+ * vsync: the display as DISPLAY_GET returns it in indexed8 mode, the first
+ * 64K of RAM, color RAM and the main CPU registers, see mon_shm.h for the
+ * layout. A seqlock in the header lets readers copy a consistent frame
+ * without any syscall.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <string.h>
+
+#if defined(HAVE_NETWORK) && defined(UNIX_COMPILE)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "interrupt.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "machine-video.h"
+#include "maincpu.h"
+#include "mem.h"
+#include "mon_shm.h"
+#include "monitor.h"
+#include "monitor_binary.h"
+#include "montypes.h"
+#include "screenshot.h"
+#include "types.h"
+#include "vsync.h"
+
+#if defined(HAVE_NETWORK) && defined(UNIX_COMPILE)
+
+static mon_shm_header_t *shm_header = NULL;
+static size_t shm_size = 0;
+static char *shm_name = NULL;
+
+/* process that created the object, a fork()ed copy only unmaps it */
+static pid_t shm_owner = 0;
+
+/* machines with color RAM at $d800 of the io bank */
+#define MON_SHM_COLOR_RAM_MACHINES \
+    (VICE_MACHINE_C64 | VICE_MACHINE_C64SC | VICE_MACHINE_C64DTV | VICE_MACHINE_SCPU64 | VICE_MACHINE_C128)
+
+/** \brief  Create the shared memory region and start publishing frames
+ *
+ * \param[in]   name    POSIX shared memory object name, e.g. "/x64sc"
+ *
+ * \return  0 on success, -1 on error
+ */
+int mon_shm_open(const char *name)
+{
+    int fd;
+    void *region;
+
+    mon_shm_close();
+
+    shm_size = sizeof(mon_shm_header_t) + MON_SHM_DISPLAY_SIZE + MON_SHM_RAM_SIZE + MON_SHM_COLOR_RAM_SIZE;
+
+    fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    if (fd < 0) {
+        log_error(LOG_DEFAULT, "mon_shm_open(): could not open %s: %s", name, strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)shm_size) < 0) {
+        log_error(LOG_DEFAULT, "mon_shm_open(): could not size %s: %s", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    region = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        log_error(LOG_DEFAULT, "mon_shm_open(): could not map %s: %s", name, strerror(errno));
+        shm_unlink(name);
+        return -1;
+    }
+
+    shm_header = region;
+    shm_name = lib_strdup(name);
+    shm_owner = getpid();
+
+    memset(shm_header, 0, sizeof(mon_shm_header_t));
+    shm_header->version = MON_SHM_VERSION;
+    shm_header->display_offset = sizeof(mon_shm_header_t);
+    shm_header->ram_offset = shm_header->display_offset + MON_SHM_DISPLAY_SIZE;
+    shm_header->color_ram_offset = shm_header->ram_offset + MON_SHM_RAM_SIZE;
+    shm_header->size = (uint32_t)shm_size;
+    /* written last, readers can check it to see the region is set up */
+    __atomic_store_n(&shm_header->magic, MON_SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+void mon_shm_close(void)
+{
+    if (shm_header == NULL) {
+        return;
+    }
+
+    munmap(shm_header, shm_size);
+    if (getpid() == shm_owner) {
+        shm_unlink(shm_name);
+    }
+    lib_free(shm_name);
+
+    shm_header = NULL;
+    shm_name = NULL;
+    shm_size = 0;
+    shm_owner = 0;
+}
+
+static void mon_shm_update_display(uint8_t *display)
+{
+    screenshot_t screenshot;
+    unsigned int i;
+
+    if (machine_screenshot(&screenshot, machine_video_canvas_get(0)) < 0) {
+        shm_header->display_width = 0;
+        shm_header->display_height = 0;
+        return;
+    }
+
+    screenshot.width = screenshot.max_width & ~3;
+    screenshot.height = screenshot.last_displayed_line - screenshot.first_displayed_line + 1;
+    screenshot.y_offset = screenshot.first_displayed_line;
+
+    if (screenshot.debug_width * screenshot.debug_height > MON_SHM_DISPLAY_SIZE) {
+        shm_header->display_width = 0;
+        shm_header->display_height = 0;
+        return;
+    }
+
+    shm_header->display_width = (uint16_t)screenshot.debug_width;
+    shm_header->display_height = (uint16_t)screenshot.debug_height;
+    shm_header->display_offset_x = (uint16_t)screenshot.debug_offset_x;
+    shm_header->display_offset_y = (uint16_t)screenshot.debug_offset_y;
+    shm_header->display_inner_width = (uint16_t)screenshot.inner_width;
+    shm_header->display_inner_height = (uint16_t)screenshot.inner_height;
+
+    for (i = 0; i < screenshot.debug_height; i++) {
+        monitor_binary_screenshot_line_data(&screenshot, display, i, 0);
+        display += screenshot.debug_width;
+    }
+}
+
+/* runs at the next instruction boundary, where the CPU has exported its registers */
+static void mon_shm_update_trap(uint16_t addr, void *data)
+{
+    uint8_t *region = (uint8_t *)shm_header;
+    monitor_cpu_type_t *cpu;
+    uint32_t seq;
+
+    if (shm_header == NULL) {
+        return;
+    }
+
+    seq = shm_header->seq;
+    __atomic_store_n(&shm_header->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    shm_header->frame++;
+    shm_header->clock = (uint64_t)maincpu_clk;
+
+    cpu = monitor_cpu_for_memspace[e_comp_space];
+    shm_header->reg_a = (uint16_t)cpu->mon_register_get_val(e_comp_space, e_A);
+    shm_header->reg_x = (uint16_t)cpu->mon_register_get_val(e_comp_space, e_X);
+    shm_header->reg_y = (uint16_t)cpu->mon_register_get_val(e_comp_space, e_Y);
+    shm_header->reg_pc = (uint16_t)cpu->mon_register_get_val(e_comp_space, e_PC);
+    shm_header->reg_sp = (uint16_t)cpu->mon_register_get_val(e_comp_space, e_SP);
+    shm_header->reg_flags = (uint16_t)cpu->mon_register_get_val(e_comp_space, e_FLAGS);
+
+    mon_shm_update_display(region + shm_header->display_offset);
+
+    memcpy(region + shm_header->ram_offset, mem_ram, MON_SHM_RAM_SIZE);
+
+    if (machine_class & MON_SHM_COLOR_RAM_MACHINES) {
+        int bank = mon_interfaces[e_comp_space]->mem_bank_from_name("io");
+
+        mon_get_mem_block_ex(e_comp_space, bank, 0xd800, MON_SHM_COLOR_RAM_SIZE - 1,
+                             region + shm_header->color_ram_offset);
+    }
+
+    __atomic_store_n(&shm_header->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/** \brief  Publish the current frame, called at vsync
+ */
+void mon_shm_update(void)
+{
+    if (shm_header == NULL) {
+        return;
+    }
+
+    /* the display is exported every frame, so it must be drawn with NoRender */
+    vsync_request_render(1);
+
+    interrupt_maincpu_trigger_trap(mon_shm_update_trap, NULL);
+}
+
+#else
+
+int mon_shm_open(const char *name)
+{
+    log_error(LOG_DEFAULT, "mon_shm_open(): shared memory export is not supported on this platform");
+    return -1;
+}
+
+void mon_shm_close(void)
+{
+}
+
+void mon_shm_update(void)
+{
+}
+
+#endif
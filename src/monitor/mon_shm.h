@@ -0,0 +1,83 @@
+/** \file   mon_shm.h
+ *  \brief  The VICE built-in monitor, shared memory frame export.
+ *
+ * The layout of the region is described here so local clients can include
+ * this header. All fields use the byte order of the host.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_MON_SHM_H
+#define VICE_MON_SHM_H
+
+#include "types.h"
+
+#define MON_SHM_MAGIC       0x4d485356  /* "VSHM" */
+#define MON_SHM_VERSION     1
+
+/* sizes of the areas following the header */
+#define MON_SHM_DISPLAY_SIZE    0x100000
+#define MON_SHM_RAM_SIZE        0x10000
+#define MON_SHM_COLOR_RAM_SIZE  0x400
+
+/** \brief  Header at the start of the region
+ *
+ * seq is a seqlock: it is odd while the emulator writes a frame. A reader
+ * loads seq, copies what it needs, then loads seq again and retries if the
+ * two values differ or the first one was odd.
+ */
+struct mon_shm_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t seq;
+    uint32_t frame;             /**< frames published so far */
+    uint64_t clock;             /**< main CPU clock at the frame */
+
+    /* display, as DISPLAY_GET in indexed8 mode, 0x0 if there is none */
+    uint16_t display_width;
+    uint16_t display_height;
+    uint16_t display_offset_x;  /**< of the inner part of the screen */
+    uint16_t display_offset_y;
+    uint16_t display_inner_width;
+    uint16_t display_inner_height;
+
+    /* main CPU registers */
+    uint16_t reg_a;
+    uint16_t reg_x;
+    uint16_t reg_y;
+    uint16_t reg_pc;
+    uint16_t reg_sp;
+    uint16_t reg_flags;
+
+    /* offsets of the areas from the start of the region */
+    uint32_t display_offset;
+    uint32_t ram_offset;        /**< first 64K of RAM, no banking */
+    uint32_t color_ram_offset;  /**< $d800-$dbff where there is one */
+    uint32_t size;              /**< of the whole region */
+};
+typedef struct mon_shm_header_s mon_shm_header_t;
+
+int mon_shm_open(const char *name);
+void mon_shm_close(void);
+void mon_shm_update(void);
+
+#endif
@@ -0,0 +1,603 @@
+/** \file   mon_stream.c
+ *  \brief  The VICE built-in monitor, per-frame state delta subscription.
+ *
+ * A binary monitor client that follows the machine frame by frame used to
+ * poll SCREEN_GET and MEM_GET at every vsync, even though most of what it
+ * reads has not changed since the last frame. With a subscription the
+ * client registers memory ranges, optionally the screen, color RAM and the
+ * CPU registers, once; every N frames the emulator compares them against
+ * shadow copies of what the client was last sent and pushes only the
+ * changed bytes as (source, offset, length, data) records.
+ *
+ * Memory ranges are not compared byte by byte every time: their pages are
+ * routed through the store watch trampolines (see
+ * monitor_watch_push_store_addr()) and only the addresses the CPU stored to
+ * since the last delta are read back. Writes that bypass the CPU (REU or
+ * other DMA) and I/O registers that change by themselves are only seen with
+ * MON_STREAM_FULL_COMPARE. The screen, color RAM and registers are small and
+ * always compared in full.
+ *
+ * Banking swaps ROM, RAM and I/O under a range without a store there. The
+ * ranges of the computer are compared in full once whenever
+ * mem_get_current_bank_config() differs from the last delta, which covers
+ * the C64 CPU port and EXROM/GAME and the C128 MMU. Machines that don't
+ * report their configuration, and cartridge bank registers, need
+ * MON_STREAM_FULL_COMPARE to see banking changes.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <string.h>
+
+#include "lib.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "mem.h"
+#include "mon_register.h"
+#include "mon_stream.h"
+#include "monitor.h"
+#include "montypes.h"
+#include "types.h"
+
+/* machines with color RAM at $d800 of the io bank */
+#define MON_STREAM_COLOR_RAM_MACHINES \
+    (VICE_MACHINE_C64 | VICE_MACHINE_C64SC | VICE_MACHINE_C64DTV | VICE_MACHINE_SCPU64 | VICE_MACHINE_C128)
+
+#define MON_STREAM_COLOR_RAM_SIZE   0x400
+
+/* frame, clock and record count in front of the records */
+#define MON_STREAM_HEADER_SIZE  (4 + 8 + 2)
+
+/* source, offset and length in front of the data of a record */
+#define MON_STREAM_RECORD_SIZE  (1 + 2 + 2)
+
+/* changed bytes this close together go out in one record, sending the
+   unchanged ones between them is cheaper than another record header */
+#define MON_STREAM_RUN_GAP      MON_STREAM_RECORD_SIZE
+
+#define MON_STREAM_RUN_MAX      0xffff
+
+#define DIRTY_MARK(map, addr) ((map)[(addr) >> 3] |= (uint8_t)(1 << ((addr) & 7)))
+#define DIRTY_TEST(map, addr) ((map)[(addr) >> 3] & (1 << ((addr) & 7)))
+
+struct mon_stream_s {
+    bool active;
+    bool primed;                /* the shadows hold what the client was sent */
+    MEMSPACE mem;
+    int bank;
+    unsigned int flags;
+    unsigned int interval;
+    unsigned int countdown;
+    uint32_t frame;
+
+    unsigned int num_ranges;
+    uint16_t starts[MON_STREAM_MAX_RANGES];
+    uint16_t ends[MON_STREAM_MAX_RANGES];
+    int bank_config;            /* memory configuration at the last delta */
+
+    uint8_t *shadow;            /* 64K, indexed by address */
+    uint8_t *dirty;             /* one bit per address, NULL unless tracking stores */
+    uint8_t *screen;
+    uint32_t screen_size;
+    uint8_t color_ram[MON_STREAM_COLOR_RAM_SIZE];
+    uint8_t *registers;
+    uint32_t registers_size;
+
+    uint8_t *buffer;
+    size_t buffer_size;
+    size_t length;
+    uint16_t records;
+};
+typedef struct mon_stream_s mon_stream_t;
+
+static mon_stream_t stream;
+
+/* a run of changed bytes being collected into one record */
+struct stream_run_s {
+    mon_stream_source_t source;
+    const uint8_t *shadow;      /* the data of the record, indexed by offset */
+    bool open;
+    uint32_t start;
+    uint32_t end;
+};
+typedef struct stream_run_s stream_run_t;
+
+static void stream_reserve(size_t size)
+{
+    if (stream.buffer_size - stream.length < size) {
+        stream.buffer_size = stream.length + size + 0x1000;
+        stream.buffer = lib_realloc(stream.buffer, stream.buffer_size);
+    }
+}
+
+static void stream_put_uint16(uint16_t value)
+{
+    stream.buffer[stream.length++] = value & 0xff;
+    stream.buffer[stream.length++] = value >> 8;
+}
+
+static void run_begin(stream_run_t *run, mon_stream_source_t source, const uint8_t *shadow)
+{
+    run->source = source;
+    run->shadow = shadow;
+    run->open = false;
+}
+
+static void run_flush(stream_run_t *run)
+{
+    uint32_t offset, length;
+
+    if (!run->open) {
+        return;
+    }
+    run->open = false;
+
+    for (offset = run->start; offset <= run->end; offset += length) {
+        length = run->end + 1 - offset;
+        if (length > MON_STREAM_RUN_MAX) {
+            length = MON_STREAM_RUN_MAX;
+        }
+
+        stream_reserve(MON_STREAM_RECORD_SIZE + length);
+        stream.buffer[stream.length++] = (uint8_t)run->source;
+        stream_put_uint16((uint16_t)offset);
+        stream_put_uint16((uint16_t)length);
+        memcpy(stream.buffer + stream.length, run->shadow + offset, length);
+        stream.length += length;
+        stream.records++;
+    }
+}
+
+/* offsets must be added in ascending order */
+static void run_add(stream_run_t *run, uint32_t offset)
+{
+    if (run->open && offset - run->end <= MON_STREAM_RUN_GAP + 1) {
+        run->end = offset;
+        return;
+    }
+
+    run_flush(run);
+    run->open = true;
+    run->start = offset;
+    run->end = offset;
+}
+
+/* compare a block read in full against its shadow, updating the shadow */
+static void stream_diff_block(mon_stream_source_t source, uint8_t *shadow,
+                              const uint8_t *current, uint32_t size, bool all)
+{
+    stream_run_t run;
+    uint32_t i;
+
+    run_begin(&run, source, shadow);
+    for (i = 0; i < size; i++) {
+        if (all || current[i] != shadow[i]) {
+            shadow[i] = current[i];
+            run_add(&run, i);
+        }
+    }
+    run_flush(&run);
+}
+
+static void stream_diff_memory(void)
+{
+    bool full = (stream.dirty == NULL) || !stream.primed;
+    stream_run_t run;
+    unsigned int i;
+    uint32_t addr, end;
+    uint8_t value;
+    int bank_config;
+
+    /* stores don't see banking, compare everything after a change */
+    if (stream.mem == e_comp_space) {
+        bank_config = mem_get_current_bank_config();
+        if (bank_config != stream.bank_config) {
+            stream.bank_config = bank_config;
+            full = true;
+        }
+    }
+
+    for (i = 0; i < stream.num_ranges; i++) {
+        run_begin(&run, e_MON_STREAM_SOURCE_MEMORY, stream.shadow);
+        end = stream.ends[i];
+
+        for (addr = stream.starts[i]; addr <= end; addr++) {
+            if (!full) {
+                /* skip whole bytes of the bitmap without a store */
+                if ((addr & 7) == 0 && stream.dirty[addr >> 3] == 0) {
+                    addr += 7;
+                    continue;
+                }
+                if (!DIRTY_TEST(stream.dirty, addr)) {
+                    continue;
+                }
+            }
+
+            value = mon_get_mem_val_ex_nosfx(stream.mem, stream.bank, (uint16_t)addr);
+            if (!stream.primed || value != stream.shadow[addr]) {
+                stream.shadow[addr] = value;
+                run_add(&run, addr);
+            }
+        }
+        run_flush(&run);
+    }
+
+    if (stream.dirty != NULL) {
+        memset(stream.dirty, 0, 0x10000 / 8);
+    }
+}
+
+static void stream_diff_screen(void)
+{
+    uint16_t base;
+    uint8_t rows, columns;
+    int bank;
+    uint32_t size, i;
+    uint8_t *current;
+    bool all = !stream.primed;
+
+    mem_get_screen_parameter(&base, &rows, &columns, &bank);
+    size = (uint32_t)rows * columns;
+
+    if (size != stream.screen_size) {
+        stream.screen = lib_realloc(stream.screen, size);
+        stream.screen_size = size;
+        /* a client can not diff against a screen of another size */
+        all = true;
+    }
+
+    current = lib_malloc(size);
+    for (i = 0; i < size; i++) {
+        current[i] = mem_bank_peek(bank, (uint16_t)(base + i), NULL);
+    }
+    stream_diff_block(e_MON_STREAM_SOURCE_SCREEN, stream.screen, current, size, all);
+    lib_free(current);
+}
+
+static void stream_diff_color_ram(void)
+{
+    uint8_t current[MON_STREAM_COLOR_RAM_SIZE];
+    int bank = mon_interfaces[e_comp_space]->mem_bank_from_name("io");
+    unsigned int i;
+
+    for (i = 0; i < MON_STREAM_COLOR_RAM_SIZE; i++) {
+        /* the high nibble is whatever was last on the bus */
+        current[i] = mon_get_mem_val_ex_nosfx(e_comp_space, bank, (uint16_t)(0xd800 + i)) & 0x0f;
+    }
+    stream_diff_block(e_MON_STREAM_SOURCE_COLOR_RAM, stream.color_ram, current, sizeof current,
+                      !stream.primed);
+}
+
+static void stream_diff_registers(void)
+{
+    mon_reg_list_t *list, *regs;
+    uint8_t *current;
+    uint32_t size = 0;
+    bool all = !stream.primed;
+
+    list = mon_register_list_get(stream.mem);
+    for (regs = list; regs->name != NULL; regs++) {
+        if (!(regs->flags & MON_REGISTER_IS_FLAGS)) {
+            size += 2;
+        }
+    }
+
+    if (size != stream.registers_size) {
+        stream.registers = lib_realloc(stream.registers, size);
+        stream.registers_size = size;
+        all = true;
+    }
+
+    current = lib_malloc(size);
+    size = 0;
+    for (regs = list; regs->name != NULL; regs++) {
+        if (!(regs->flags & MON_REGISTER_IS_FLAGS)) {
+            current[size++] = regs->val & 0xff;
+            current[size++] = (regs->val >> 8) & 0xff;
+        }
+    }
+    lib_free(list);
+
+    stream_diff_block(e_MON_STREAM_SOURCE_REGISTERS, stream.registers, current, size, all);
+    lib_free(current);
+}
+
+/* sort the ranges and merge the ones that overlap or touch, so no byte is
+   compared or reported twice */
+static void stream_merge_ranges(void)
+{
+    unsigned int i, j, n;
+    uint16_t start, end;
+
+    for (i = 1; i < stream.num_ranges; i++) {
+        start = stream.starts[i];
+        end = stream.ends[i];
+        for (j = i; j > 0 && stream.starts[j - 1] > start; j--) {
+            stream.starts[j] = stream.starts[j - 1];
+            stream.ends[j] = stream.ends[j - 1];
+        }
+        stream.starts[j] = start;
+        stream.ends[j] = end;
+    }
+
+    for (i = 1, n = 0; i < stream.num_ranges; i++) {
+        if ((uint32_t)stream.starts[i] <= (uint32_t)stream.ends[n] + 1) {
+            if (stream.ends[i] > stream.ends[n]) {
+                stream.ends[n] = stream.ends[i];
+            }
+        } else {
+            n++;
+            stream.starts[n] = stream.starts[i];
+            stream.ends[n] = stream.ends[i];
+        }
+    }
+    if (stream.num_ranges > 0) {
+        stream.num_ranges = n + 1;
+    }
+}
+
+/** \brief  Start a subscription, replacing the current one
+ *
+ * The first delta after this carries everything subscribed to.
+ *
+ * \param[in]   mem         memspace of the ranges and registers
+ * \param[in]   bank        bank the ranges are read from
+ * \param[in]   flags       MON_STREAM_* flags
+ * \param[in]   interval    frames between deltas, 0 ends the subscription
+ * \param[in]   starts      first address of each range
+ * \param[in]   ends        last address of each range, not below its start
+ * \param[in]   count       number of ranges, up to MON_STREAM_MAX_RANGES
+ *
+ * \return  0 on success, -1 on invalid parameters
+ */
+int mon_stream_subscribe(MEMSPACE mem, int bank, unsigned int flags, unsigned int interval,
+                         const uint16_t *starts, const uint16_t *ends, unsigned int count)
+{
+    unsigned int i;
+
+    if (count > MON_STREAM_MAX_RANGES || (flags & ~MON_STREAM_ALL)) {
+        return -1;
+    }
+    for (i = 0; i < count; i++) {
+        if (starts[i] > ends[i]) {
+            return -1;
+        }
+    }
+
+    mon_stream_unsubscribe();
+    if (interval == 0) {
+        return 0;
+    }
+
+    /* the screen and color RAM belong to the computer, not to a drive */
+    if (mem != e_comp_space) {
+        flags &= ~(MON_STREAM_SCREEN | MON_STREAM_COLOR_RAM);
+    }
+    if (!(machine_class & MON_STREAM_COLOR_RAM_MACHINES)) {
+        flags &= ~MON_STREAM_COLOR_RAM;
+    }
+
+    stream.active = true;
+    stream.primed = false;
+    stream.mem = mem;
+    stream.bank = bank;
+    stream.flags = flags;
+    stream.interval = interval;
+    stream.countdown = interval;
+    stream.frame = 0;
+    stream.bank_config = mem_get_current_bank_config();
+
+    stream.num_ranges = count;
+    memcpy(stream.starts, starts, count * sizeof starts[0]);
+    memcpy(stream.ends, ends, count * sizeof ends[0]);
+    stream_merge_ranges();
+
+    if (count > 0) {
+        stream.shadow = lib_calloc(1, 0x10000);
+        if (!(flags & MON_STREAM_FULL_COMPARE)) {
+            stream.dirty = lib_calloc(1, 0x10000 / 8);
+        }
+    }
+
+    /* routes the pages of the ranges through the store trampolines */
+    mon_update_all_checkpoint_state();
+
+    return 0;
+}
+
+void mon_stream_unsubscribe(void)
+{
+    bool watched = stream.dirty != NULL;
+
+    lib_free(stream.shadow);
+    lib_free(stream.dirty);
+    lib_free(stream.screen);
+    lib_free(stream.registers);
+    stream.shadow = NULL;
+    stream.dirty = NULL;
+    stream.screen = NULL;
+    stream.screen_size = 0;
+    stream.registers = NULL;
+    stream.registers_size = 0;
+    stream.num_ranges = 0;
+    stream.flags = 0;
+    stream.active = false;
+
+    if (watched) {
+        mon_update_all_checkpoint_state();
+    }
+}
+
+/** \brief  Get the flags of the subscription
+ *
+ * \return  MON_STREAM_* flags in effect, 0 without a subscription
+ */
+unsigned int mon_stream_get_flags(void)
+{
+    return stream.active ? stream.flags : 0;
+}
+
+/** \brief  Count a frame, called at vsync
+ *
+ * \return  true if a delta is due
+ */
+bool mon_stream_frame(void)
+{
+    if (!stream.active) {
+        return false;
+    }
+
+    stream.frame++;
+    if (--stream.countdown > 0) {
+        return false;
+    }
+    stream.countdown = stream.interval;
+
+    return true;
+}
+
+/** \brief  Collect the changes since the last delta
+ *
+ * Must be called at an instruction boundary, where the CPU has exported its
+ * registers.
+ *
+ * Layout of the delta:
+ *     u32 frame       frames since the subscription started
+ *     u64 clock       main CPU clock
+ *     u16 records
+ *     records[]:
+ *         u8  source  mon_stream_source_t
+ *         u16 offset
+ *         u16 length
+ *         u8  data[length]
+ *
+ * \param[out]  body    the delta, valid until the next call
+ *
+ * \return  size of the delta, 0 if nothing changed
+ */
+uint32_t mon_stream_delta(uint8_t **body)
+{
+    uint8_t *header;
+    uint64_t clock = (uint64_t)maincpu_clk;
+    int i;
+
+    if (!stream.active) {
+        return 0;
+    }
+
+    stream.length = 0;
+    stream.records = 0;
+    stream_reserve(MON_STREAM_HEADER_SIZE);
+    stream.length = MON_STREAM_HEADER_SIZE;
+
+    if (stream.num_ranges > 0) {
+        stream_diff_memory();
+    }
+    if (stream.flags & MON_STREAM_SCREEN) {
+        stream_diff_screen();
+    }
+    if (stream.flags & MON_STREAM_COLOR_RAM) {
+        stream_diff_color_ram();
+    }
+    if (stream.flags & MON_STREAM_REGISTERS) {
+        stream_diff_registers();
+    }
+    stream.primed = true;
+
+    if (stream.records == 0) {
+        return 0;
+    }
+
+    header = stream.buffer;
+    for (i = 0; i < 4; i++) {
+        header[i] = (uint8_t)(stream.frame >> (8 * i));
+    }
+    for (i = 0; i < 8; i++) {
+        header[4 + i] = (uint8_t)(clock >> (8 * i));
+    }
+    header[12] = stream.records & 0xff;
+    header[13] = stream.records >> 8;
+
+    *body = stream.buffer;
+    return (uint32_t)stream.length;
+}
+
+/** \brief  Re-read every subscribed address at the next delta
+ *
+ * For memory that changed without going through the CPU's store path, like
+ * a reset or whatever the monitor did while the machine was stopped. Only
+ * bytes that really differ from what the client has are sent.
+ */
+void mon_stream_invalidate(void)
+{
+    if (stream.dirty != NULL) {
+        memset(stream.dirty, 0xff, 0x10000 / 8);
+    }
+}
+
+/** \brief  Check whether the subscription needs the store trampolines
+ *
+ * \param[in]   mem     memspace
+ *
+ * \return  true if stores in \a mem are tracked
+ */
+bool mon_stream_wants_watch(MEMSPACE mem)
+{
+    return stream.dirty != NULL && stream.mem == mem;
+}
+
+/** \brief  Flag the pages of the subscribed ranges for the store trampolines
+ *
+ * \param[in]       mem     memspace
+ * \param[in,out]   pages   0x100 MONITOR_WATCH_PAGE_* flags
+ */
+void mon_stream_mark_watch_pages(MEMSPACE mem, uint8_t *pages)
+{
+    unsigned int i, page;
+
+    if (!mon_stream_wants_watch(mem)) {
+        return;
+    }
+
+    for (i = 0; i < stream.num_ranges; i++) {
+        for (page = stream.starts[i] >> 8; page <= (unsigned int)(stream.ends[i] >> 8); page++) {
+            pages[page] |= MONITOR_WATCH_PAGE_STORE;
+        }
+    }
+}
+
+void mon_stream_mark_store(MEMSPACE mem, uint16_t addr)
+{
+    if (stream.dirty != NULL && stream.mem == mem) {
+        DIRTY_MARK(stream.dirty, addr);
+    }
+}
+
+void mon_stream_shutdown(void)
+{
+    mon_stream_unsubscribe();
+    lib_free(stream.buffer);
+    stream.buffer = NULL;
+    stream.buffer_size = 0;
+}
@@ -0,0 +1,64 @@
+/** \file   mon_stream.h
+ *  \brief  The VICE built-in monitor, per-frame state delta subscription.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_MON_STREAM_H
+#define VICE_MON_STREAM_H
+
+#include "montypes.h"
+#include "types.h"
+
+/* subscription flags, as passed to mon_stream_subscribe() */
+#define MON_STREAM_SCREEN       (1 << 0)    /**< screen RAM at the current video matrix */
+#define MON_STREAM_COLOR_RAM    (1 << 1)    /**< color RAM, low nibbles */
+#define MON_STREAM_REGISTERS    (1 << 2)    /**< registers of the memspace's CPU */
+#define MON_STREAM_FULL_COMPARE (1 << 3)    /**< compare the ranges every time, also sees DMA */
+#define MON_STREAM_ALL          (MON_STREAM_SCREEN | MON_STREAM_COLOR_RAM | MON_STREAM_REGISTERS | MON_STREAM_FULL_COMPARE)
+
+#define MON_STREAM_MAX_RANGES   16
+
+/* sources of the (offset, length, data) records of a delta */
+enum mon_stream_source_e {
+    e_MON_STREAM_SOURCE_MEMORY = 0,     /**< offset is the address */
+    e_MON_STREAM_SOURCE_SCREEN,         /**< offset from the video matrix base */
+    e_MON_STREAM_SOURCE_COLOR_RAM,      /**< offset from $d800 */
+    e_MON_STREAM_SOURCE_REGISTERS       /**< u16 per register, REGISTERS_AVAILABLE order */
+};
+typedef enum mon_stream_source_e mon_stream_source_t;
+
+int mon_stream_subscribe(MEMSPACE mem, int bank, unsigned int flags, unsigned int interval,
+                         const uint16_t *starts, const uint16_t *ends, unsigned int count);
+void mon_stream_unsubscribe(void);
+unsigned int mon_stream_get_flags(void);
+bool mon_stream_frame(void);
+uint32_t mon_stream_delta(uint8_t **body);
+void mon_stream_invalidate(void);
+
+bool mon_stream_wants_watch(MEMSPACE mem);
+void mon_stream_mark_watch_pages(MEMSPACE mem, uint8_t *pages);
+void mon_stream_mark_store(MEMSPACE mem, uint16_t addr);
+
+void mon_stream_shutdown(void);
+
+#endif
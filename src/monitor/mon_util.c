@@ -40,6 +40,7 @@
 #include "lib.h"
 #include "mem.h"
 #include "mon_disassemble.h"
+#include "mon_stream.h"
 #include "mon_util.h"
 #include "monitor.h"
 #include "monitor_network.h"
@@ -184,6 +185,9 @@ void mon_event_opened(void) {
 /*! \internal \brief Notify interested interfaces that the monitor closed.
 */
 void mon_event_closed(void) {
+    /* memory may have been changed behind the stream's store tracking */
+    mon_stream_invalidate();
+
     #ifdef HAVE_NETWORK
         if (monitor_is_binary()) {
             monitor_binary_event_closed();
@@ -484,7 +488,8 @@ char *uimon_in(const char *prompt)
 {
     char *p = NULL;
 #ifdef HAVE_NETWORK
-    vice_network_socket_t *sockfd[3];
+    vice_network_socket_t *sockfd[2 + MONITOR_BINARY_MAX_SOCKETS];
+    vice_network_socket_t *writesockfd[1 + MONITOR_BINARY_MAX_CLIENTS];
     int sockfd_index = 0;
 #endif
 
@@ -506,18 +511,22 @@ char *uimon_in(const char *prompt)
             sockfd_index++;
         }
 
+        writesockfd[0] = NULL;
         if (!monitor_is_binary()) {
             monitor_check_binary();
         } else {
-            sockfd[sockfd_index] = monitor_binary_get_connected_socket();
-            sockfd_index++;
+            sockfd_index += monitor_binary_get_sockets(&sockfd[sockfd_index]);
+            writesockfd[monitor_binary_get_pending_sockets(writesockfd)] = NULL;
         }
 
         sockfd[sockfd_index] = NULL;
 
         if (monitor_is_remote() || monitor_is_binary()) {
 
-            vice_network_select_multiple(sockfd);
+            /* requests may already be buffered from an earlier read */
+            if (!monitor_binary_request_pending()) {
+                vice_network_select_multiple_writable(sockfd, writesockfd);
+            }
 
             if (monitor_is_binary()) {
                 if (!monitor_binary_get_command_line()) {
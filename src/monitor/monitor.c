@@ -63,6 +63,8 @@
 #include "machine-video.h"
 #include "mem.h"
 #include "mon_breakpoint.h"
+#include "mon_coverage.h"
+#include "mon_stream.h"
 #include "mon_disassemble.h"
 #include "mon_memmap.h"
 #include "mon_memory.h"
@@ -70,6 +72,7 @@
 
 #include "mon_parse.h"
 #include "mon_register.h"
+#include "mon_shm.h"
 #include "mon_util.h"
 #include "monitor.h"
 #include "monitor_network.h"
@@ -82,6 +85,7 @@
 
 #include "resources.h"
 #include "screenshot.h"
+#include "snapshot.h"
 #include "sysfile.h"
 #include "tape.h"
 #include "traps.h"
@@ -378,6 +382,9 @@ static bool is_machine_ready(void)
 
 void monitor_reset_hook(void)
 {
+    /* the reset initialized RAM without going through the store path */
+    mon_stream_invalidate();
+
     if (init_break_mode == ON_RESET) {
         init_break_mode = NONE;
 
@@ -405,6 +412,7 @@ void monitor_vsync_hook(void)
     /* check if someone wants to connect remotely to the monitor */
     monitor_check_remote();
     monitor_check_binary();
+    mon_shm_update();
 #endif
 }
 
@@ -1664,6 +1672,7 @@ void monitor_shutdown(void)
     }
 
     mon_log_file_close();
+    mon_free_snapshot_slots();
 
     list = monitor_cpu_type_list;
 
@@ -1682,6 +1691,8 @@ void monitor_shutdown(void)
     }
 
     mon_memmap_shutdown();
+    mon_coverage_shutdown();
+    mon_stream_shutdown();
 
     while (playback_fp_stack_size) {
         playback_end_file();
@@ -2804,6 +2815,64 @@ int mon_read_snapshot(const char *name, int even_mode)
     return ret;
 }
 
+/* In-memory snapshot slots, see snapshot_memory_select().  */
+static snapshot_memory_t *snapshot_slots[MON_SNAPSHOT_SLOTS];
+
+/* Returns the size of the snapshot, or -1 on error.  */
+long mon_write_snapshot_slot(unsigned int slot, int save_roms, int save_disks)
+{
+    int ret;
+
+    if (slot >= MON_SNAPSHOT_SLOTS) {
+        return -1;
+    }
+
+    if (snapshot_slots[slot] == NULL) {
+        snapshot_slots[slot] = snapshot_memory_new();
+    }
+
+    snapshot_memory_select(snapshot_slots[slot]);
+    ret = machine_write_snapshot("", save_roms, save_disks, 0);
+    snapshot_memory_select(NULL);
+
+    if (ret < 0) {
+        snapshot_memory_free(snapshot_slots[slot]);
+        snapshot_slots[slot] = NULL;
+        return -1;
+    }
+
+    return (long)snapshot_memory_get_size(snapshot_slots[slot]);
+}
+
+/* Returns 0 on success, -1 on error, -2 if the slot is empty.  */
+int mon_read_snapshot_slot(unsigned int slot)
+{
+    int ret;
+
+    if (slot >= MON_SNAPSHOT_SLOTS || snapshot_slots[slot] == NULL) {
+        return -2;
+    }
+
+    snapshot_memory_select(snapshot_slots[slot]);
+    ret = machine_read_snapshot("", 0);
+    snapshot_memory_select(NULL);
+
+    /* Reset the current address */
+    dot_addr[e_comp_space] = new_addr(e_comp_space, ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC))));
+
+    return ret;
+}
+
+void mon_free_snapshot_slots(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < MON_SNAPSHOT_SLOTS; i++) {
+        snapshot_memory_free(snapshot_slots[i]);
+        snapshot_slots[i] = NULL;
+    }
+}
+
 
 /* *** WATCHPOINTS *** */
 
@@ -2814,6 +2883,12 @@ void monitor_watch_push_load_addr(uint16_t addr, MEMSPACE mem)
         return;
     }
 
+    /* the trampolines may only be active for load coverage */
+    mon_coverage_mark_load(mem, addr);
+    if (!(monitor_mask[mem] & MI_WATCH)) {
+        return;
+    }
+
     if (watch_load_count[mem] == MONITOR_MAX_CHECKPOINTS) {
         return;
     }
@@ -2829,6 +2904,13 @@ void monitor_watch_push_store_addr(uint16_t addr, MEMSPACE mem)
         return;
     }
 
+    /* the trampolines may only be active for store coverage or a stream */
+    mon_coverage_mark_store(mem, addr);
+    mon_stream_mark_store(mem, addr);
+    if (!(monitor_mask[mem] & MI_WATCH)) {
+        return;
+    }
+
     if (watch_store_count[mem] == MONITOR_MAX_CHECKPOINTS) {
         return;
     }
@@ -33,6 +33,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_UNIX_DOMAIN_SOCKETS
+#include <sys/stat.h>
+#endif
+
+#include "alarm.h"
+#include "archdep.h"
 #include "archdep_defs.h"
 #include "attach.h"
 #include "cmdline.h"
@@ -41,6 +47,7 @@
 #include "lib.h"
 #include "log.h"
 #include "kbdbuf.h"
+#include "mainlock.h"
 #include "monitor.h"
 #include "monitor_binary.h"
 #include "montypes.h"
@@ -49,6 +56,7 @@
 #include "util.h"
 #include "vicesocket.h"
 #include "machine.h"
+#include "maincpu.h"
 #include "screenshot.h"
 #include "machine-video.h"
 #include "palette.h"
@@ -56,9 +64,12 @@
 
 #include "mon_memmap.h"
 #include "mon_breakpoint.h"
+#include "mon_coverage.h"
 #include "mon_file.h"
 #include "mon_keymatrix.h"
 #include "mon_screen.h"
+#include "mon_shm.h"
+#include "mon_stream.h"
 #include "mon_video.h"
 #include "mon_register.h"
 
@@ -82,10 +93,24 @@
 #define ADDR_LIMIT(x) ((uint16_t)(addr_mask(x)))
 
 static vice_network_socket_t * listen_socket = NULL;
-static vice_network_socket_t * connected_socket = NULL;
 
 static char *monitor_binary_server_address = NULL;
 static int monitor_binary_enabled = 0;
+static char *monitor_binary_shm_name = NULL;
+
+/* path of a unix domain listening socket, removed again on deactivation */
+static char *listen_path = NULL;
+
+/* what to do with a client that has more than monitor_binary_high_water
+   bytes of output waiting, see monitor_binary_client_high_water() */
+enum {
+    MON_BINARY_HIGH_WATER_BLOCK = 0,
+    MON_BINARY_HIGH_WATER_DROP,
+    MON_BINARY_HIGH_WATER_DISCONNECT
+};
+
+static int monitor_binary_high_water = 0;
+static int monitor_binary_high_water_policy = MON_BINARY_HIGH_WATER_BLOCK;
 
 enum t_binary_command {
     e_MON_CMD_INVALID = 0x00,
@@ -119,6 +144,12 @@ enum t_binary_command {
     e_MON_CMD_SCREEN_GET    = 0x77,
     e_MON_CMD_DRIVE_ATTACH  = 0x78,
     e_MON_CMD_VIDEO_RECORD  = 0x79,
+    e_MON_CMD_COVERAGE_SET  = 0x7a,
+    e_MON_CMD_COVERAGE_GET  = 0x7b,
+    e_MON_CMD_SNAPSHOT_SAVE = 0x7c,
+    e_MON_CMD_SNAPSHOT_LOAD = 0x7d,
+    e_MON_CMD_RUN_FOR       = 0x7e,
+    e_MON_CMD_BATCH         = 0x7f,
 
     e_MON_CMD_PING = 0x81,
     e_MON_CMD_BANKS_AVAILABLE = 0x82,
@@ -126,6 +157,7 @@ enum t_binary_command {
     e_MON_CMD_DISPLAY_GET = 0x84,
     e_MON_CMD_VICE_INFO = 0x85,
     e_MON_CMD_CPUHISTORY_GET = 0x86,
+    e_MON_CMD_STREAM_SUBSCRIBE = 0x87,
 
     e_MON_CMD_PALETTE_GET = 0x91,
 
@@ -164,6 +196,7 @@ enum t_binary_response {
     e_MON_RESPONSE_JAM = 0x61,
     e_MON_RESPONSE_STOPPED = 0x62,
     e_MON_RESPONSE_RESUMED = 0x63,
+    e_MON_RESPONSE_STREAM_DELTA = 0x64,
 
     e_MON_RESPONSE_ADVANCE_INSTRUCTIONS = 0x71,
     e_MON_RESPONSE_KEYBOARD_FEED = 0x72,
@@ -174,6 +207,12 @@ enum t_binary_response {
     e_MON_RESPONSE_SCREEN_GET    = 0x77,
     e_MON_RESPONSE_DRIVE_ATTACH  = 0x78,
     e_MON_RESPONSE_VIDEO_RECORD  = 0x79,
+    e_MON_RESPONSE_COVERAGE_SET  = 0x7a,
+    e_MON_RESPONSE_COVERAGE_GET  = 0x7b,
+    e_MON_RESPONSE_SNAPSHOT_SAVE = 0x7c,
+    e_MON_RESPONSE_SNAPSHOT_LOAD = 0x7d,
+    e_MON_RESPONSE_RUN_FOR       = 0x7e,
+    e_MON_RESPONSE_BATCH         = 0x7f,
 
     e_MON_RESPONSE_PING = 0x81,
     e_MON_RESPONSE_BANKS_AVAILABLE = 0x82,
@@ -181,6 +220,7 @@ enum t_binary_response {
     e_MON_RESPONSE_DISPLAY_GET = 0x84,
     e_MON_RESPONSE_VICE_INFO = 0x85,
     e_MON_RESPONSE_CPUHISTORY_GET = 0x86,
+    e_MON_RESPONSE_STREAM_SUBSCRIBE = 0x87,
 
     e_MON_RESPONSE_PALETTE_GET = 0x91,
 
@@ -203,6 +243,7 @@ enum t_mon_error {
     e_MON_ERR_INVALID_PARAMETER = 0x81,
     e_MON_ERR_CMD_INVALID_API_VERSION = 0x82,
     e_MON_ERR_CMD_INVALID_TYPE = 0x83,
+    e_MON_ERR_NOT_CONTROLLER = 0x84,
     e_MON_ERR_CMD_FAILURE = 0x8f,
 };
 typedef enum t_mon_error BINARY_ERROR;
@@ -227,263 +268,1084 @@ struct binary_command_s {
 };
 typedef struct binary_command_s binary_command_t;
 
-int monitor_binary_transmit(const unsigned char *buffer, size_t buffer_length)
-{
-    int error = 0;
+static void monitor_binary_dispatch_command(binary_command_t *command);
 
-    if (connected_socket) {
-        size_t len = (size_t)vice_network_send(connected_socket, buffer, buffer_length, 0);
+#define ASC_STX 0x02
 
-        if (len != buffer_length) {
-            error = -1;
-        } else {
-            error = (int)len;
+/* STX, API version, body length, request id, command type */
+#define MON_BINARY_HEADER_SIZE 11
+
+/* How often the running emulator checks for requests between vsyncs, in
+   cycles of the main CPU, and at most how often that really calls select(),
+   in ticks of real time (matters in warp mode).  */
+#define MON_BINARY_POLL_CYCLES  1000
+#define MON_BINARY_POLL_TICKS   250
+
+/* STX, API version, body length, response type, error code, request id */
+#define MON_BINARY_RESPONSE_HEADER_SIZE 12
+
+/* initial size of the output ring of a client, it grows in powers of two */
+#define MON_BINARY_TX_RING_SIZE 0x10000
+
+/* How long the BLOCK high-water policy waits for a client at a time, and
+   how long the output of the clients may take to drain when they are
+   disconnected on shutdown, in microseconds */
+#define MON_BINARY_TX_WAIT_US   250000
+#define MON_BINARY_TX_DRAIN_US  1000000
+
+/* How many different events at the end of the output ring of a client
+   are remembered for merging */
+#define MON_BINARY_COALESCE_SLOTS 16
+
+/* An event in the output ring that may be merged with a later one */
+struct binary_coalesce_s {
+    BINARY_RESPONSE type;
+    uint32_t key;
+    size_t body;            /* ring position of the body */
+    uint32_t length;
+};
+typedef struct binary_coalesce_s binary_coalesce_t;
+
+/* A connected client.
+
+   The first client that connects while there is no controller becomes the
+   controller, the only one whose requests may change the machine state.
+   Everybody else is an observer: observers get all events, but may only
+   send requests that read state (see monitor_binary_command_is_read_only()),
+   which are answered at the next instruction boundary without stopping the
+   CPU.
+
+   The receive buffer holds whatever has arrived on the socket: any number
+   of complete requests, possibly followed by a partial one. Requests are
+   processed in place from rx_start.
+
+   Output is sent without blocking. What the socket does not take right
+   away waits in the output ring and is sent with the next flush, so a
+   client that reads slowly does not stall the emulation. What happens once
+   more than BinaryMonitorHighWater bytes wait depends on
+   BinaryMonitorHighWaterPolicy, see monitor_binary_client_high_water().  */
+struct binary_client_s {
+    vice_network_socket_t *socket;
+    bool controller;
+
+    unsigned char *rx_buffer;
+    size_t rx_size;
+    size_t rx_start;
+    size_t rx_end;
+
+    /* output ring: the bytes from tx_tail to tx_head wait to be sent. Both
+       count from when the ring was last empty, their offset in tx_buffer
+       is the count modulo tx_size, which is a power of two. */
+    unsigned char *tx_buffer;
+    size_t tx_size;
+    size_t tx_head;
+    size_t tx_tail;
+
+    /* the events at the end of the ring that may still be merged with
+       later ones, see monitor_binary_event_coalesced() */
+    binary_coalesce_t coalesce[MON_BINARY_COALESCE_SLOTS];
+    unsigned int coalesce_count;
+
+    /* events are dropped for the client, see monitor_binary_client_transmit() */
+    bool dropping;
+
+    /* a DISPLAY_GET waits for a drawn frame, see monitor_binary_process_display_get() */
+    bool display_pending;
+    uint32_t display_request_id;
+    uint8_t display_use_vic;
+    DISPLAY_GET_MODE display_format;
+};
+typedef struct binary_client_s binary_client_t;
+
+static binary_client_t clients[MONITOR_BINARY_MAX_CLIENTS];
+static binary_client_t *controller = NULL;
+
+/* The client whose request is processed, it gets the responses */
+static binary_client_t *current_client = NULL;
+
+/* Set while a BATCH is processed, the responses are collected in the
+   transmit buffer of the client so they go out with a single send().  */
+static bool tx_batching = false;
+
+static bool observer_trap_pending = false;
+static bool display_trap_pending = false;
+
+static alarm_t *poll_alarm = NULL;
+static tick_t poll_last_tick = 0;
+
+/* RUN_FOR flags, see monitor_binary_process_run_for() */
+#define MON_RUN_FOR_UNIT_CYCLES 0x00
+#define MON_RUN_FOR_UNIT_FRAMES 0x01
+
+#define MON_RUN_FOR_WITH_SCREEN 0x01
+#define MON_RUN_FOR_WITH_MEMORY 0x02
+
+/* A RUN_FOR in progress. Its response is only sent once the CPU stops.  */
+struct run_for_s {
+    bool active;
+    uint32_t request_id;
+    uint32_t frames;        /* frames still to run, 0 when counting cycles */
+    CLOCK stop_clk;
+    uint8_t flags;
+    uint16_t start;
+    uint16_t end;
+    MEMSPACE memspace;
+    int banknum;
+};
+typedef struct run_for_s run_for_t;
+
+static run_for_t run_for;
+static alarm_t *run_for_alarm = NULL;
+
+#define FOR_EACH_CLIENT(client) \
+    for ((client) = clients; (client) < clients + MONITOR_BINARY_MAX_CLIENTS; (client)++)
+
+static void monitor_binary_close_client(binary_client_t *client)
+{
+    if (client->socket == NULL) {
+        return;
+    }
+
+    /* the buffers stay, the request being processed may still live in it */
+    vice_network_socket_close(client->socket);
+    client->socket = NULL;
+    client->rx_start = client->rx_end = 0;
+    client->tx_head = client->tx_tail = 0;
+    client->coalesce_count = 0;
+    client->dropping = false;
+    client->display_pending = false;
+
+    if (client == controller) {
+        log_message(LOG_DEFAULT, "Binary monitor: controller disconnected.");
+        controller = NULL;
+        client->controller = false;
+
+        if (run_for.active) {
+            alarm_unset(run_for_alarm);
+            run_for.active = false;
         }
     }
 
-    return error;
+    if (!monitor_is_binary()) {
+        mon_stream_unsubscribe();
+    }
 }
 
+static int monitor_binary_client_flush(binary_client_t *client);
+
 static void monitor_binary_quit(void)
 {
-    vice_network_socket_close(connected_socket);
-    connected_socket = NULL;
+    binary_client_t *client;
+
+    FOR_EACH_CLIENT(client) {
+        /* give the last responses, like that of QUIT, a chance to get out */
+        while (client->socket != NULL && client->tx_head != client->tx_tail
+               && vice_network_select_wait_writable(client->socket, MON_BINARY_TX_DRAIN_US) > 0
+               && monitor_binary_client_flush(client) == 0) {
+        }
+        monitor_binary_close_client(client);
+    }
 }
 
-ssize_t monitor_binary_receive(unsigned char *buffer, size_t buffer_length)
+static void monitor_binary_accept(void)
 {
-    ssize_t bytes_received = 0;
-    ssize_t total_bytes_received = 0;
+    binary_client_t *client;
 
-    while (buffer_length && connected_socket) {
-        bytes_received = vice_network_receive(connected_socket, buffer, buffer_length, 0);
+    if (listen_socket == NULL) {
+        return;
+    }
 
-        if (bytes_received <= 0) {
-            log_message(LOG_DEFAULT,
-                        "monitor_binary_receive(): vice_network_receive() returned %"PRI_SSIZE_T", breaking connection",
-                        bytes_received);
-            monitor_binary_quit();
+    FOR_EACH_CLIENT(client) {
+        if (client->socket == NULL) {
             break;
         }
+    }
 
-        if (bytes_received < buffer_length) {
-            log_message(LOG_DEFAULT,
-                        "monitor_binary_receive(): received %"PRI_SSIZE_T" of %"PRI_SIZE_T,
-                        bytes_received, buffer_length);
-        }
+    /* when all slots are taken, further connections wait in the backlog */
+    if (client == clients + MONITOR_BINARY_MAX_CLIENTS ||
+        !vice_network_select_poll_one(listen_socket)) {
+        return;
+    }
+
+    client->socket = vice_network_accept(listen_socket);
+    if (client->socket == NULL) {
+        return;
+    }
 
-        total_bytes_received += bytes_received;
-        buffer += bytes_received;
-        buffer_length -= bytes_received;
+    client->rx_start = client->rx_end = 0;
+    client->tx_head = client->tx_tail = 0;
+    client->coalesce_count = 0;
+    client->dropping = false;
+    client->display_pending = false;
+    client->controller = (controller == NULL);
+    if (client->controller) {
+        controller = client;
     }
 
-    return total_bytes_received;
+    log_message(LOG_DEFAULT, "Binary monitor: %s connected.",
+                client->controller ? "controller" : "observer");
 }
 
-static int monitor_binary_data_available(void)
+/* Copy between the output ring of a client and a linear buffer, wrapping
+   around at the end of the ring */
+static void monitor_binary_tx_ring_write(binary_client_t *client, size_t pos, const unsigned char *data, size_t length)
 {
-    int available = 0;
+    size_t offset = pos & (client->tx_size - 1);
+    size_t first = client->tx_size - offset;
 
-    if (connected_socket != NULL) {
-        available = vice_network_select_poll_one(connected_socket);
-    } else if (listen_socket != NULL) {
-        /* we have no connection yet, allow for connection */
-
-        if (vice_network_select_poll_one(listen_socket)) {
-            connected_socket = vice_network_accept(listen_socket);
-        }
+    if (first > length) {
+        first = length;
+    }
+    memcpy(client->tx_buffer + offset, data, first);
+    if (length > first) {
+        memcpy(client->tx_buffer, data + first, length - first);
     }
-
-
-    return available;
 }
 
-void monitor_check_binary(void)
+static void monitor_binary_tx_ring_read(binary_client_t *client, size_t pos, unsigned char *data, size_t length)
 {
-    if (monitor_binary_data_available()) {
-        monitor_startup_trap();
+    size_t offset = pos & (client->tx_size - 1);
+    size_t first = client->tx_size - offset;
+
+    if (first > length) {
+        first = length;
+    }
+    memcpy(data, client->tx_buffer + offset, first);
+    if (length > first) {
+        memcpy(data + first, client->tx_buffer, length - first);
     }
 }
 
-#define ASC_STX 0x02
+/* make room for length more bytes in the output ring of a client */
+static void monitor_binary_tx_ring_reserve(binary_client_t *client, size_t length)
+{
+    size_t pending = client->tx_head - client->tx_tail;
+    size_t size = client->tx_size != 0 ? client->tx_size : MON_BINARY_TX_RING_SIZE;
+    unsigned char *buffer;
+    unsigned int i;
 
-#define MON_BINARY_API_VERSION 0x02
+    if (client->tx_size - pending >= length) {
+        return;
+    }
 
-#define MON_EVENT_ID 0xffffffff
+    while (size - pending < length) {
+        size *= 2;
+    }
 
-/*! \internal \brief Write uint16 to buffer and return pointer to byte after */
-static unsigned char *write_uint16(uint16_t input, unsigned char *output) {
-    output[0] = input & 0xFFu;
-    output[1] = (input >> 8) & 0xFFu;
+    buffer = lib_malloc(size);
+    if (pending > 0) {
+        monitor_binary_tx_ring_read(client, client->tx_tail, buffer, pending);
+    }
+    lib_free(client->tx_buffer);
+    client->tx_buffer = buffer;
+    client->tx_size = size;
 
-    return output + 2;
+    for (i = 0; i < client->coalesce_count; i++) {
+        client->coalesce[i].body -= client->tx_tail;
+    }
+    client->tx_head = pending;
+    client->tx_tail = 0;
 }
 
-/*! \internal \brief Write uint32 to buffer and return pointer to byte after */
-static unsigned char *write_uint32(uint32_t input, unsigned char *output) {
-    output[0] = input & 0xFFu;
-    output[1] = (input >> 8) & 0xFFu;
-    output[2] = (input >> 16) & 0xFFu;
-    output[3] = (uint8_t)(input >> 24) & 0xFFu;
+/*! \internal \brief Send as much of the output ring of a client as the socket takes
 
-    return output + 4;
-}
+ \return
+   -1 if the client was disconnected, else 0
+*/
+static int monitor_binary_client_flush(binary_client_t *client)
+{
+    vice_network_buffer_t buffers[2];
+    unsigned int count;
+    size_t pending;
+    size_t offset;
+    ssize_t sent;
 
-/*! \internal \brief Write uint64 to buffer and return pointer to byte after */
-static unsigned char *write_uint64(uint64_t input, unsigned char *output) {
-    for (int i = 0 ; i < 8 ; i++) {
-        output[i] = (uint8_t)(input >> (8 * i)) & 0xFFu;
+    if (client == NULL || client->socket == NULL) {
+        return -1;
     }
 
-    return output + 8;
-}
+    while (client->tx_tail != client->tx_head) {
+        /* the part up to the end of the ring and the part that wrapped around */
+        pending = client->tx_head - client->tx_tail;
+        offset = client->tx_tail & (client->tx_size - 1);
+        buffers[0].data = client->tx_buffer + offset;
+        buffers[0].length = client->tx_size - offset;
+        count = 1;
+        if (buffers[0].length >= pending) {
+            buffers[0].length = pending;
+        } else {
+            buffers[1].data = client->tx_buffer;
+            buffers[1].length = pending - buffers[0].length;
+            count = 2;
+        }
 
-/*! \internal \brief Write string to buffer and return pointer to byte after */
-static unsigned char *write_string(uint8_t length, unsigned char *input, unsigned char *output) {
-    output[0] = length;
-    memcpy(&output[1], input, length);
+        sent = vice_network_sendv_nonblocking(client->socket, buffers, count);
+        if (sent < 0) {
+            log_message(LOG_DEFAULT, "Binary monitor: send failed, breaking connection.");
+            monitor_binary_close_client(client);
+            return -1;
+        }
+        if (sent == 0) {
+            break;
+        }
+        client->tx_tail += (size_t)sent;
+    }
 
-    return output + length + 1;
-}
+    if (client->tx_tail == client->tx_head) {
+        client->tx_head = client->tx_tail = 0;
+        client->coalesce_count = 0;
+        if (client->dropping) {
+            log_message(LOG_DEFAULT, "Binary monitor: client caught up, sending events again.");
+            client->dropping = false;
+        }
+    }
 
-/*! \internal \brief Read 32bit little endian value from buffer to uint32 value */
-static uint32_t little_endian_to_uint32(unsigned char *input) {
-    return (input[3] << 24) + (input[2] << 16) + (input[1] << 8) + input[0];
+    return 0;
 }
 
-/*! \internal \brief Read 16bit little endian value from buffer to uint16 value */
-static uint16_t little_endian_to_uint16(unsigned char *input) {
-    return (input[1] << 8) + input[0];
-}
+/*! \internal \brief Apply the high-water policy to a client
 
-static void monitor_binary_response(uint32_t length, BINARY_RESPONSE response_type, BINARY_ERROR errorcode, uint32_t request_id, unsigned char *body)
+ BLOCK waits until the client has read enough, DROP lets
+ monitor_binary_client_transmit() drop events, DISCONNECT breaks the
+ connection. Observers are never waited for, BLOCK disconnects them.
+
+ \return
+   -1 if the client was disconnected, else 0
+*/
+static int monitor_binary_client_high_water(binary_client_t *client)
 {
-    unsigned char response[12];
+    size_t high_water = (size_t)monitor_binary_high_water;
+    int policy = monitor_binary_high_water_policy;
+    int ready;
 
-    response[0] = ASC_STX;
-    response[1] = MON_BINARY_API_VERSION;
-    write_uint32(length, &response[2]);
-    response[6] = (uint8_t)response_type;
-    response[7] = (uint8_t)errorcode;
-    write_uint32(request_id, &response[8]);
+    if (client->tx_head - client->tx_tail <= high_water) {
+        return 0;
+    }
 
-    monitor_binary_transmit(response, sizeof response);
+    if (policy == MON_BINARY_HIGH_WATER_BLOCK && !client->controller) {
+        policy = MON_BINARY_HIGH_WATER_DISCONNECT;
+    }
 
-    if (body != NULL) {
-        monitor_binary_transmit(body, length);
+    switch (policy) {
+        case MON_BINARY_HIGH_WATER_BLOCK:
+            while (client->tx_head - client->tx_tail > high_water) {
+                mainlock_yield_begin();
+                ready = vice_network_select_wait_writable(client->socket, MON_BINARY_TX_WAIT_US);
+                mainlock_yield_end();
+                if (ready < 0 || monitor_binary_client_flush(client) < 0) {
+                    monitor_binary_close_client(client);
+                    return -1;
+                }
+            }
+            break;
+        case MON_BINARY_HIGH_WATER_DROP:
+            break;
+        default:
+            log_message(LOG_DEFAULT, "Binary monitor: client does not read its output, breaking connection.");
+            monitor_binary_close_client(client);
+            return -1;
     }
-}
 
-static void monitor_binary_error(BINARY_ERROR errorcode, uint32_t request_id)
-{
-    monitor_binary_response(0, 0, errorcode, request_id, NULL);
+    return 0;
 }
 
-static void monitor_binary_response_stopped(uint32_t request_id)
-{
-    unsigned char response[2];
-    uint16_t addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+/*! \internal \brief Send to a client
 
-    write_uint16(addr, response);
+ Sends right away what the socket takes and queues the rest in the output
+ ring. While a BATCH of the client is processed everything is queued, so
+ the responses go out together at the end.
 
-    monitor_binary_response(2, e_MON_RESPONSE_STOPPED, e_MON_ERR_OK, MON_EVENT_ID, response);
-}
+ \param buffers
+   the pieces of the output, a response header and body
 
-static void monitor_binary_response_resumed(uint32_t request_id)
+ \param event
+   the output is an event, which the DROP high-water policy may drop
+
+ \return
+   -1 if the client was disconnected, 1 if the event was dropped, else 0
+*/
+static int monitor_binary_client_transmit(binary_client_t *client, const vice_network_buffer_t *buffers,
+                                          unsigned int count, bool event)
 {
-    unsigned char response[2];
-    uint16_t addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+    bool batching = tx_batching && client == current_client;
+    bool queued = false;
+    size_t skip = 0;
+    ssize_t sent;
+    unsigned int i;
 
-    write_uint16(addr, response);
+    if (client->socket == NULL) {
+        return -1;
+    }
 
-    monitor_binary_response(2, e_MON_RESPONSE_RESUMED, e_MON_ERR_OK, MON_EVENT_ID, response);
+    if (event && monitor_binary_high_water_policy == MON_BINARY_HIGH_WATER_DROP
+        && client->tx_head - client->tx_tail > (size_t)monitor_binary_high_water) {
+        if (!client->dropping) {
+            log_message(LOG_DEFAULT, "Binary monitor: client does not read its output, dropping events.");
+            client->dropping = true;
+        }
+        return 1;
+    }
+
+    /* send right away if nothing is queued before */
+    if (!batching && client->tx_head == client->tx_tail) {
+        sent = vice_network_sendv_nonblocking(client->socket, buffers, count);
+        if (sent < 0) {
+            log_message(LOG_DEFAULT, "Binary monitor: send failed, breaking connection.");
+            monitor_binary_close_client(client);
+            return -1;
+        }
+        skip = (size_t)sent;
+    }
+
+    /* queue what the socket did not take */
+    for (i = 0; i < count; i++) {
+        const unsigned char *data = buffers[i].data;
+        size_t length = buffers[i].length;
+
+        if (skip >= length) {
+            skip -= length;
+            continue;
+        }
+        data += skip;
+        length -= skip;
+        skip = 0;
+
+        monitor_binary_tx_ring_reserve(client, length);
+        monitor_binary_tx_ring_write(client, client->tx_head, data, length);
+        client->tx_head += length;
+        queued = true;
+    }
+
+    if (queued) {
+        /* the events before can't be merged anymore, see
+           monitor_binary_event_coalesced() */
+        client->coalesce_count = 0;
+    }
+
+    if (batching || !queued) {
+        return 0;
+    }
+
+    if (monitor_binary_client_flush(client) < 0) {
+        return -1;
+    }
+
+    return monitor_binary_client_high_water(client);
 }
 
-ui_jam_action_t monitor_binary_ui_jam_dialog(const char *format, ...)
+/* Responses go to the client whose request is processed, or to the
+   controller for a response that is sent later, like that of RUN_FOR. */
+int monitor_binary_transmit(const unsigned char *buffer, size_t buffer_length)
 {
-    unsigned char response[2];
-    uint16_t addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+    binary_client_t *client = current_client != NULL ? current_client : controller;
+    vice_network_buffer_t piece;
 
-    write_uint16(addr, response);
+    if (client == NULL) {
+        return 0;
+    }
 
-    monitor_binary_response(0, e_MON_RESPONSE_JAM, e_MON_ERR_OK, MON_EVENT_ID, response);
+    piece.data = buffer;
+    piece.length = buffer_length;
 
-    return UI_JAM_MONITOR;
+    return monitor_binary_client_transmit(client, &piece, 1, false) < 0 ? -1 : (int)buffer_length;
 }
 
-static bool ignore_fake_register(mon_reg_list_t *reg)
+/*! \internal \brief Read whatever is available on the socket of a client into its receive buffer
+
+ \return
+   -1 if the connection was closed, else 0
+*/
+static int monitor_binary_receive_available(binary_client_t *client)
 {
-    return reg->flags & MON_REGISTER_IS_FLAGS;
-}
+    ssize_t bytes_received;
 
-static MEMSPACE get_requested_memspace(uint8_t requested_memspace) {
-    if (requested_memspace == 0) {
-        return e_comp_space;
-    } else if (requested_memspace == 1) {
-        return e_disk8_space;
-    } else if (requested_memspace == 2) {
-        return e_disk9_space;
-    } else if (requested_memspace == 3) {
-        return e_disk10_space;
-    } else if (requested_memspace == 4) {
-        return e_disk11_space;
-    } else {
-        return e_invalid_space;
+    if (client->socket == NULL) {
+        return -1;
     }
-}
 
-static uint8_t memspace_to_uint8_t(MEMSPACE mem) {
-    if (mem == e_comp_space) {
+    if (!vice_network_select_poll_one(client->socket)) {
         return 0;
-    } else if(mem == e_disk8_space) {
-        return 1;
-    } else if(mem == e_disk9_space) {
-        return 2;
-    } else if(mem == e_disk10_space) {
-        return 3;
-    } else if(mem == e_disk11_space) {
-        return 4;
-    } else {
-        return 0xff;
     }
-}
 
-#define MON_REGISTER_ITEM_SIZE 3
+    if (client->rx_start == client->rx_end) {
+        client->rx_start = client->rx_end = 0;
+    } else if (client->rx_start > 0) {
+        memmove(client->rx_buffer, client->rx_buffer + client->rx_start, client->rx_end - client->rx_start);
+        client->rx_end -= client->rx_start;
+        client->rx_start = 0;
+    }
 
-static uint16_t count_registers(mon_reg_list_t *regs) {
-    uint16_t count = 0;
+    /* keep some slack behind the data, command handlers may peek at body
+       bytes before checking the body length */
+    if (client->rx_size - client->rx_end < 0x1000) {
+        client->rx_size = client->rx_end + 0x2000;
+        client->rx_buffer = lib_realloc(client->rx_buffer, client->rx_size);
+    }
 
-    for( ; regs->name ; regs++) {
-        if (!ignore_fake_register(regs)) {
-            ++count;
-        }
+    bytes_received = vice_network_receive(client->socket, client->rx_buffer + client->rx_end,
+                                          client->rx_size - client->rx_end - 0x100, 0);
+    if (bytes_received <= 0) {
+        log_message(LOG_DEFAULT,
+                    "monitor_binary_receive_available(): vice_network_receive() returned %"PRI_SSIZE_T", breaking connection",
+                    bytes_received);
+        monitor_binary_close_client(client);
+        return -1;
     }
 
-    return count;
+    client->rx_end += (size_t)bytes_received;
+
+    return 0;
 }
 
-static unsigned char *write_registers(mon_reg_list_t *regs, uint16_t count, unsigned char *response_cursor) {
-    response_cursor = write_uint16(count, response_cursor);
+/*! \internal \brief Find the next complete request in the receive buffer of a client
 
-    for( ; regs->name ; regs++) {
-        if (ignore_fake_register(regs)) {
+ Skips garbage before the STX and requests with an unsupported API version.
+
+ \return
+   size of the request at rx_start, or 0 if no complete request is buffered
+*/
+static size_t monitor_binary_next_request(binary_client_t *client)
+{
+    unsigned char *request;
+    size_t available;
+    size_t request_size;
+
+    if (client == NULL || client->socket == NULL) {
+        return 0;
+    }
+
+    while (client->rx_start < client->rx_end) {
+        request = client->rx_buffer + client->rx_start;
+        available = client->rx_end - client->rx_start;
+
+        if (request[0] != ASC_STX) {
+            client->rx_start++;
             continue;
         }
 
-        *response_cursor = MON_REGISTER_ITEM_SIZE;
-        ++response_cursor;
+        if (available < 6) {
+            return 0;
+        }
 
-        *response_cursor = regs->id;
-        ++response_cursor;
+        if (request[1] < 0x01 || request[1] > 0x02) {
+            client->rx_start += 6;
+            continue;
+        }
 
-        response_cursor = write_uint16((uint16_t)regs->val, response_cursor);
+        request_size = MON_BINARY_HEADER_SIZE + ((uint32_t)request[2] | ((uint32_t)request[3] << 8) |
+                                                 ((uint32_t)request[4] << 16) | ((uint32_t)request[5] << 24));
+
+        return (available >= request_size) ? request_size : 0;
     }
 
-    return response_cursor;
+    return 0;
 }
 
-static void monitor_binary_response_register_info(uint32_t request_id, MEMSPACE memspace)
-{
+static void monitor_binary_process_command(unsigned char * pbuffer);
+
+/*! \internal \brief Process the complete requests of a client
+
+ Stops after a request that leaves the monitor.
+*/
+static void monitor_binary_process_requests(binary_client_t *client)
+{
+    size_t request_size;
+
+    if (client == NULL) {
+        return;
+    }
+
+    /* a DISPLAY_GET waiting for a frame keeps the order of the responses */
+    while (!client->display_pending && (request_size = monitor_binary_next_request(client)) != 0) {
+        unsigned char *request = client->rx_buffer + client->rx_start;
+
+        client->rx_start += request_size;
+        current_client = client;
+        monitor_binary_process_command(request);
+        current_client = NULL;
+
+        if (exit_mon != exit_mon_no) {
+            break;
+        }
+    }
+}
+
+/* runs at the next instruction boundary, where the CPU has exported its registers */
+static void monitor_binary_observer_trap(uint16_t addr, void *data)
+{
+    binary_client_t *client;
+
+    observer_trap_pending = false;
+
+    FOR_EACH_CLIENT(client) {
+        if (!client->controller) {
+            monitor_binary_process_requests(client);
+        }
+    }
+}
+
+/*! \internal \brief Accept connections, read and write what the sockets take
+
+ A request of the controller stops the CPU, requests of observers are
+ answered at the next instruction boundary.
+*/
+static void monitor_binary_poll(void)
+{
+    binary_client_t *client;
+    bool observer_request = false;
+
+    monitor_binary_accept();
+
+    FOR_EACH_CLIENT(client) {
+        if (client->socket != NULL && monitor_binary_client_flush(client) == 0) {
+            monitor_binary_receive_available(client);
+            if (!client->controller && !client->display_pending
+                && monitor_binary_next_request(client) != 0) {
+                observer_request = true;
+            }
+        }
+    }
+
+    if (monitor_binary_next_request(controller) != 0) {
+        monitor_startup_trap();
+    } else if (observer_request && !observer_trap_pending) {
+        observer_trap_pending = true;
+        interrupt_maincpu_trigger_trap(monitor_binary_observer_trap, NULL);
+    }
+}
+
+static void monitor_binary_poll_alarm_handler(CLOCK offset, void *data)
+{
+    alarm_unset(poll_alarm);
+
+    if (listen_socket == NULL && !monitor_is_binary()) {
+        return;
+    }
+
+    /* the select() is not free, don't do it more often than needed in warp */
+    if (monitor_binary_request_pending() ||
+        tick_now_delta(poll_last_tick) >= MON_BINARY_POLL_TICKS) {
+        poll_last_tick = tick_now();
+        monitor_binary_poll();
+    }
+
+    alarm_set(poll_alarm, maincpu_clk + MON_BINARY_POLL_CYCLES);
+}
+
+static void monitor_binary_stream_delta(void);
+static void monitor_binary_display_check(void);
+
+/* runs at the next instruction boundary, where the CPU has exported its registers */
+static void monitor_binary_stream_trap(uint16_t addr, void *data)
+{
+    monitor_binary_stream_delta();
+}
+
+/* Called from the vsync hook, also (re)arms the poll alarm that picks up
+   requests between vsyncs, so a request is noticed within about
+   MON_BINARY_POLL_CYCLES instead of up to a frame later. */
+void monitor_check_binary(void)
+{
+    if (listen_socket == NULL && !monitor_is_binary()) {
+        return;
+    }
+
+    if (poll_alarm == NULL) {
+        poll_alarm = alarm_new(maincpu_alarm_context, "BinaryMonitorPoll",
+                               monitor_binary_poll_alarm_handler, NULL);
+    }
+    alarm_set(poll_alarm, maincpu_clk + MON_BINARY_POLL_CYCLES);
+
+    /* count down a RUN_FOR in frames */
+    if (run_for.active && run_for.frames > 0 && --run_for.frames == 0) {
+        monitor_startup_trap();
+    } else if (run_for.active && run_for.frames == 1) {
+        /* with NoRender, draw the frame it stops after for DISPLAY_GET */
+        vsync_request_render(1);
+    }
+
+    monitor_binary_display_check();
+
+    if (mon_stream_frame()) {
+        interrupt_maincpu_trigger_trap(monitor_binary_stream_trap, NULL);
+    }
+
+    poll_last_tick = tick_now();
+    monitor_binary_poll();
+}
+
+/*! \brief Sleep, but wake up as soon as a request arrives
+
+ Used by vsync instead of a plain sleep when it paces the emulation, so a
+ request that arrives while the emulator sleeps out the rest of a sync
+ period is handled right away instead of after the sleep. Only the
+ controller wakes it up, requests of observers wait for the next poll.
+
+ \param ticks
+   maximum time to sleep
+
+ \return
+   1 if the sleep was done here, 0 if the caller still has to sleep
+*/
+int monitor_binary_sleep(tick_t ticks)
+{
+    int ready;
+
+    if (controller == NULL || monitor_is_inside_monitor()) {
+        return 0;
+    }
+
+    mainlock_yield_begin();
+    ready = vice_network_select_wait_one(controller->socket, TICK_TO_MICRO(ticks));
+    mainlock_yield_end();
+
+    if (ready > 0) {
+        monitor_binary_poll();
+    }
+
+    return 1;
+}
+
+/*! \brief Check whether a complete request is already buffered
+
+ Used by the monitor loop to not block in select() while there is still
+ work queued from an earlier read.
+*/
+int monitor_binary_request_pending(void)
+{
+    binary_client_t *client;
+
+    FOR_EACH_CLIENT(client) {
+        if (monitor_binary_next_request(client) != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*! \brief Get the sockets the monitor loop has to wait for
+
+ \param sockets
+   receives the listening socket and the sockets of all clients, room for
+   MONITOR_BINARY_MAX_SOCKETS
+
+ \return
+   number of sockets stored
+*/
+int monitor_binary_get_sockets(vice_network_socket_t **sockets)
+{
+    binary_client_t *client;
+    int count = 0;
+
+    FOR_EACH_CLIENT(client) {
+        if (client->socket != NULL) {
+            sockets[count++] = client->socket;
+        }
+    }
+
+    /* a connection that can't be accepted would keep select() from waiting */
+    if (listen_socket != NULL && count < MONITOR_BINARY_MAX_CLIENTS) {
+        sockets[count++] = listen_socket;
+    }
+
+    return count;
+}
+
+/*! \brief Get the sockets of the clients that have output queued
+
+ While the machine is stopped the monitor loop waits for these to take
+ data as well, otherwise a large response would only move on every time
+ the wait for requests times out.
+
+ \param sockets
+   receives the sockets, room for MONITOR_BINARY_MAX_CLIENTS
+
+ \return
+   number of sockets stored
+*/
+int monitor_binary_get_pending_sockets(vice_network_socket_t **sockets)
+{
+    binary_client_t *client;
+    int count = 0;
+
+    FOR_EACH_CLIENT(client) {
+        if (client->socket != NULL && client->tx_head != client->tx_tail) {
+            sockets[count++] = client->socket;
+        }
+    }
+
+    return count;
+}
+
+
+#define MON_BINARY_API_VERSION 0x02
+
+#define MON_EVENT_ID 0xffffffff
+
+/*! \internal \brief Write uint16 to buffer and return pointer to byte after */
+static unsigned char *write_uint16(uint16_t input, unsigned char *output) {
+    output[0] = input & 0xFFu;
+    output[1] = (input >> 8) & 0xFFu;
+
+    return output + 2;
+}
+
+/*! \internal \brief Write uint32 to buffer and return pointer to byte after */
+static unsigned char *write_uint32(uint32_t input, unsigned char *output) {
+    output[0] = input & 0xFFu;
+    output[1] = (input >> 8) & 0xFFu;
+    output[2] = (input >> 16) & 0xFFu;
+    output[3] = (uint8_t)(input >> 24) & 0xFFu;
+
+    return output + 4;
+}
+
+/*! \internal \brief Write uint64 to buffer and return pointer to byte after */
+static unsigned char *write_uint64(uint64_t input, unsigned char *output) {
+    for (int i = 0 ; i < 8 ; i++) {
+        output[i] = (uint8_t)(input >> (8 * i)) & 0xFFu;
+    }
+
+    return output + 8;
+}
+
+/*! \internal \brief Write string to buffer and return pointer to byte after */
+static unsigned char *write_string(uint8_t length, unsigned char *input, unsigned char *output) {
+    output[0] = length;
+    memcpy(&output[1], input, length);
+
+    return output + length + 1;
+}
+
+/*! \internal \brief Read 32bit little endian value from buffer to uint32 value */
+static uint32_t little_endian_to_uint32(unsigned char *input) {
+    return (input[3] << 24) + (input[2] << 16) + (input[1] << 8) + input[0];
+}
+
+/*! \internal \brief Read 16bit little endian value from buffer to uint16 value */
+static uint16_t little_endian_to_uint16(unsigned char *input) {
+    return (input[1] << 8) + input[0];
+}
+
+static void monitor_binary_response_header(unsigned char *header, uint32_t length, BINARY_RESPONSE response_type,
+                                           BINARY_ERROR errorcode, uint32_t request_id)
+{
+    header[0] = ASC_STX;
+    header[1] = MON_BINARY_API_VERSION;
+    write_uint32(length, &header[2]);
+    header[6] = (uint8_t)response_type;
+    header[7] = (uint8_t)errorcode;
+    write_uint32(request_id, &header[8]);
+}
+
+static void monitor_binary_response(uint32_t length, BINARY_RESPONSE response_type, BINARY_ERROR errorcode, uint32_t request_id, unsigned char *body)
+{
+    unsigned char header[MON_BINARY_RESPONSE_HEADER_SIZE];
+    vice_network_buffer_t buffers[2];
+    unsigned int count = (body != NULL) ? 2 : 1;
+    binary_client_t *client;
+
+    monitor_binary_response_header(header, length, response_type, errorcode, request_id);
+    buffers[0].data = header;
+    buffers[0].length = sizeof header;
+    buffers[1].data = body;
+    buffers[1].length = length;
+
+    /* events go to every client */
+    if (request_id == MON_EVENT_ID) {
+        FOR_EACH_CLIENT(client) {
+            if (client->socket != NULL) {
+                monitor_binary_client_transmit(client, buffers, count, true);
+            }
+        }
+        return;
+    }
+
+    client = current_client != NULL ? current_client : controller;
+    if (client != NULL) {
+        monitor_binary_client_transmit(client, buffers, count, false);
+    }
+}
+
+/*! \internal \brief Send an event that may be merged with an earlier one
+
+ The body of such an event ends with a u32 count of the occurrences it
+ reports. While an event of the same type and key still waits unsent in
+ the output ring of a client, with nothing but such events queued after
+ it, it is updated to the new one instead, with the counts added up. A
+ client that can't keep up with, say, checkpoints hit in a tight loop so
+ gets one summary per checkpoint instead of a growing backlog.
+*/
+static void monitor_binary_event_coalesced(BINARY_RESPONSE response_type, uint32_t key, unsigned char *body, uint32_t length)
+{
+    unsigned char header[MON_BINARY_RESPONSE_HEADER_SIZE];
+    unsigned char queued_count[4];
+    vice_network_buffer_t buffers[2];
+    binary_client_t *client;
+    binary_coalesce_t *slot = NULL;
+    uint32_t count = little_endian_to_uint32(&body[length - 4]);
+    unsigned int coalesce_count;
+    unsigned int i;
+
+    monitor_binary_response_header(header, length, response_type, e_MON_ERR_OK, MON_EVENT_ID);
+    buffers[0].data = header;
+    buffers[0].length = sizeof header;
+    buffers[1].data = body;
+    buffers[1].length = length;
+
+    FOR_EACH_CLIENT(client) {
+        if (client->socket == NULL) {
+            continue;
+        }
+
+        for (i = 0; i < client->coalesce_count; i++) {
+            slot = &client->coalesce[i];
+            if (slot->type == response_type && slot->key == key && slot->length == length
+                && slot->body - sizeof header >= client->tx_tail) {
+                break;
+            }
+        }
+
+        if (i < client->coalesce_count) {
+            monitor_binary_tx_ring_read(client, slot->body + length - 4, queued_count, 4);
+            write_uint32(count + little_endian_to_uint32(queued_count), &body[length - 4]);
+            monitor_binary_tx_ring_write(client, slot->body, body, length);
+            write_uint32(count, &body[length - 4]);
+            continue;
+        }
+
+        /* queueing it forgets the events before, unless they were all
+           mergeable too */
+        coalesce_count = client->coalesce_count;
+        if (monitor_binary_client_transmit(client, buffers, 2, true) != 0) {
+            continue;
+        }
+        client->coalesce_count = coalesce_count;
+
+        if (client->tx_head - client->tx_tail < sizeof header + length) {
+            /* (partly) sent right away, nothing is queued before it */
+            client->coalesce_count = 0;
+        } else if (client->coalesce_count < MON_BINARY_COALESCE_SLOTS) {
+            slot = &client->coalesce[client->coalesce_count++];
+            slot->type = response_type;
+            slot->key = key;
+            slot->body = client->tx_head - length;
+            slot->length = length;
+        }
+    }
+}
+
+static void monitor_binary_error(BINARY_ERROR errorcode, uint32_t request_id)
+{
+    monitor_binary_response(0, 0, errorcode, request_id, NULL);
+}
+
+static void monitor_binary_response_stopped(uint32_t request_id)
+{
+    unsigned char response[2];
+    uint16_t addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+
+    write_uint16(addr, response);
+
+    monitor_binary_response(2, e_MON_RESPONSE_STOPPED, e_MON_ERR_OK, MON_EVENT_ID, response);
+}
+
+static void monitor_binary_response_resumed(uint32_t request_id)
+{
+    unsigned char response[2];
+    uint16_t addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+
+    write_uint16(addr, response);
+
+    monitor_binary_response(2, e_MON_RESPONSE_RESUMED, e_MON_ERR_OK, MON_EVENT_ID, response);
+}
+
+ui_jam_action_t monitor_binary_ui_jam_dialog(const char *format, ...)
+{
+    unsigned char response[2];
+    uint16_t addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+
+    write_uint16(addr, response);
+
+    monitor_binary_response(0, e_MON_RESPONSE_JAM, e_MON_ERR_OK, MON_EVENT_ID, response);
+
+    return UI_JAM_MONITOR;
+}
+
+static bool ignore_fake_register(mon_reg_list_t *reg)
+{
+    return reg->flags & MON_REGISTER_IS_FLAGS;
+}
+
+static MEMSPACE get_requested_memspace(uint8_t requested_memspace) {
+    if (requested_memspace == 0) {
+        return e_comp_space;
+    } else if (requested_memspace == 1) {
+        return e_disk8_space;
+    } else if (requested_memspace == 2) {
+        return e_disk9_space;
+    } else if (requested_memspace == 3) {
+        return e_disk10_space;
+    } else if (requested_memspace == 4) {
+        return e_disk11_space;
+    } else {
+        return e_invalid_space;
+    }
+}
+
+static uint8_t memspace_to_uint8_t(MEMSPACE mem) {
+    if (mem == e_comp_space) {
+        return 0;
+    } else if(mem == e_disk8_space) {
+        return 1;
+    } else if(mem == e_disk9_space) {
+        return 2;
+    } else if(mem == e_disk10_space) {
+        return 3;
+    } else if(mem == e_disk11_space) {
+        return 4;
+    } else {
+        return 0xff;
+    }
+}
+
+#define MON_REGISTER_ITEM_SIZE 3
+
+static uint16_t count_registers(mon_reg_list_t *regs) {
+    uint16_t count = 0;
+
+    for( ; regs->name ; regs++) {
+        if (!ignore_fake_register(regs)) {
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+static unsigned char *write_registers(mon_reg_list_t *regs, uint16_t count, unsigned char *response_cursor) {
+    response_cursor = write_uint16(count, response_cursor);
+
+    for( ; regs->name ; regs++) {
+        if (ignore_fake_register(regs)) {
+            continue;
+        }
+
+        *response_cursor = MON_REGISTER_ITEM_SIZE;
+        ++response_cursor;
+
+        *response_cursor = regs->id;
+        ++response_cursor;
+
+        response_cursor = write_uint16((uint16_t)regs->val, response_cursor);
+    }
+
+    return response_cursor;
+}
+
+static void monitor_binary_response_register_info(uint32_t request_id, MEMSPACE memspace)
+{
     mon_reg_list_t *regs;
     unsigned char *response;
     unsigned char *response_cursor;
@@ -505,8 +1367,76 @@ static void monitor_binary_response_register_info(uint32_t request_id, MEMSPACE
     lib_free(response);
 }
 
+/*! \internal \brief Send the response of a RUN_FOR once the CPU stopped
+
+ Takes the place of the usual REGISTER_INFO and STOPPED events.
+*/
+static void monitor_binary_response_run_for(void)
+{
+    unsigned char *response;
+    unsigned char *response_cursor;
+    uint32_t response_size = 1 + 2 + 8;
+    uint32_t screen_length = 0;
+    uint32_t memory_length = 0;
+    uint8_t reached;
+    uint16_t addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+
+    if (run_for.frames > 0) {
+        reached = 0;
+    } else {
+        reached = (run_for.stop_clk == 0 || maincpu_clk >= run_for.stop_clk) ? 1 : 0;
+    }
+    alarm_unset(run_for_alarm);
+    run_for.active = false;
+
+    if (run_for.flags & MON_RUN_FOR_WITH_SCREEN) {
+        response_size += 4 + MON_SCREEN_BINMON_GET_RESPONSE_SIZE;
+    }
+    if (run_for.flags & MON_RUN_FOR_WITH_MEMORY) {
+        memory_length = (run_for.end + 1) - run_for.start;
+        response_size += 2 + memory_length;
+    }
+
+    response = lib_malloc(response_size);
+    response_cursor = response;
+
+    *response_cursor++ = reached;
+    response_cursor = write_uint16(addr, response_cursor);
+    response_cursor = write_uint64((uint64_t)maincpu_clk, response_cursor);
+
+    if (run_for.flags & MON_RUN_FOR_WITH_SCREEN) {
+        screen_length = MON_SCREEN_BINMON_GET_RESPONSE_SIZE;
+        if (mon_screen_binmon_get(response_cursor + 4, &screen_length) != 0) {
+            screen_length = 0;
+        }
+        write_uint32(screen_length, response_cursor);
+        response_cursor += 4 + screen_length;
+    }
+
+    if (run_for.flags & MON_RUN_FOR_WITH_MEMORY) {
+        int old_sidefx = sidefx;
+
+        response_cursor = write_uint16((uint16_t)memory_length, response_cursor);
+        sidefx = 0;
+        mon_get_mem_block_ex(run_for.memspace, run_for.banknum, run_for.start,
+                             run_for.end - run_for.start, response_cursor);
+        sidefx = old_sidefx;
+        response_cursor += memory_length;
+    }
+
+    monitor_binary_response((uint32_t)(response_cursor - response), e_MON_RESPONSE_RUN_FOR,
+                            e_MON_ERR_OK, run_for.request_id, response);
+
+    lib_free(response);
+}
+
 /*! \internal \brief called when the monitor is opened */
 void monitor_binary_event_opened(void) {
+    if (run_for.active) {
+        monitor_binary_response_run_for();
+        return;
+    }
+
     /* FIXME */
     monitor_binary_response_register_info(MON_EVENT_ID, e_comp_space);
     monitor_binary_response_stopped(MON_EVENT_ID);
@@ -514,6 +1444,11 @@ void monitor_binary_event_opened(void) {
 
 /*! \internal \brief called when the monitor is closed */
 void monitor_binary_event_closed(void) {
+    /* a RUN_FOR answers once, when the CPU stops again */
+    if (run_for.active) {
+        return;
+    }
+
     monitor_binary_response_resumed(MON_EVENT_ID);
 }
 
@@ -526,7 +1461,7 @@ void monitor_binary_event_closed(void) {
  \param hit Is the checkpoint hit in the emulator?
 */
 void monitor_binary_response_checkpoint_info(uint32_t request_id, mon_checkpoint_t *checkpt, bool hit) {
-    unsigned char response[23];
+    unsigned char response[27];
     MEMORY_OP op = (MEMORY_OP)(
         (checkpt->check_store ? e_store : 0)
         | (checkpt->check_load ? e_load : 0)
@@ -547,6 +1482,13 @@ void monitor_binary_response_checkpoint_info(uint32_t request_id, mon_checkpoint
     write_uint32((uint32_t)checkpt->ignore_count, &response[17]);
     response[21] = !!checkpt->condition;
     response[22] = memspace_to_uint8_t(addr_memspace(checkpt->start_addr));
+    write_uint32(hit ? 1 : 0, &response[23]);
+
+    /* hits the client does not keep up with are merged */
+    if (request_id == MON_EVENT_ID && hit) {
+        monitor_binary_event_coalesced(e_MON_RESPONSE_CHECKPOINT_INFO, checkpt->checknum, response, sizeof response);
+        return;
+    }
 
     monitor_binary_response(sizeof (response), e_MON_RESPONSE_CHECKPOINT_INFO, e_MON_ERR_OK, request_id, response);
 }
@@ -783,173 +1725,580 @@ static void monitor_binary_process_keyboard_feed(binary_command_t *command)
         return;
     }
 
-    body[1 + length] = '\0';
+    body[1 + length] = '\0';
+
+    kbdbuf_feed((char *)&body[1]);
+
+    monitor_binary_response(0, e_MON_RESPONSE_KEYBOARD_FEED, e_MON_ERR_OK, command->request_id, NULL);
+}
+
+static void monitor_binary_process_execute_until_return(binary_command_t *command)
+{
+    mon_instruction_return();
+
+    monitor_binary_response(0, e_MON_RESPONSE_EXECUTE_UNTIL_RETURN, e_MON_ERR_OK, command->request_id, NULL);
+}
+
+static void monitor_binary_process_keymatrix_set(binary_command_t *command)
+{
+    if (mon_keymatrix_binmon_set(command->body, command->length) != 0) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+    monitor_binary_response(0, e_MON_RESPONSE_KEYMATRIX_SET, e_MON_ERR_OK,
+                            command->request_id, NULL);
+}
+
+static void monitor_binary_process_keymatrix_tap(binary_command_t *command)
+{
+    if (mon_keymatrix_binmon_tap(command->body, command->length) != 0) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+    monitor_binary_response(0, e_MON_RESPONSE_KEYMATRIX_TAP, e_MON_ERR_OK,
+                            command->request_id, NULL);
+}
+
+static void monitor_binary_process_keymatrix_get(binary_command_t *command)
+{
+    uint8_t buf[MON_KEYMATRIX_BINMON_GET_RESPONSE_SIZE];
+    uint32_t out_len = sizeof(buf);
+    if (mon_keymatrix_binmon_get(buf, &out_len) != 0) {
+        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
+        return;
+    }
+    monitor_binary_response(out_len, e_MON_RESPONSE_KEYMATRIX_GET,
+                            e_MON_ERR_OK, command->request_id, buf);
+}
+
+static void monitor_binary_process_screen_get(binary_command_t *command)
+{
+    uint8_t buf[MON_SCREEN_BINMON_GET_RESPONSE_SIZE];
+    uint32_t out_len = sizeof(buf);
+    if (mon_screen_binmon_get(buf, &out_len) != 0) {
+        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
+        return;
+    }
+    monitor_binary_response(out_len, e_MON_RESPONSE_SCREEN_GET,
+                            e_MON_ERR_OK, command->request_id, buf);
+}
+
+/*
+ * DRIVE_ATTACH (0x78)
+ *
+ * Attach a disk image at runtime, or detach one.
+ *
+ * Request body:
+ *     u8  unit        (8..11)
+ *     u8  drive       (0 or 1; second drive on dual-drive units)
+ *     u8  path_len    (0 = detach; 1..255 = attach)
+ *     u8  path[path_len]   ASCII path inside the emulator process's
+ *                          file system. NOT NUL-terminated.
+ *
+ * Response: empty body, e_MON_ERR_OK on success.
+ *
+ * Why this exists:
+ *
+ * The standard binmon RESOURCE_SET (0x52) handler in this build refuses
+ * a zero-length value, which makes a clean detach via that path
+ * impossible. Worse, file_system_attach_disk() is not bound to a
+ * VICE resource at all (it is wired up directly from the cmdline
+ * `-8 image.d64` arg), so even with a non-empty value RESOURCE_SET
+ * cannot reach it.
+ *
+ * For automation harnesses (CI tests, headless rendering pipelines,
+ * any script that drives the emulator from the outside) this is a
+ * real problem: the host-side .d64 file is only consistently flushed
+ * to disk when VICE detaches its image, and there was previously no
+ * binmon-level way to trigger that. DRIVE_ATTACH gives clients a
+ * direct attach/detach primitive — a same-path "attach" detaches the
+ * old image first (which closes any open files and writes the BAM
+ * back), so it doubles as an explicit flush.
+ */
+static void monitor_binary_process_drive_attach(binary_command_t *command)
+{
+    da_request_t req;
+
+    switch (da_decode(command->body, command->length, &req)) {
+        case DA_OK:
+            break;
+        case DA_ERR_LENGTH:
+            monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+            return;
+        case DA_ERR_PARAM:
+        default:
+            monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+            return;
+    }
+
+    if (req.detach) {
+        file_system_detach_disk(req.unit, req.drive);
+    } else if (file_system_attach_disk(req.unit, req.drive, req.path) < 0) {
+        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
+        return;
+    }
+
+    monitor_binary_response(0, e_MON_RESPONSE_DRIVE_ATTACH,
+                            e_MON_ERR_OK, command->request_id, NULL);
+}
+
+/*
+ * VIDEO_RECORD (0x79)
+ *
+ * Start or stop native VICE video recording of the emulated screen to a
+ * host-side file, using the in-tree ZMBV gfxoutput driver (lossless ZMBV
+ * inside an AVI container; depends only on zlib, no external ffmpeg).
+ *
+ * Request body:
+ *     u8  action      0 = stop recording (finalize/close the file)
+ *                     1 = start recording
+ *     u8  path_len    length of path (only used when action == 1)
+ *     u8  path[path_len]   ASCII path inside the emulator process's file
+ *                          system. NOT NUL-terminated. Should end in .avi.
+ *
+ * Response: empty body, e_MON_ERR_OK on success.
+ *
+ * Why this exists:
+ *
+ * The standard binmon protocol has no way to drive VICE's screenshot/movie
+ * recorder, and the text-monitor `screenshot` command in this headless build
+ * only exposes still-image formats. Automation harnesses that drive the
+ * emulator from the outside (CI tests, headless rendering pipelines) need a
+ * real, playable capture of gameplay rather than a stitched-together GIF.
+ *
+ * Recording is driven per emulated frame by screenshot_record() out of the
+ * machine vsync hook, and the audio comes from the emulated sample stream,
+ * so the file is in emulated time: every emulated frame is encoded, also in
+ * warp mode, and a warp-speed batch job gets a correct 50 fps clip without
+ * slowing down to real time. ZMBVFrameInterval records every Nth frame.
+ *
+ * The body parsing, the already-recording guard and the warp save/restore
+ * policy live in the revice video core (libs/video); this wiring only maps the
+ * core's result to the binmon response/error. See mon_video.h. The core turns
+ * warp off when recording starts, which was needed while warped frames were
+ * dropped; warp is turned back on here, and the core restores that same
+ * state when the recording stops.
+ */
+static void monitor_binary_process_video_record(binary_command_t *command)
+{
+    int warp = vsync_get_warp_mode();
+    int rc = mon_video_binmon_record(command->body, command->length);
+
+    if (rc == VIDEO_OK && warp && !vsync_get_warp_mode()) {
+        vsync_set_warp_mode(1);
+    }
+
+    if (rc == VIDEO_ERR_LENGTH) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+    if (rc != VIDEO_OK) {
+        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
+        return;
+    }
+
+    monitor_binary_response(0, e_MON_RESPONSE_VIDEO_RECORD,
+                            e_MON_ERR_OK, command->request_id, NULL);
+}
+
+/*
+ * COVERAGE_SET (0x7a)
+ *
+ * Enable, change or disable bitmap coverage collection for a memspace.
+ *
+ * Request body:
+ *     u8  memspace    (as for MEM_GET)
+ *     u8  flags       bit 0 = exec, bit 1 = load, bit 2 = store,
+ *                     bit 3 = saturating 8-bit exec hit counters
+ *                     (implies exec). 0 disables coverage and frees the maps.
+ *
+ * Response: u8 flags now in effect.
+ *
+ * Newly enabled maps start cleared; maps that stay enabled keep their
+ * contents. Unlike silent checkpoints, the cost per instruction is one
+ * bit-set regardless of how many addresses are being covered, see
+ * mon_coverage.c.
+ */
+static void monitor_binary_process_coverage_set(binary_command_t *command)
+{
+    uint8_t requested_memspace = command->body[0];
+    uint8_t flags = command->body[1];
+    unsigned char response[1];
+    MEMSPACE memspace;
+
+    if (command->length < 2) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+
+    memspace = get_requested_memspace(requested_memspace);
+
+    if (memspace == e_invalid_space) {
+        monitor_binary_error(e_MON_ERR_INVALID_MEMSPACE, command->request_id);
+        log_message(LOG_DEFAULT, "monitor binary coverage set: Unknown memspace %u", requested_memspace);
+        return;
+    }
+
+    if (flags & ~MON_COVERAGE_ALL) {
+        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+        return;
+    }
+
+    mon_coverage_set(memspace, flags);
+
+    response[0] = (uint8_t)mon_coverage_get_flags(memspace);
+
+    monitor_binary_response(sizeof response, e_MON_RESPONSE_COVERAGE_SET,
+                            e_MON_ERR_OK, command->request_id, response);
+}
+
+/*
+ * COVERAGE_GET (0x7b)
+ *
+ * Fetch one coverage map, optionally clearing it in the same step.
+ *
+ * Request body:
+ *     u8  memspace
+ *     u8  map         0 = exec, 1 = load, 2 = store bitmap,
+ *                     3 = exec hit counters
+ *     u8  clear       non-zero: snapshot-and-clear
+ *
+ * Response:
+ *     u8  map
+ *     u32 covered     number of addresses set in the map
+ *     u32 length      8192 for bitmaps (bit n of byte a/8 is address a),
+ *                     65536 for hit counters (one byte per address)
+ *     u8  data[length]
+ *
+ * e_MON_ERR_OBJECT_MISSING if the map is not enabled.
+ */
+static void monitor_binary_process_coverage_get(binary_command_t *command)
+{
+    uint8_t requested_memspace = command->body[0];
+    uint8_t map = command->body[1];
+    bool clear = !!command->body[2];
+    unsigned char *response;
+    unsigned char *response_cursor;
+    uint32_t response_length;
+    uint32_t map_length;
+    uint32_t covered;
+    MEMSPACE memspace;
+
+    if (command->length < 3) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+
+    memspace = get_requested_memspace(requested_memspace);
+
+    if (memspace == e_invalid_space) {
+        monitor_binary_error(e_MON_ERR_INVALID_MEMSPACE, command->request_id);
+        log_message(LOG_DEFAULT, "monitor binary coverage get: Unknown memspace %u", requested_memspace);
+        return;
+    }
+
+    if (map >= e_MON_COVERAGE_MAP_NUM) {
+        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+        return;
+    }
+
+    map_length = mon_coverage_map_size((mon_coverage_map_t)map);
+    response_length = 1 + 4 + 4 + map_length;
+    response = lib_malloc(response_length);
+    response_cursor = response;
+
+    if (mon_coverage_read(memspace, (mon_coverage_map_t)map, response + 9, clear, &covered) < 0) {
+        lib_free(response);
+        monitor_binary_error(e_MON_ERR_OBJECT_MISSING, command->request_id);
+        return;
+    }
+
+    *response_cursor = map;
+    ++response_cursor;
+    response_cursor = write_uint32(covered, response_cursor);
+    write_uint32(map_length, response_cursor);
+
+    monitor_binary_response(response_length, e_MON_RESPONSE_COVERAGE_GET,
+                            e_MON_ERR_OK, command->request_id, response);
+
+    lib_free(response);
+}
+
+/*
+ * SNAPSHOT_SAVE (0x7c)
+ *
+ * Save a snapshot into a numbered in-process slot instead of a file.
+ *
+ * Request body:
+ *     u8  slot        0-255, an existing slot is overwritten
+ *     u8  save_roms
+ *     u8  save_disks
+ *
+ * Response: u32 size of the snapshot in bytes.
+ *
+ * Why this exists: DUMP/UNDUMP write and read a file for every reset to a
+ * known state. A slot keeps its buffer, so saving over it again allocates
+ * nothing and restoring is a matter of parsing memory.
+ */
+static void monitor_binary_process_snapshot_save(binary_command_t *command)
+{
+    unsigned char *body = command->body;
+    unsigned char response[4];
+    long size;
+
+    if (command->length < 3) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+
+    size = mon_write_snapshot_slot(body[0], !!body[1], !!body[2]);
+    if (size < 0) {
+        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
+        return;
+    }
 
-    kbdbuf_feed((char *)&body[1]);
+    write_uint32((uint32_t)size, response);
 
-    monitor_binary_response(0, e_MON_RESPONSE_KEYBOARD_FEED, e_MON_ERR_OK, command->request_id, NULL);
+    monitor_binary_response(sizeof response, e_MON_RESPONSE_SNAPSHOT_SAVE,
+                            e_MON_ERR_OK, command->request_id, response);
 }
 
-static void monitor_binary_process_execute_until_return(binary_command_t *command)
+/*
+ * SNAPSHOT_LOAD (0x7d)
+ *
+ * Restore the snapshot held in a slot, see SNAPSHOT_SAVE.
+ *
+ * Request body:
+ *     u8  slot
+ *
+ * Response: u16 PC after restoring, as for UNDUMP.
+ *
+ * e_MON_ERR_OBJECT_MISSING if nothing was saved into the slot.
+ */
+static void monitor_binary_process_snapshot_load(binary_command_t *command)
 {
-    mon_instruction_return();
-
-    monitor_binary_response(0, e_MON_RESPONSE_EXECUTE_UNTIL_RETURN, e_MON_ERR_OK, command->request_id, NULL);
-}
+    unsigned char response[2];
+    uint16_t addr;
+    int result;
 
-static void monitor_binary_process_keymatrix_set(binary_command_t *command)
-{
-    if (mon_keymatrix_binmon_set(command->body, command->length) != 0) {
+    if (command->length < 1) {
         monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
         return;
     }
-    monitor_binary_response(0, e_MON_RESPONSE_KEYMATRIX_SET, e_MON_ERR_OK,
-                            command->request_id, NULL);
-}
 
-static void monitor_binary_process_keymatrix_tap(binary_command_t *command)
-{
-    if (mon_keymatrix_binmon_tap(command->body, command->length) != 0) {
-        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+    result = mon_read_snapshot_slot(command->body[0]);
+    if (result == -2) {
+        monitor_binary_error(e_MON_ERR_OBJECT_MISSING, command->request_id);
         return;
-    }
-    monitor_binary_response(0, e_MON_RESPONSE_KEYMATRIX_TAP, e_MON_ERR_OK,
-                            command->request_id, NULL);
-}
-
-static void monitor_binary_process_keymatrix_get(binary_command_t *command)
-{
-    uint8_t buf[MON_KEYMATRIX_BINMON_GET_RESPONSE_SIZE];
-    uint32_t out_len = sizeof(buf);
-    if (mon_keymatrix_binmon_get(buf, &out_len) != 0) {
+    } else if (result < 0) {
         monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
         return;
     }
-    monitor_binary_response(out_len, e_MON_RESPONSE_KEYMATRIX_GET,
-                            e_MON_ERR_OK, command->request_id, buf);
-}
 
-static void monitor_binary_process_screen_get(binary_command_t *command)
-{
-    uint8_t buf[MON_SCREEN_BINMON_GET_RESPONSE_SIZE];
-    uint32_t out_len = sizeof(buf);
-    if (mon_screen_binmon_get(buf, &out_len) != 0) {
-        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
-        return;
-    }
-    monitor_binary_response(out_len, e_MON_RESPONSE_SCREEN_GET,
-                            e_MON_ERR_OK, command->request_id, buf);
+    addr = ((uint16_t)((monitor_cpu_for_memspace[e_comp_space]->mon_register_get_val)(e_comp_space, e_PC)));
+
+    write_uint16(addr, response);
+
+    monitor_binary_response(sizeof response, e_MON_RESPONSE_SNAPSHOT_LOAD,
+                            e_MON_ERR_OK, command->request_id, response);
 }
 
 /*
- * DRIVE_ATTACH (0x78)
+ * RUN_FOR (0x7e)
  *
- * Attach a disk image at runtime, or detach one.
+ * Resume the CPU for a number of main CPU cycles or frames, then stop and
+ * answer with one response, optionally carrying the screen and a memory
+ * range as of the stop.
  *
  * Request body:
- *     u8  unit        (8..11)
- *     u8  drive       (0 or 1; second drive on dual-drive units)
- *     u8  path_len    (0 = detach; 1..255 = attach)
- *     u8  path[path_len]   ASCII path inside the emulator process's
- *                          file system. NOT NUL-terminated.
- *
- * Response: empty body, e_MON_ERR_OK on success.
+ *     u8  unit        0 = cycles, 1 = frames
+ *     u32 count       1 or more
+ *     u8  flags       bit 0: include the screen, as SCREEN_GET
+ *                     bit 1: include a memory range, as MEM_GET without
+ *                            side effects
+ *   if bit 1 of flags is set:
+ *     u16 start address
+ *     u16 end address
+ *     u8  memspace
+ *     u16 bank ID
  *
- * Why this exists:
+ * Nothing is sent right away. Once the CPU stops, the response comes with
+ * the request ID of the RUN_FOR, in place of the RESUMED, REGISTER_INFO
+ * and STOPPED events the monitor would otherwise send:
+ *     u8  1 if the count was reached, 0 if the CPU stopped early, e.g. on
+ *         a checkpoint or because another request arrived
+ *     u16 PC
+ *     u64 main CPU clock
+ *   if bit 0 of flags is set:
+ *     u32 length, then the SCREEN_GET payload
+ *   if bit 1 of flags is set:
+ *     u16 length, then the memory
  *
- * The standard binmon RESOURCE_SET (0x52) handler in this build refuses
- * a zero-length value, which makes a clean detach via that path
- * impossible. Worse, file_system_attach_disk() is not bound to a
- * VICE resource at all (it is wired up directly from the cmdline
- * `-8 image.d64` arg), so even with a non-empty value RESOURCE_SET
- * cannot reach it.
+ * Cycles are counted by an alarm, the CPU stops at the first instruction
+ * boundary at or after the count. Frames are counted at vsync, the CPU
+ * stops right after the last one.
  *
- * For automation harnesses (CI tests, headless rendering pipelines,
- * any script that drives the emulator from the outside) this is a
- * real problem: the host-side .d64 file is only consistently flushed
- * to disk when VICE detaches its image, and there was previously no
- * binmon-level way to trigger that. DRIVE_ATTACH gives clients a
- * direct attach/detach primitive — a same-path "attach" detaches the
- * old image first (which closes any open files and writes the BAM
- * back), so it doubles as an explicit flush.
+ * Why this exists: stepping a fixed amount of time used to take setting a
+ * temporary checkpoint, EXIT, waiting for the stop and then fetching the
+ * state, several round trips per step for a lockstep controller.
  */
-static void monitor_binary_process_drive_attach(binary_command_t *command)
+static void monitor_binary_run_for_alarm_handler(CLOCK offset, void *data)
 {
-    da_request_t req;
+    alarm_unset(run_for_alarm);
+    monitor_startup_trap();
+}
 
-    switch (da_decode(command->body, command->length, &req)) {
-        case DA_OK:
-            break;
-        case DA_ERR_LENGTH:
+static void monitor_binary_process_run_for(binary_command_t *command)
+{
+    unsigned char *body = command->body;
+    uint8_t unit;
+    uint32_t count;
+    uint8_t flags;
+
+    if (command->length < 6) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+
+    unit = body[0];
+    count = little_endian_to_uint32(&body[1]);
+    flags = body[5];
+
+    if ((unit != MON_RUN_FOR_UNIT_CYCLES && unit != MON_RUN_FOR_UNIT_FRAMES) || count == 0) {
+        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+        return;
+    }
+
+    if (flags & MON_RUN_FOR_WITH_MEMORY) {
+        uint16_t requested_banknum;
+
+        if (command->length < 13) {
             monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
             return;
-        case DA_ERR_PARAM:
-        default:
+        }
+
+        run_for.start = little_endian_to_uint16(&body[6]);
+        run_for.end = little_endian_to_uint16(&body[8]);
+        run_for.memspace = get_requested_memspace(body[10]);
+        requested_banknum = little_endian_to_uint16(&body[11]);
+
+        if (run_for.start > run_for.end) {
+            monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+            return;
+        }
+        if (run_for.memspace == e_invalid_space) {
+            monitor_binary_error(e_MON_ERR_INVALID_MEMSPACE, command->request_id);
+            return;
+        }
+        if (mon_banknum_validate(run_for.memspace, requested_banknum) == 0) {
             monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
             return;
+        }
+        run_for.banknum = requested_banknum;
     }
 
-    if (req.detach) {
-        file_system_detach_disk(req.unit, req.drive);
-    } else if (file_system_attach_disk(req.unit, req.drive, req.path) < 0) {
-        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
-        return;
+    if (run_for_alarm == NULL) {
+        run_for_alarm = alarm_new(maincpu_alarm_context, "BinaryMonitorRunFor",
+                                  monitor_binary_run_for_alarm_handler, NULL);
     }
 
-    monitor_binary_response(0, e_MON_RESPONSE_DRIVE_ATTACH,
-                            e_MON_ERR_OK, command->request_id, NULL);
+    run_for.request_id = command->request_id;
+    run_for.flags = flags;
+    if (unit == MON_RUN_FOR_UNIT_CYCLES) {
+        run_for.frames = 0;
+        run_for.stop_clk = maincpu_clk + count;
+        alarm_set(run_for_alarm, run_for.stop_clk);
+    } else {
+        run_for.frames = count;
+        run_for.stop_clk = 0;
+    }
+    run_for.active = true;
+
+    exit_mon = exit_mon_continue;
 }
 
 /*
- * VIDEO_RECORD (0x79)
+ * BATCH (0x7f)
  *
- * Start or stop native VICE video recording of the emulated screen to a
- * host-side file, using the in-tree ZMBV gfxoutput driver (lossless ZMBV
- * inside an AVI container; depends only on zlib, no external ffmpeg).
+ * Process several commands from one request and send all their responses
+ * with a single send().
  *
  * Request body:
- *     u8  action      0 = stop recording (finalize/close the file)
- *                     1 = start recording
- *     u8  path_len    length of path (only used when action == 1)
- *     u8  path[path_len]   ASCII path inside the emulator process's file
- *                          system. NOT NUL-terminated. Should end in .avi.
- *
- * Response: empty body, e_MON_ERR_OK on success.
- *
- * Why this exists:
+ *     u16 number of commands
+ *   then for each command:
+ *     u32 body length
+ *     u8  command type
+ *     body
  *
- * The standard binmon protocol has no way to drive VICE's screenshot/movie
- * recorder, and the text-monitor `screenshot` command in this headless build
- * only exposes still-image formats. Automation harnesses that drive the
- * emulator from the outside (CI tests, headless rendering pipelines) need a
- * real, playable capture of gameplay rather than a stitched-together GIF.
+ * Response: the responses of the commands in order, all with the request
+ * ID of the BATCH, followed by the BATCH response itself:
+ *     u16 number of commands processed
  *
- * Recording is driven per emulated frame by screenshot_record() out of the
- * machine vsync hook. screenshot_save_core() deliberately skips encoding
- * while warp mode is active (warped frames are produced far faster than a
- * playable video can represent), so starting a recording forces warp OFF and
- * stopping it restores the prior warp state. This lets a warp-booted harness
- * record a normal-speed clip and then resume warping.
+ * Processing stops after a command that resumes the CPU, such as EXIT or
+ * RUN_FOR, the rest is skipped. A truncated command is answered with
+ * e_MON_ERR_CMD_INVALID_LENGTH and a nested BATCH with
+ * e_MON_ERR_INVALID_PARAMETER, both in the BATCH response, which then
+ * still carries the number of commands processed before.
  *
- * The body parsing, the already-recording guard and the warp save/restore
- * policy live in the revice video core (libs/video); this wiring only maps the
- * core's result to the binmon response/error. See mon_video.h.
+ * Why this exists: a controller that reads several memory ranges, the
+ * registers and the keyboard matrix every step paid one request and at
+ * least one send() per query.
  */
-static void monitor_binary_process_video_record(binary_command_t *command)
+static void monitor_binary_process_batch(binary_command_t *command)
 {
-    int rc = mon_video_binmon_record(command->body, command->length);
+    unsigned char *body = command->body;
+    unsigned char response[2];
+    uint16_t count;
+    uint16_t processed = 0;
+    uint32_t offset = 2;
+    BINARY_ERROR error = e_MON_ERR_OK;
 
-    if (rc == VIDEO_ERR_LENGTH) {
+    if (command->length < 2) {
         monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
         return;
     }
-    if (rc != VIDEO_OK) {
-        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
-        return;
+
+    count = little_endian_to_uint16(&body[0]);
+
+    tx_batching = true;
+
+    while (processed < count && exit_mon == exit_mon_no) {
+        binary_command_t sub_command;
+
+        if (command->length - offset < 5) {
+            error = e_MON_ERR_CMD_INVALID_LENGTH;
+            break;
+        }
+
+        sub_command.length = little_endian_to_uint32(&body[offset]);
+        sub_command.type = body[offset + 4];
+        sub_command.body = &body[offset + 5];
+        sub_command.request_id = command->request_id;
+        sub_command.api_version = command->api_version;
+
+        if (command->length - offset - 5 < sub_command.length) {
+            error = e_MON_ERR_CMD_INVALID_LENGTH;
+            break;
+        }
+        if (sub_command.type == e_MON_CMD_BATCH) {
+            error = e_MON_ERR_INVALID_PARAMETER;
+            break;
+        }
+
+        monitor_binary_dispatch_command(&sub_command);
+
+        offset += 5 + sub_command.length;
+        processed++;
     }
 
-    monitor_binary_response(0, e_MON_RESPONSE_VIDEO_RECORD,
-                            e_MON_ERR_OK, command->request_id, NULL);
+    write_uint16(processed, response);
+    monitor_binary_response(sizeof response, e_MON_RESPONSE_BATCH, error,
+                            command->request_id, response);
+
+    tx_batching = false;
+    if (monitor_binary_client_flush(current_client) == 0) {
+        monitor_binary_client_high_water(current_client);
+    }
 }
 
 static void monitor_binary_process_autostart(binary_command_t *command)
@@ -1362,8 +2711,9 @@ static void monitor_binary_process_registers_available(binary_command_t *command
     lib_free(item_sizes);
 }
 
-static void monitor_binary_screenshot_line_data(screenshot_t *screenshot, uint8_t *data,
-                                 unsigned int line, DISPLAY_GET_MODE mode)
+/* also used by mon_shm.c, mode is a DISPLAY_GET_MODE */
+void monitor_binary_screenshot_line_data(screenshot_t *screenshot, uint8_t *data,
+                                         unsigned int line, unsigned int mode)
 {
     unsigned int i, except_right_border_width;
     uint8_t *line_base;
@@ -1408,7 +2758,8 @@ static void monitor_binary_screenshot_line_data(screenshot_t *screenshot, uint8_
     );
 }
 
-static void monitor_binary_process_display_get(binary_command_t *command)
+/*! \internal \brief Send a DISPLAY_GET response with what the draw buffer holds */
+static void monitor_binary_response_display(uint32_t request_id, uint8_t use_vic, DISPLAY_GET_MODE format)
 {
     screenshot_t screenshot;
     struct video_canvas_s *canvas;
@@ -1419,25 +2770,6 @@ static void monitor_binary_process_display_get(binary_command_t *command)
 
     uint32_t info_length = 13;
 
-    uint8_t use_vic = !!command->body[0];
-
-    DISPLAY_GET_MODE format = command->body[1];
-
-    if(command->api_version < 0x02) {
-        monitor_binary_error(e_MON_ERR_CMD_INVALID_API_VERSION, command->request_id);
-        return;
-    }
-
-    if(command->length < 2) {
-        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
-        return;
-    }
-
-    if(format != e_DISPLAY_GET_MODE_INDEXED8) {
-        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
-        return;
-    }
-
     if (machine_class == VICE_MACHINE_C128 && use_vic) {
         canvas = machine_video_canvas_get(1);
     } else {
@@ -1445,7 +2777,7 @@ static void monitor_binary_process_display_get(binary_command_t *command)
     }
 
     if(machine_screenshot(&screenshot, canvas) < 0) {
-        monitor_binary_error(e_MON_ERR_CMD_FAILURE, command->request_id);
+        monitor_binary_error(e_MON_ERR_CMD_FAILURE, request_id);
         return;
     }
 
@@ -1454,42 +2786,142 @@ static void monitor_binary_process_display_get(binary_command_t *command)
     screenshot.y_offset = screenshot.first_displayed_line;
 
     buffer_length = screenshot.debug_width * screenshot.debug_height * depth / 8;
-    response_length = 4 + info_length + buffer_length;
+    response_length = 4 + info_length + 4 + buffer_length + 4;
     response = lib_malloc(response_length);
     response_cursor = response;
 
-    /* Length of fields before display buffer */
-    response_cursor = write_uint32(info_length, response_cursor);
+    /* Length of fields before display buffer */
+    response_cursor = write_uint32(info_length, response_cursor);
+
+    /* Full width of buffer */
+    response_cursor = write_uint16(screenshot.debug_width, response_cursor);
+    /* Full height of buffer */
+    response_cursor = write_uint16(screenshot.debug_height, response_cursor);
+    /* X offset of the inner part of the screen */
+    response_cursor = write_uint16(screenshot.debug_offset_x, response_cursor);
+    /* Y offset of the inner part of the screen */
+    response_cursor = write_uint16(screenshot.debug_offset_y, response_cursor);
+    /* Width of the inner part of the screen */
+    response_cursor = write_uint16(screenshot.inner_width, response_cursor);
+    /* Height of the inner part of the screen */
+    response_cursor = write_uint16(screenshot.inner_height, response_cursor);
+    /* Bits per pixel of image */
+    *response_cursor = depth;
+    response_cursor++;
+
+    /* Length of display buffer */
+    response_cursor = write_uint32(buffer_length, response_cursor);
+
+    /* Buffer Data in requested format */
+    screenshot.convert_line = monitor_binary_screenshot_line_data;
+    for(i = 0; i < screenshot.debug_height; i++) {
+        screenshot.convert_line(&screenshot, response_cursor, i, format);
+        response_cursor += screenshot.debug_width * depth / 8;
+    }
+
+    /* Frames completed since the one in the buffer, only with NoRender not 0 */
+    response_cursor = write_uint32(vsync_get_frames_since_drawn(), response_cursor);
+
+    monitor_binary_response(response_length, e_MON_RESPONSE_DISPLAY_GET, e_MON_ERR_OK, request_id, response);
+
+    lib_free(response);
+
+    /* With NoRender keep drawing for a while, so a client polling the
+       display gets current frames. */
+    vsync_request_render(2);
+}
+
+/* runs at the next instruction boundary after a frame was drawn that an
+   observer's DISPLAY_GET waits for */
+static void monitor_binary_display_trap(uint16_t addr, void *data)
+{
+    binary_client_t *client;
+
+    display_trap_pending = false;
+
+    FOR_EACH_CLIENT(client) {
+        if (client->socket != NULL && client->display_pending) {
+            client->display_pending = false;
+            current_client = client;
+            monitor_binary_response_display(client->display_request_id, client->display_use_vic,
+                                            client->display_format);
+            current_client = NULL;
+        }
+    }
+
+    /* the requests queued behind it */
+    monitor_binary_observer_trap(addr, data);
+}
+
+/*! \internal \brief Check for DISPLAY_GET requests waiting for a drawn frame
+
+ Called at vsync. Keeps the frames drawn until the one that just ended was
+ drawn entirely, then answers from an instruction boundary.
+*/
+static void monitor_binary_display_check(void)
+{
+    binary_client_t *client;
+
+    FOR_EACH_CLIENT(client) {
+        if (client->socket != NULL && client->display_pending) {
+            break;
+        }
+    }
+    if (client == clients + MONITOR_BINARY_MAX_CLIENTS) {
+        return;
+    }
+
+    if (vsync_get_frames_since_drawn() > 0) {
+        vsync_request_render(1);
+    } else if (!display_trap_pending) {
+        display_trap_pending = true;
+        interrupt_maincpu_trigger_trap(monitor_binary_display_trap, NULL);
+    }
+}
+
+/*
+ * DISPLAY_GET (0x84)
+ *
+ * With NoRender the draw buffer holds the last frame drawn, which may be
+ * older than the last frame emulated. A DISPLAY_GET of an observer, which
+ * is answered while the machine runs, then waits until the next frame was
+ * drawn entirely; further requests of the observer wait behind it. The
+ * controller asks while the machine is stopped and gets the old frame;
+ * the u32 after the display buffer tells how many frames it is behind.
+ * A RUN_FOR of two frames or more draws the last frame it runs.
+ */
+static void monitor_binary_process_display_get(binary_command_t *command)
+{
+    uint8_t use_vic = !!command->body[0];
+
+    DISPLAY_GET_MODE format = command->body[1];
 
-    /* Full width of buffer */
-    response_cursor = write_uint16(screenshot.debug_width, response_cursor);
-    /* Full height of buffer */
-    response_cursor = write_uint16(screenshot.debug_height, response_cursor);
-    /* X offset of the inner part of the screen */
-    response_cursor = write_uint16(screenshot.debug_offset_x, response_cursor);
-    /* Y offset of the inner part of the screen */
-    response_cursor = write_uint16(screenshot.debug_offset_y, response_cursor);
-    /* Width of the inner part of the screen */
-    response_cursor = write_uint16(screenshot.inner_width, response_cursor);
-    /* Height of the inner part of the screen */
-    response_cursor = write_uint16(screenshot.inner_height, response_cursor);
-    /* Bits per pixel of image */
-    *response_cursor = depth;
-    response_cursor++;
+    if(command->api_version < 0x02) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_API_VERSION, command->request_id);
+        return;
+    }
 
-    /* Length of display buffer */
-    response_cursor = write_uint32(buffer_length, response_cursor);
+    if(command->length < 2) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
 
-    /* Buffer Data in requested format */
-    screenshot.convert_line = monitor_binary_screenshot_line_data;
-    for(i = 0; i < screenshot.debug_height; i++) {
-        screenshot.convert_line(&screenshot, response_cursor, i, format);
-        response_cursor += screenshot.debug_width * depth / 8;
+    if(format != e_DISPLAY_GET_MODE_INDEXED8) {
+        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+        return;
     }
 
-    monitor_binary_response(response_length, e_MON_RESPONSE_DISPLAY_GET, e_MON_ERR_OK, command->request_id, response);
+    if (vsync_get_frames_since_drawn() > 0 && current_client != NULL && !tx_batching
+        && !monitor_is_inside_monitor()) {
+        current_client->display_pending = true;
+        current_client->display_request_id = command->request_id;
+        current_client->display_use_vic = use_vic;
+        current_client->display_format = format;
+        vsync_request_render(1);
+        return;
+    }
 
-    lib_free(response);
+    monitor_binary_response_display(command->request_id, use_vic, format);
 }
 
 static void monitor_binary_process_palette_get(binary_command_t *command)
@@ -1630,7 +3062,7 @@ static void monitor_binary_process_cpuhistory(binary_command_t *command)
     mon_reg_list_t *reg_y = NULL;
     mon_reg_list_t *reg_sp = NULL;
     mon_reg_list_t *reg_flags = NULL;
-    mon_reg_list_t *reg_pc = NULL;
+    mon_reg_list_t *reg_pc_item = NULL;
     mon_reg_list_t *reg_lin = NULL;
     mon_reg_list_t *reg_cyc = NULL;
     int i, j;
@@ -1702,7 +3134,7 @@ static void monitor_binary_process_cpuhistory(binary_command_t *command)
             continue;
         } else if (id == e_PC) {
             set_reg = true;
-            reg_pc = reg;
+            reg_pc_item = reg;
         } else if (id == e_A) {
             set_reg = true;
             reg_a = reg;
@@ -1751,8 +3183,8 @@ static void monitor_binary_process_cpuhistory(binary_command_t *command)
         if (reg_flags != NULL) {
             reg_flags->val = current->reg_st;
         }
-        if (reg_pc != NULL) {
-            reg_pc->val = current->addr;
+        if (reg_pc_item != NULL) {
+            reg_pc_item->val = current->addr;
         }
         if (reg_lin != NULL) {
             reg_lin->val = 0xffff;
@@ -1798,6 +3230,134 @@ static void monitor_binary_process_cpuhistory(binary_command_t *command)
 }
 #endif /* FEATURE_CPUMEMHISTORY */
 
+/*
+ * STREAM_SUBSCRIBE (0x87)
+ *
+ * Have the changes to memory ranges, the screen, color RAM and registers
+ * pushed every N frames, replacing the previous subscription.
+ *
+ * Request body:
+ *     u8  memspace
+ *     u16 bank        as for MEM_GET
+ *     u8  flags       bit 0: screen RAM at the current video matrix
+ *                     bit 1: color RAM
+ *                     bit 2: registers of the memspace's CPU
+ *                     bit 3: compare the ranges in full every time, see below
+ *     u16 interval    frames between deltas, 0 ends the subscription
+ *     u8  number of ranges, up to 16
+ *   then for each range:
+ *     u16 start
+ *     u16 end         inclusive
+ *
+ * Response: u8 flags in effect. Screen and color RAM are dropped for drive
+ * memspaces and color RAM on machines without it.
+ *
+ * Then, every interval frames in which something changed, a STREAM_DELTA
+ * (0x64) event with the event request ID:
+ *     u32 frames since the subscription
+ *     u64 main CPU clock
+ *     u16 number of records
+ *   then for each record:
+ *     u8  source      0 = memory, offset is the address
+ *                     1 = screen, offset from the video matrix base
+ *                     2 = color RAM, offset from $d800
+ *                     3 = registers, two bytes per register in the order
+ *                         of REGISTERS_AVAILABLE
+ *     u16 offset
+ *     u16 length
+ *     u8  data[length]
+ *
+ * The first delta carries everything subscribed to, later ones only the
+ * bytes that changed. Changes close together share a record, so a record
+ * may include a few unchanged bytes. The subscription ends with the
+ * connection.
+ *
+ * Ranges are only re-read where the CPU stored to them, through the same
+ * trampolines as store watchpoints, and in full after a reset, a stop in
+ * the monitor or a change of the memory configuration (C64 CPU port and
+ * EXROM/GAME, C128 MMU). With bit 3 of flags they are compared in full
+ * every time instead, which also catches DMA, I/O registers, cartridge
+ * bank registers and banking on the other machines.
+ *
+ * Why this exists: a client following the machine frame by frame polled
+ * SCREEN_GET and MEM_GET every frame, mostly for bytes that had not
+ * changed.
+ */
+static void monitor_binary_process_stream_subscribe(binary_command_t *command)
+{
+    unsigned char *body = command->body;
+    uint16_t starts[MON_STREAM_MAX_RANGES];
+    uint16_t ends[MON_STREAM_MAX_RANGES];
+    unsigned char response[1];
+    uint16_t requested_banknum;
+    uint16_t interval;
+    uint8_t flags;
+    uint8_t count;
+    unsigned int i;
+    MEMSPACE memspace;
+
+    if (command->length < 7) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+
+    memspace = get_requested_memspace(body[0]);
+    requested_banknum = little_endian_to_uint16(&body[1]);
+    flags = body[3];
+    interval = little_endian_to_uint16(&body[4]);
+    count = body[6];
+
+    if (command->length < 7 + 4 * (uint32_t)count) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_LENGTH, command->request_id);
+        return;
+    }
+
+    if (memspace == e_invalid_space) {
+        monitor_binary_error(e_MON_ERR_INVALID_MEMSPACE, command->request_id);
+        log_message(LOG_DEFAULT, "monitor binary stream subscribe: Unknown memspace %u", body[0]);
+        return;
+    }
+
+    if (mon_banknum_validate(memspace, requested_banknum) == 0) {
+        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+        log_message(LOG_DEFAULT, "monitor binary stream subscribe: Unknown bank %u", requested_banknum);
+        return;
+    }
+
+    if (count > MON_STREAM_MAX_RANGES) {
+        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        starts[i] = little_endian_to_uint16(&body[7 + 4 * i]);
+        ends[i] = little_endian_to_uint16(&body[9 + 4 * i]);
+    }
+
+    if (mon_stream_subscribe(memspace, requested_banknum, flags, interval, starts, ends, count) < 0) {
+        monitor_binary_error(e_MON_ERR_INVALID_PARAMETER, command->request_id);
+        return;
+    }
+
+    response[0] = (uint8_t)mon_stream_get_flags();
+
+    monitor_binary_response(sizeof response, e_MON_RESPONSE_STREAM_SUBSCRIBE,
+                            e_MON_ERR_OK, command->request_id, response);
+}
+
+/*! \internal \brief Send a STREAM_DELTA event if anything subscribed to changed */
+static void monitor_binary_stream_delta(void)
+{
+    uint8_t *body;
+    uint32_t length;
+
+    length = mon_stream_delta(&body);
+    if (length > 0) {
+        monitor_binary_response(length, e_MON_RESPONSE_STREAM_DELTA, e_MON_ERR_OK,
+                                MON_EVENT_ID, body);
+    }
+}
+
 static void monitor_binary_process_mem_get(binary_command_t *command)
 {
     unsigned char *response;
@@ -1928,131 +3488,197 @@ static void monitor_binary_process_mem_set(binary_command_t *command)
 }
 
 
-static void monitor_binary_process_command(unsigned char * pbuffer)
-{
-    BINARY_COMMAND command_type;
-    binary_command_t command;
-
-    command.api_version = (uint8_t)pbuffer[1];
-
-    command.request_id = little_endian_to_uint32(&pbuffer[6]);
+/*! \internal \brief Check whether an observer may send a command
 
-    if ((command.api_version < 0x01) || (command.api_version > 0x02)) {
-        monitor_binary_error(e_MON_ERR_CMD_INVALID_API_VERSION, command.request_id);
-        return;
+ Observers may only read state, and only without side effects: MEM_GET
+ must not read I/O with side effects and COVERAGE_GET must not clear the
+ map. Commands of a BATCH are checked one by one.
+*/
+static bool monitor_binary_command_is_read_only(binary_command_t *command)
+{
+    switch (command->type) {
+        case e_MON_CMD_PING:
+        case e_MON_CMD_CHECKPOINT_GET:
+        case e_MON_CMD_CHECKPOINT_LIST:
+        case e_MON_CMD_REGISTERS_GET:
+        case e_MON_CMD_RESOURCE_GET:
+        case e_MON_CMD_KEYMATRIX_GET:
+        case e_MON_CMD_SCREEN_GET:
+        case e_MON_CMD_BATCH:
+        case e_MON_CMD_BANKS_AVAILABLE:
+        case e_MON_CMD_REGISTERS_AVAILABLE:
+        case e_MON_CMD_DISPLAY_GET:
+        case e_MON_CMD_VICE_INFO:
+        case e_MON_CMD_CPUHISTORY_GET:
+        case e_MON_CMD_PALETTE_GET:
+            return true;
+        case e_MON_CMD_MEM_GET:
+            return command->length < 1 || command->body[0] == 0;
+        case e_MON_CMD_COVERAGE_GET:
+            return command->length < 3 || command->body[2] == 0;
+        default:
+            return false;
     }
+}
 
-    /* Ensure drive CPU emulation is up to date with main cpu CLOCK. */
-    drive_cpu_execute_all(maincpu_clk);
-
-    command.length = little_endian_to_uint32(&pbuffer[2]);
+/*! \internal \brief Run the handler for a command
 
-    command.type = pbuffer[10];
-    command.body = &pbuffer[11];
+ Handlers terminate strings in the body in place, which can overwrite the
+ byte right after the body, where the next buffered request or the next
+ command of a BATCH starts. That byte is restored afterwards.
+*/
+static void monitor_binary_dispatch_command(binary_command_t *command)
+{
+    BINARY_COMMAND command_type = command->type;
+    unsigned char byte_after_body = command->body[command->length];
 
-    command_type = command.type;
     DBG(("monitor_binary_process_command type:%02x", command_type));
-    if (command_type == e_MON_CMD_PING) {
-        monitor_binary_process_ping(&command);
+    if (current_client != NULL && !current_client->controller
+        && !monitor_binary_command_is_read_only(command)) {
+        monitor_binary_error(e_MON_ERR_NOT_CONTROLLER, command->request_id);
+
+    } else if (command_type == e_MON_CMD_PING) {
+        monitor_binary_process_ping(command);
 
     } else if (command_type == e_MON_CMD_MEM_GET) {
-        monitor_binary_process_mem_get(&command);
+        monitor_binary_process_mem_get(command);
     } else if (command_type == e_MON_CMD_MEM_SET) {
-        monitor_binary_process_mem_set(&command);
+        monitor_binary_process_mem_set(command);
 
     } else if (command_type == e_MON_CMD_CHECKPOINT_GET) {
-        monitor_binary_process_checkpoint_get(&command);
+        monitor_binary_process_checkpoint_get(command);
     } else if (command_type == e_MON_CMD_CHECKPOINT_SET) {
-        monitor_binary_process_checkpoint_set(&command);
+        monitor_binary_process_checkpoint_set(command);
     } else if (command_type == e_MON_CMD_CHECKPOINT_DELETE) {
-        monitor_binary_process_checkpoint_delete(&command);
+        monitor_binary_process_checkpoint_delete(command);
     } else if (command_type == e_MON_CMD_CHECKPOINT_LIST) {
-        monitor_binary_process_checkpoint_list(&command);
+        monitor_binary_process_checkpoint_list(command);
     } else if (command_type == e_MON_CMD_CHECKPOINT_TOGGLE) {
-        monitor_binary_process_checkpoint_toggle(&command);
+        monitor_binary_process_checkpoint_toggle(command);
 
     } else if (command_type == e_MON_CMD_CONDITION_SET) {
-        monitor_binary_process_condition_set(&command);
+        monitor_binary_process_condition_set(command);
 
     } else if (command_type == e_MON_CMD_REGISTERS_GET) {
-        monitor_binary_process_registers_get(&command);
+        monitor_binary_process_registers_get(command);
     } else if (command_type == e_MON_CMD_REGISTERS_SET) {
-        monitor_binary_process_registers_set(&command);
+        monitor_binary_process_registers_set(command);
 
     } else if (command_type == e_MON_CMD_DUMP) {
-        monitor_binary_process_dump(&command);
+        monitor_binary_process_dump(command);
     } else if (command_type == e_MON_CMD_UNDUMP) {
-        monitor_binary_process_undump(&command);
+        monitor_binary_process_undump(command);
 
     } else if (command_type == e_MON_CMD_RESOURCE_GET) {
-        monitor_binary_process_resource_get(&command);
+        monitor_binary_process_resource_get(command);
     } else if (command_type == e_MON_CMD_RESOURCE_SET) {
-        monitor_binary_process_resource_set(&command);
+        monitor_binary_process_resource_set(command);
 
     } else if (command_type == e_MON_CMD_ADVANCE_INSTRUCTIONS) {
-        monitor_binary_process_advance_instructions(&command);
+        monitor_binary_process_advance_instructions(command);
     } else if (command_type == e_MON_CMD_KEYBOARD_FEED) {
-        monitor_binary_process_keyboard_feed(&command);
+        monitor_binary_process_keyboard_feed(command);
     } else if (command_type == e_MON_CMD_EXECUTE_UNTIL_RETURN) {
-        monitor_binary_process_execute_until_return(&command);
+        monitor_binary_process_execute_until_return(command);
 
     } else if (command_type == e_MON_CMD_KEYMATRIX_SET) {
-        monitor_binary_process_keymatrix_set(&command);
+        monitor_binary_process_keymatrix_set(command);
     } else if (command_type == e_MON_CMD_KEYMATRIX_TAP) {
-        monitor_binary_process_keymatrix_tap(&command);
+        monitor_binary_process_keymatrix_tap(command);
     } else if (command_type == e_MON_CMD_KEYMATRIX_GET) {
-        monitor_binary_process_keymatrix_get(&command);
+        monitor_binary_process_keymatrix_get(command);
     } else if (command_type == e_MON_CMD_SCREEN_GET) {
-        monitor_binary_process_screen_get(&command);
+        monitor_binary_process_screen_get(command);
     } else if (command_type == e_MON_CMD_DRIVE_ATTACH) {
-        monitor_binary_process_drive_attach(&command);
+        monitor_binary_process_drive_attach(command);
     } else if (command_type == e_MON_CMD_VIDEO_RECORD) {
-        monitor_binary_process_video_record(&command);
+        monitor_binary_process_video_record(command);
+    } else if (command_type == e_MON_CMD_COVERAGE_SET) {
+        monitor_binary_process_coverage_set(command);
+    } else if (command_type == e_MON_CMD_COVERAGE_GET) {
+        monitor_binary_process_coverage_get(command);
+    } else if (command_type == e_MON_CMD_SNAPSHOT_SAVE) {
+        monitor_binary_process_snapshot_save(command);
+    } else if (command_type == e_MON_CMD_SNAPSHOT_LOAD) {
+        monitor_binary_process_snapshot_load(command);
+    } else if (command_type == e_MON_CMD_RUN_FOR) {
+        monitor_binary_process_run_for(command);
+    } else if (command_type == e_MON_CMD_BATCH) {
+        monitor_binary_process_batch(command);
 
     } else if (command_type == e_MON_CMD_PALETTE_GET) {
-        monitor_binary_process_palette_get(&command);
+        monitor_binary_process_palette_get(command);
 
     } else if (command_type == e_MON_CMD_JOYPORT_SET) {
-        monitor_binary_process_joyport_set(&command);
+        monitor_binary_process_joyport_set(command);
 
     } else if (command_type == e_MON_CMD_USERPORT_SET) {
-        monitor_binary_process_userport_set(&command);
+        monitor_binary_process_userport_set(command);
 
     } else if (command_type == e_MON_CMD_BANKS_AVAILABLE) {
-        monitor_binary_process_banks_available(&command);
+        monitor_binary_process_banks_available(command);
     } else if (command_type == e_MON_CMD_REGISTERS_AVAILABLE) {
-        monitor_binary_process_registers_available(&command);
+        monitor_binary_process_registers_available(command);
     } else if (command_type == e_MON_CMD_DISPLAY_GET) {
-        monitor_binary_process_display_get(&command);
+        monitor_binary_process_display_get(command);
     } else if (command_type == e_MON_CMD_VICE_INFO) {
-        monitor_binary_process_vice_info(&command);
+        monitor_binary_process_vice_info(command);
     } else if (command_type == e_MON_CMD_CPUHISTORY_GET) {
-        monitor_binary_process_cpuhistory(&command);
+        monitor_binary_process_cpuhistory(command);
+    } else if (command_type == e_MON_CMD_STREAM_SUBSCRIBE) {
+        monitor_binary_process_stream_subscribe(command);
 
     } else if (command_type == e_MON_CMD_EXIT) {
-        monitor_binary_process_exit(&command);
+        monitor_binary_process_exit(command);
     } else if (command_type == e_MON_CMD_QUIT) {
-        monitor_binary_process_quit(&command);
+        monitor_binary_process_quit(command);
     } else if (command_type == e_MON_CMD_RESET) {
-        monitor_binary_process_reset(&command);
+        monitor_binary_process_reset(command);
     } else if (command_type == e_MON_CMD_AUTOSTART) {
-        monitor_binary_process_autostart(&command);
+        monitor_binary_process_autostart(command);
 
     } else {
-        monitor_binary_error(e_MON_ERR_CMD_INVALID_TYPE, command.request_id);
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_TYPE, command->request_id);
         log_message(LOG_DEFAULT,
                 "monitor_network binary command: unknown command %u, "
                 "skipping command length of %u",
-                command.type, command.length);
+                command->type, command->length);
+    }
+
+
+    command->body[command->length] = byte_after_body;
+}
+
+static void monitor_binary_process_command(unsigned char * pbuffer)
+{
+    binary_command_t command;
+
+    command.api_version = (uint8_t)pbuffer[1];
+
+    command.request_id = little_endian_to_uint32(&pbuffer[6]);
+
+    if ((command.api_version < 0x01) || (command.api_version > 0x02)) {
+        monitor_binary_error(e_MON_ERR_CMD_INVALID_API_VERSION, command.request_id);
+        return;
     }
 
+    /* Ensure drive CPU emulation is up to date with main cpu CLOCK. */
+    drive_cpu_execute_all(maincpu_clk);
+
+    command.length = little_endian_to_uint32(&pbuffer[2]);
+
+    command.type = pbuffer[10];
+    command.body = &pbuffer[11];
+
+    monitor_binary_dispatch_command(&command);
+
     pbuffer[0] = 0;
 }
 
 static int monitor_binary_activate(void)
 {
     vice_network_socket_address_t * server_addr = NULL;
-    int error = 1;
+    int error = -1;
 
     do {
         if (!monitor_binary_server_address) {
@@ -2064,6 +3690,26 @@ static int monitor_binary_activate(void)
             break;
         }
 
+#ifdef HAVE_UNIX_DOMAIN_SOCKETS
+        /* a socket file left behind by an instance that died would make
+           bind() fail, one that a running instance listens on is not ours
+           to take */
+        if (strncmp(monitor_binary_server_address, "unix://", 7) == 0) {
+            const char *path = monitor_binary_server_address + 7;
+            struct stat st;
+
+            if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+                if (vice_network_server_is_listening(server_addr) == 0) {
+                    archdep_remove(path);
+                } else {
+                    log_error(LOG_DEFAULT,
+                        "monitor_binary_activate(): %s is in use", monitor_binary_server_address);
+                    break;
+                }
+            }
+        }
+#endif
+
         listen_socket = vice_network_server(server_addr);
         if (!listen_socket) {
             log_error(LOG_DEFAULT,
@@ -2071,6 +3717,12 @@ static int monitor_binary_activate(void)
             break;
         }
 
+#ifdef HAVE_UNIX_DOMAIN_SOCKETS
+        if (strncmp(monitor_binary_server_address, "unix://", 7) == 0) {
+            util_string_set(&listen_path, monitor_binary_server_address + 7);
+        }
+#endif
+
         error = 0;
     } while (0);
 
@@ -2081,80 +3733,45 @@ static int monitor_binary_activate(void)
     return error;
 }
 
-int monitor_binary_get_command_line(void)
-{
-    static size_t buffer_size = 0;
-    static unsigned char *buffer;
+/*! \brief Process the requests that arrived while the monitor is stopped
 
-    while (monitor_binary_data_available()) {
-        uint32_t body_length;
-        uint8_t api_version;
-        unsigned int remaining_header_size = 5;
-        unsigned int command_size;
-        ssize_t n;
+ Requests of observers are answered first, then those of the controller.
 
-        if (!buffer) {
-            buffer = lib_malloc(300);
-            buffer_size = 300;
-        }
+ \return
+   0 if the monitor has to be left, else 1
+*/
+int monitor_binary_get_command_line(void)
+{
+    binary_client_t *client;
 
-        n = monitor_binary_receive(buffer, 1);
-        if (n == 0) {
-            monitor_binary_quit();
-            return 0;
-        } else if (n < 0) {
-            monitor_binary_quit();
-            return 0;
-        }
+    monitor_binary_accept();
 
-        if (buffer[0] != ASC_STX) {
-            continue;
+    FOR_EACH_CLIENT(client) {
+        if (client->socket != NULL && monitor_binary_client_flush(client) == 0) {
+            monitor_binary_receive_available(client);
         }
+    }
 
-        n = 0;
-
-        while (n < sizeof(api_version) + sizeof(body_length)) {
-            ssize_t o = monitor_binary_receive(&buffer[1 + n], (sizeof(api_version) + sizeof(body_length)) - n);
-            if (o <= 0) {
-                monitor_binary_quit();
+    /* process every complete request that is buffered, a partial one stays
+       in the buffer until the rest of it arrives */
+    FOR_EACH_CLIENT(client) {
+        if (!client->controller) {
+            monitor_binary_process_requests(client);
+            if (exit_mon != exit_mon_no) {
                 return 0;
             }
-
-            n += o;
-        }
-
-        api_version = buffer[1];
-        body_length = little_endian_to_uint32(&buffer[2]);
-
-        if (api_version >= 0x01 && api_version <= 0x02) {
-            remaining_header_size = 5;
-        } else {
-            continue;
-        }
-
-        command_size = sizeof(api_version) + sizeof(body_length) + remaining_header_size + body_length + 1;
-        if (!buffer || buffer_size < command_size + 1) {
-            buffer = lib_realloc(buffer, command_size + 1);
-            buffer_size = command_size + 1;
         }
+    }
 
-        n = 0;
-
-        while (n < remaining_header_size + body_length) {
-            ssize_t o = monitor_binary_receive(&buffer[6 + n], remaining_header_size + body_length - n);
-            if (o <= 0) {
-                monitor_binary_quit();
-                return 0;
-            }
-
-            n += o;
-        }
+    monitor_binary_process_requests(controller);
 
-        monitor_binary_process_command(buffer);
+    if (exit_mon != exit_mon_no) {
+        return 0;
+    }
 
-        if (exit_mon != exit_mon_no) {
-            return 0;
-        }
+    /* observers can't resume the machine, don't wait for them */
+    if (controller == NULL) {
+        return 0;
     }
 
     return 1;
@@ -2167,6 +3784,12 @@ static int monitor_binary_deactivate(void)
         listen_socket = NULL;
     }
 
+    if (listen_path != NULL) {
+        archdep_remove(listen_path);
+        lib_free(listen_path);
+        listen_path = NULL;
+    }
+
     return 0;
 }
 
@@ -2237,10 +3860,89 @@ static int set_binary_server_address(const char *name, void *param)
     return 0;
 }
 
+/*! \internal \brief set the name of the shared memory frame export
+
+ \param name
+   POSIX shared memory object name, empty to stop the export.
+
+ \param param
+   unused
+
+ \return
+   0 on success, else -1.
+*/
+static int set_binary_monitor_shm(const char *name, void *param)
+{
+    if (monitor_binary_shm_name != NULL && name != NULL
+        && strcmp(name, monitor_binary_shm_name) == 0) {
+        return 0;
+    }
+
+    if (name != NULL && *name != '\0') {
+        if (mon_shm_open(name) < 0) {
+            return -1;
+        }
+    } else {
+        mon_shm_close();
+    }
+    util_string_set(&monitor_binary_shm_name, name);
+
+    return 0;
+}
+
+/*! \internal \brief set how many bytes of output may wait for a client
+
+ \param val
+   high-water mark in bytes, at least 64KiB
+
+ \param param
+   unused
+
+ \return
+   0 on success, else -1.
+*/
+static int set_binary_monitor_high_water(int val, void *param)
+{
+    if (val < 0x10000) {
+        return -1;
+    }
+
+    monitor_binary_high_water = val;
+    return 0;
+}
+
+/*! \internal \brief set what to do with a client above the high-water mark
+
+ \param val
+   0: block until the client reads, 1: drop events, 2: disconnect
+
+ \param param
+   unused
+
+ \return
+   0 on success, else -1.
+*/
+static int set_binary_monitor_high_water_policy(int val, void *param)
+{
+    switch (val) {
+        case MON_BINARY_HIGH_WATER_BLOCK:
+        case MON_BINARY_HIGH_WATER_DROP:
+        case MON_BINARY_HIGH_WATER_DISCONNECT:
+            break;
+        default:
+            return -1;
+    }
+
+    monitor_binary_high_water_policy = val;
+    return 0;
+}
+
 /*! \brief string resources used by the binary monitor module */
 static const resource_string_t resources_string[] = {
     { "BinaryMonitorServerAddress", "ip4://127.0.0.1:6502", RES_EVENT_NO, NULL,
       &monitor_binary_server_address, set_binary_server_address, NULL },
+    { "BinaryMonitorShm", "", RES_EVENT_NO, NULL,
+      &monitor_binary_shm_name, set_binary_monitor_shm, NULL },
     RESOURCE_STRING_LIST_END
 };
 
@@ -2248,6 +3950,10 @@ static const resource_string_t resources_string[] = {
 static const resource_int_t resources_int[] = {
     { "BinaryMonitorServer", 0, RES_EVENT_STRICT, (resource_value_t)0,
       &monitor_binary_enabled, set_binary_monitor_enabled, NULL },
+    { "BinaryMonitorHighWater", 4 * 1024 * 1024, RES_EVENT_NO, NULL,
+      &monitor_binary_high_water, set_binary_monitor_high_water, NULL },
+    { "BinaryMonitorHighWaterPolicy", MON_BINARY_HIGH_WATER_BLOCK, RES_EVENT_NO, NULL,
+      &monitor_binary_high_water_policy, set_binary_monitor_high_water_policy, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -2270,9 +3976,23 @@ int monitor_binary_resources_init(void)
 /*! \brief uninitialize the network monitor resources */
 void monitor_binary_resources_shutdown(void)
 {
+    binary_client_t *client;
+
     monitor_binary_deactivate();
     monitor_binary_quit();
 
+    FOR_EACH_CLIENT(client) {
+        lib_free(client->rx_buffer);
+        client->rx_buffer = NULL;
+        client->rx_size = 0;
+        lib_free(client->tx_buffer);
+        client->tx_buffer = NULL;
+        client->tx_size = 0;
+    }
+
+    mon_shm_close();
+    lib_free(monitor_binary_shm_name);
+
     lib_free(monitor_binary_server_address);
 }
 
@@ -2289,6 +4009,15 @@ static const cmdline_option_t cmdline_options[] =
     { "-binarymonitoraddress", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "BinaryMonitorServerAddress", NULL,
       "<Name>", "The local address the binary monitor should bind to" },
+    { "-binarymonitorshm", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "BinaryMonitorShm", NULL,
+      "<Name>", "Publish display, RAM and registers at every frame in this POSIX shared memory object" },
+    { "-binarymonitorhighwater", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "BinaryMonitorHighWater", NULL,
+      "<Bytes>", "How much output may wait for a binary monitor client before -binarymonitorhighwaterpolicy applies" },
+    { "-binarymonitorhighwaterpolicy", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "BinaryMonitorHighWaterPolicy", NULL,
+      "<Policy>", "What to do with a binary monitor client above the high-water mark: (0: Block until it reads, 1: Drop events, 2: Disconnect)" },
     CMDLINE_LIST_END
 };
 
@@ -2306,11 +4035,15 @@ int monitor_binary_cmdline_options_init(void)
 
 int monitor_is_binary(void)
 {
-    return connected_socket != NULL;
-}
+    binary_client_t *client;
 
-vice_network_socket_t *monitor_binary_get_connected_socket(void) {
-    return connected_socket;
+    FOR_EACH_CLIENT(client) {
+        if (client->socket != NULL) {
+            return 1;
+        }
+    }
+
+    return 0;
 }
 
 #else
@@ -2343,6 +4076,16 @@ int monitor_binary_get_command_line(void)
     return 0;
 }
 
+int monitor_binary_request_pending(void)
+{
+    return 0;
+}
+
+int monitor_binary_sleep(tick_t ticks)
+{
+    return 0;
+}
+
 int monitor_is_binary(void)
 {
     return 0;
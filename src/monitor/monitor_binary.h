@@ -29,6 +29,7 @@
 #ifndef VICE_MONITOR_BINARY_H
 #define VICE_MONITOR_BINARY_H
 
+#include "archdep.h"
 #include "types.h"
 #include "uiapi.h"
 #include "mon_breakpoint.h"
@@ -44,12 +45,24 @@ void monitor_binary_event_closed(void);
 
 void monitor_check_binary(void);
 
-ssize_t monitor_binary_receive(unsigned char *buffer, size_t buffer_length);
 int monitor_binary_transmit(const unsigned char *buffer, size_t buffer_length);
 int monitor_binary_get_command_line(void);
+int monitor_binary_request_pending(void);
+int monitor_binary_sleep(tick_t ticks);
+
+/* one controller and observers, see BinaryMonitorServerAddress */
+#define MONITOR_BINARY_MAX_CLIENTS  8
+
+/* the listening socket and those of the clients */
+#define MONITOR_BINARY_MAX_SOCKETS  (MONITOR_BINARY_MAX_CLIENTS + 1)
 
 int monitor_is_binary(void);
-vice_network_socket_t *monitor_binary_get_connected_socket(void);
+int monitor_binary_get_sockets(vice_network_socket_t **sockets);
+int monitor_binary_get_pending_sockets(vice_network_socket_t **sockets);
+
+struct screenshot_s;
+void monitor_binary_screenshot_line_data(struct screenshot_s *screenshot, uint8_t *data,
+                                         unsigned int line, unsigned int mode);
 
 ui_jam_action_t monitor_binary_ui_jam_dialog(const char *format, ...) VICE_ATTR_PRINTF;
 
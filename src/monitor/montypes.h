@@ -309,6 +309,11 @@ void mon_delete_conditional(cond_node_t *cnode);
 int mon_evaluate_conditional(cond_node_t *cnode);
 int mon_write_snapshot(const char* name, int save_roms, int save_disks, int even_mode);
 int mon_read_snapshot(const char* name, int even_mode);
+
+#define MON_SNAPSHOT_SLOTS 256
+long mon_write_snapshot_slot(unsigned int slot, int save_roms, int save_disks);
+int mon_read_snapshot_slot(unsigned int slot);
+void mon_free_snapshot_slots(void);
 bool mon_is_valid_addr(MON_ADDR a);
 bool mon_is_in_range(MON_ADDR start_addr, MON_ADDR end_addr, unsigned loc);
 void mon_print_bin(int val, char on, char off);
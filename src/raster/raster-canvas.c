@@ -107,7 +107,7 @@ inline static void refresh_canvas(raster_t *raster)
 
 void raster_canvas_handle_end_of_frame(raster_t *raster)
 {
-    if (video_disabled_mode) {
+    if (video_disabled_mode || !vsync_render_this_frame) {
         return;
     }
 
@@ -42,6 +42,7 @@
 #include "raster-sprite.h"
 #include "raster.h"
 #include "viewport.h"
+#include "vsync.h"
 
 
 unsigned int raster_line_get_real_mode(raster_t *raster)
@@ -660,11 +661,14 @@ void raster_line_emulate(raster_t *raster)
         raster->blank_enabled = 1;
     }
 
-    if ((raster->current_line >= raster->geometry->first_displayed_line
-         && raster->current_line <= raster->geometry->last_displayed_line)
-        /* handle the case when lines 0+ are displayed in the lower border */
-        || (raster->current_line <= raster->geometry->last_displayed_line - raster->geometry->screen_size.height
-            && raster->geometry->screen_size.height <= raster->geometry->last_displayed_line)
+    /* in frames that are not drawn every line is handled like an invisible
+       one, which still keeps the sprite collisions and raster changes */
+    if (vsync_render_this_frame
+        && ((raster->current_line >= raster->geometry->first_displayed_line
+             && raster->current_line <= raster->geometry->last_displayed_line)
+            /* handle the case when lines 0+ are displayed in the lower border */
+            || (raster->current_line <= raster->geometry->last_displayed_line - raster->geometry->screen_size.height
+                && raster->geometry->screen_size.height <= raster->geometry->last_displayed_line))
         ) {
         /* handle lines with no border or with changes that may affect
            the border as visible lines */
@@ -0,0 +1,175 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#define RESID_CONVOLVE_CC
+
+#include "convolve.h"
+#include <string.h>
+
+// The SIMD kernels are compiled for their instruction set with function
+// attributes and only called after checking the CPU at runtime, so the rest
+// of reSID can be built for any x86.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESID_CONVOLVE_X86 1
+#include <immintrin.h>
+#else
+#define RESID_CONVOLVE_X86 0
+#endif
+
+namespace reSID
+{
+
+static int convolve_scalar(const short* a, const short* b, int n)
+{
+  int out = 0;
+  for (int i = 0; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+
+#if RESID_CONVOLVE_X86
+// pmaddwd multiplies 16 bit pairs and adds adjacent products into 32 bits.
+// This only overflows for -32768*-32768 + -32768*-32768, which the FIR
+// tables can't hold, and the 32 bit sums wrap like the scalar loop.
+__attribute__((target("sse2")))
+static int convolve_sse2(const short* a, const short* b, int n)
+{
+  __m128i acc = _mm_setzero_si128();
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+  }
+
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  int out = _mm_cvtsi128_si32(acc);
+
+  for (; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+
+__attribute__((target("avx2")))
+static int convolve_avx2(const short* a, const short* b, int n)
+{
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  int i = 0;
+
+  // Two accumulators to hide the latency of the adds.
+  for (; i + 32 <= n; i += 32) {
+    __m256i va0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    __m256i va1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 16));
+    __m256i vb1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 16));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(va0, vb0));
+    acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(va1, vb1));
+  }
+  if (i + 16 <= n) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(va, vb));
+    i += 16;
+  }
+  acc0 = _mm256_add_epi32(acc0, acc1);
+
+  __m128i acc = _mm_add_epi32(_mm256_castsi256_si128(acc0),
+                              _mm256_extracti128_si256(acc0, 1));
+  if (i + 8 <= n) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    acc = _mm_add_epi32(acc, _mm_madd_epi16(va, vb));
+    i += 8;
+  }
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+  acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+  int out = _mm_cvtsi128_si32(acc);
+
+  for (; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+#endif
+
+typedef int (*convolve_func)(const short* a, const short* b, int n);
+
+static const struct {
+  const char* name;
+  convolve_func func;
+} kernels[] = {
+  // Fastest first.
+#if RESID_CONVOLVE_X86
+  { "avx2", convolve_avx2 },
+  { "sse2", convolve_sse2 },
+#endif
+  { "scalar", convolve_scalar }
+};
+
+static const int n_kernels = sizeof(kernels)/sizeof(kernels[0]);
+
+static bool kernel_supported(int k)
+{
+#if RESID_CONVOLVE_X86
+  __builtin_cpu_init();
+  if (kernels[k].func == convolve_avx2) {
+    return __builtin_cpu_supports("avx2");
+  }
+  if (kernels[k].func == convolve_sse2) {
+    return __builtin_cpu_supports("sse2");
+  }
+#endif
+  return true;
+}
+
+int (*convolve)(const short* a, const short* b, int n) = convolve_scalar;
+
+static const char* convolve_name = "scalar";
+
+const char* convolve_kernel()
+{
+  return convolve_name;
+}
+
+bool set_convolve_kernel(const char* name)
+{
+  for (int k = 0; k < n_kernels; k++) {
+    if (name && strcmp(name, kernels[k].name)) {
+      continue;
+    }
+    if (kernel_supported(k)) {
+      convolve = kernels[k].func;
+      convolve_name = kernels[k].name;
+      return true;
+    }
+    if (name) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Pick the fastest kernel before main() runs.
+static const bool convolve_selected = set_convolve_kernel(0);
+
+} // namespace reSID
@@ -0,0 +1,39 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#ifndef RESID_CONVOLVE_H
+#define RESID_CONVOLVE_H
+
+namespace reSID
+{
+
+// Dot product of two short vectors of length n, accumulated in an int with
+// wraparound, i.e. the same result as a plain loop. Points to the fastest
+// kernel the CPU supports.
+extern int (*convolve)(const short* a, const short* b, int n);
+
+// Name of the kernel in use, "scalar", "sse2" or "avx2".
+const char* convolve_kernel();
+
+// Use the named kernel, 0 for the fastest one available. Returns false if
+// the CPU doesn't support it.
+bool set_convolve_kernel(const char* name);
+
+} // namespace reSID
+
+#endif // not RESID_CONVOLVE_H
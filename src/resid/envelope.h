@@ -45,6 +45,8 @@ public:
 
   void clock();
   void clock(cycle_count delta_t);
+  cycle_count idle_cycles();
+  void clock_idle(cycle_count delta_t);
   void reset();
 
   void writeCONTROL_REG(reg8);
@@ -193,6 +195,32 @@ void EnvelopeGenerator::clock()
 }
 
 
+// ----------------------------------------------------------------------------
+// Number of cycles until the rate counter reaches the rate period, or 0 if
+// something is pending in the pipelines. Until then, clock() only counts the
+// rate counter, which clock_idle() does for several cycles at once.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+cycle_count EnvelopeGenerator::idle_cycles()
+{
+  if (state_pipeline || envelope_pipeline || exponential_pipeline ||
+      reset_rate_counter || rate_counter >= rate_period) {
+    return 0;
+  }
+
+  return rate_period - rate_counter;
+}
+
+// ----------------------------------------------------------------------------
+// SID clocking - delta_t idle cycles, see idle_cycles().
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void EnvelopeGenerator::clock_idle(cycle_count delta_t)
+{
+  env3 = envelope_counter;
+  rate_counter += delta_t;
+}
+
 // ----------------------------------------------------------------------------
 // SID clocking - delta_t cycles.
 // ----------------------------------------------------------------------------
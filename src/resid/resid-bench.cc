@@ -0,0 +1,443 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+// Renders register writes through reSID with every sampling method and
+// reports the samples per second, to measure changes to the sample
+// generation. Not built by default, use "make resid-bench".
+//
+// resid-bench [-k scalar|sse2|avx2] [-r sample_rate] [-s seconds] [-n runs]
+//             [-8] [-c] [-v] [dump files...]
+//
+// Without files, a built-in script of -s seconds is played. Files are logs
+// from "-sounddev dump", of which the writes to the first SID are replayed.
+// With -n, every method is run several times and the fastest run counts.
+// -c clocks every cycle on its own instead of in blocks, and -v checks
+// that both give the same samples for the resampling methods.
+//
+// The two-stage resampler is also compared with the single-stage one. Their
+// delays differ by a fraction of a sample, so the power spectra below the
+// end of the passband are compared rather than the samples.
+
+#include "sid.h"
+#include "convolve.h"
+
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace reSID;
+
+static const double clock_freq = 985248;
+static const int frame_cycles = 19656;
+
+static const struct {
+  const char* name;
+  sampling_method method;
+} methods[] = {
+  { "fast", SAMPLE_FAST },
+  { "interpolate", SAMPLE_INTERPOLATE },
+  { "resample", SAMPLE_RESAMPLE },
+  { "resample_fastmem", SAMPLE_RESAMPLE_FASTMEM },
+  { "resample_twostage", SAMPLE_RESAMPLE_TWOSTAGE }
+};
+
+static const int fft_size = 4096;
+
+// A register write, delta_t cycles after the previous one.
+struct reg_write {
+  cycle_count delta_t;
+  reg8 offset;
+  reg8 value;
+};
+
+typedef std::vector<reg_write> script_t;
+
+static void add_write(script_t& script, cycle_count& delta_t, reg8 offset, reg8 value)
+{
+  reg_write w = { delta_t, offset, value };
+  script.push_back(w);
+  delta_t = 0;
+}
+
+// The built-in script: three voices stepping through a few notes with a
+// pulse width and a filter cutoff sweep. Every 50 frames, the waveforms and
+// envelopes change, to also cover ring modulation, hard sync, noise, the
+// combined waveforms and the test bit.
+static script_t builtin_script(double seconds)
+{
+  static const int notes[8] = {
+    0x1125, 0x1459, 0x16b5, 0x1b36, 0x224b, 0x28b3, 0x2d69, 0x366c
+  };
+  static const reg8 controls[4][3] = {
+    { 0x40, 0x20, 0x10 },
+    { 0x14, 0x22, 0x40 },
+    { 0x80, 0x60, 0x50 },
+    { 0xc0, 0x40, 0x30 }
+  };
+  static const reg8 envelopes[4][2] = {
+    { 0x29, 0xa8 }, { 0x00, 0xf0 }, { 0x4a, 0x6c }, { 0x11, 0xf3 }
+  };
+
+  script_t script;
+  cycle_count delta_t = 0;
+  int frames = int(seconds*clock_freq/frame_cycles);
+
+  add_write(script, delta_t, 0x18, 0x1f);
+  add_write(script, delta_t, 0x17, 0xf3);
+
+  for (int frame = 0; frame < frames; frame++) {
+    int phase = (frame/50) & 3;
+
+    for (int v = 0; v < 3; v++) {
+      int note = notes[(frame/(6 + v*2) + v*3) & 7] >> (2 - v);
+      int pw = (frame*23 + v*0x555) & 0xfff;
+      reg8 control = controls[phase][v] | ((frame % (6 + v*2)) < 4);
+
+      if (phase == 3 && v == 1 && (frame & 1)) {
+        control |= 0x08;
+      }
+      if (frame % 50 == 0) {
+        add_write(script, delta_t, v*7 + 5, envelopes[phase][0]);
+        add_write(script, delta_t, v*7 + 6, envelopes[phase][1]);
+      }
+      add_write(script, delta_t, v*7 + 0, note & 0xff);
+      add_write(script, delta_t, v*7 + 1, note >> 8);
+      add_write(script, delta_t, v*7 + 2, pw & 0xff);
+      add_write(script, delta_t, v*7 + 3, pw >> 8);
+      add_write(script, delta_t, v*7 + 4, control);
+    }
+
+    int cutoff = (frame*13) & 0x7ff;
+    add_write(script, delta_t, 0x15, cutoff & 7);
+    add_write(script, delta_t, 0x16, cutoff >> 3);
+
+    delta_t = frame_cycles;
+  }
+
+  return script;
+}
+
+// Reads the writes to the first SID from a "-sounddev dump" log. Its lines
+// are either "clocks address value" or "clocks irq nmi chip address value",
+// with the clocks since the previous write.
+static bool load_dump(const char* path, script_t& script)
+{
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+
+  char line[256];
+  cycle_count delta_t = 0;
+  while (fgets(line, sizeof(line), f)) {
+    int clocks, irq, nmi, chip, addr, value;
+    int n = sscanf(line, "%d %d %d %d %d %d", &clocks, &irq, &nmi, &chip, &addr, &value);
+
+    if (n == 3) {
+      addr = irq;
+      value = nmi;
+      chip = 0;
+    } else if (n != 6) {
+      continue;
+    }
+    delta_t += clocks;
+    if (chip == 0) {
+      add_write(script, delta_t, addr & 0x1f, value);
+    }
+  }
+
+  fclose(f);
+  return true;
+}
+
+static double script_seconds(const script_t& script)
+{
+  double cycles = 0;
+  for (size_t i = 0; i < script.size(); i++) {
+    cycles += script[i].delta_t;
+  }
+  return cycles/clock_freq;
+}
+
+// Plays the script, returns the time taken or 0 if the sampling parameters
+// are not supported.
+static double render(const script_t& script, chip_model model, sampling_method method,
+                     double sample_rate, bool block_clocking,
+                     std::vector<short>* out, unsigned int& checksum, long& samples)
+{
+  int buf_len = 4096;
+  short buf[4096];
+
+  // The filter noise comes from rand(), reseed it for the same output on
+  // every run.
+  srand(1);
+  SID sid;
+
+  sid.set_chip_model(model);
+  sid.enable_block_clocking(block_clocking);
+  if (!sid.set_sampling_parameters(clock_freq, method, sample_rate)) {
+    return 0;
+  }
+
+  samples = 0;
+  checksum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (size_t w = 0; w < script.size(); w++) {
+    cycle_count delta_t = script[w].delta_t;
+    while (delta_t > 0) {
+      int n = sid.clock(delta_t, buf, buf_len);
+      for (int i = 0; i < n; i++) {
+        checksum = checksum*31 + (unsigned short)buf[i];
+      }
+      if (out) {
+        out->insert(out->end(), buf, buf + n);
+      }
+      samples += n;
+    }
+    sid.write(script[w].offset, script[w].value);
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() > 0 ? elapsed.count() : 1e-9;
+}
+
+// In place radix-2 FFT of fft_size points.
+static void fft(std::complex<double>* x)
+{
+  const double pi = 3.1415926535897932385;
+
+  for (int i = 1, j = 0; i < fft_size; i++) {
+    int bit = fft_size >> 1;
+    for (; j & bit; bit >>= 1) {
+      j ^= bit;
+    }
+    j ^= bit;
+    if (i < j) {
+      std::swap(x[i], x[j]);
+    }
+  }
+
+  for (int len = 2; len <= fft_size; len <<= 1) {
+    std::complex<double> w_len = std::polar(1.0, -2*pi/len);
+    for (int i = 0; i < fft_size; i += len) {
+      std::complex<double> w = 1;
+      for (int j = 0; j < len/2; j++) {
+        std::complex<double> u = x[i + j];
+        std::complex<double> v = x[i + j + len/2]*w;
+        x[i + j] = u + v;
+        x[i + j + len/2] = u - v;
+        w *= w_len;
+      }
+    }
+  }
+}
+
+// Average Hann windowed power spectrum, fft_size/2 bins.
+static std::vector<double> power_spectrum(const std::vector<short>& samples)
+{
+  const double pi = 3.1415926535897932385;
+  std::vector<double> power(fft_size/2, 0);
+  std::vector<std::complex<double> > x(fft_size);
+
+  for (size_t start = 0; start + fft_size <= samples.size(); start += fft_size) {
+    for (int i = 0; i < fft_size; i++) {
+      x[i] = samples[start + i]*(0.5 - 0.5*cos(2*pi*i/fft_size));
+    }
+    fft(&x[0]);
+    for (int i = 0; i < fft_size/2; i++) {
+      power[i] += std::norm(x[i]);
+    }
+  }
+
+  return power;
+}
+
+// Prints the largest and the mean difference in dB between two spectra up
+// to pass_freq, leaving out the bins more than 60dB below the peak.
+static void compare_spectra(const std::vector<short>& a, const std::vector<short>& b,
+                            double sample_rate, double pass_freq)
+{
+  std::vector<double> pa = power_spectrum(a);
+  std::vector<double> pb = power_spectrum(b);
+  int bins = int(pass_freq/sample_rate*fft_size);
+  double peak = 0;
+
+  for (int i = 1; i < bins; i++) {
+    if (pa[i] > peak) {
+      peak = pa[i];
+    }
+  }
+
+  double max_db = 0;
+  double sum_db = 0;
+  int n = 0;
+  for (int i = 1; i < bins; i++) {
+    if (pa[i] < peak*1e-6) {
+      continue;
+    }
+    double db = fabs(10*log10(pb[i]/pa[i]));
+    if (db > max_db) {
+      max_db = db;
+    }
+    sum_db += db;
+    n++;
+  }
+
+  printf("resample_twostage vs resample, up to %.0f Hz: max %.3f dB, mean %.4f dB over %d bins\n",
+         pass_freq, max_db, n ? sum_db/n : 0, n);
+}
+
+static void bench(const script_t& script, chip_model model, double sample_rate,
+                  int runs, bool block_clocking, bool verify)
+{
+  double seconds = script_seconds(script);
+  std::vector<short> resampled[2];
+
+  for (unsigned int m = 0; m < sizeof(methods)/sizeof(methods[0]); m++) {
+    sampling_method method = methods[m].method;
+    bool resampling = method == SAMPLE_RESAMPLE ||
+      method == SAMPLE_RESAMPLE_FASTMEM || method == SAMPLE_RESAMPLE_TWOSTAGE;
+    std::vector<short> output;
+    long samples = 0;
+    unsigned int checksum = 0;
+    double best = 0;
+
+    for (int run = 0; run < runs; run++) {
+      double elapsed = render(script, model, method, sample_rate, block_clocking,
+                              run == 0 ? &output : 0, checksum, samples);
+      if (elapsed == 0) {
+        break;
+      }
+      if (run == 0 || elapsed < best) {
+        best = elapsed;
+      }
+    }
+
+    if (best == 0) {
+      printf("%-17s unsupported sampling parameters\n", methods[m].name);
+      continue;
+    }
+
+    printf("%-17s %10.0f samples/s %7.1fx realtime  checksum %08x",
+           methods[m].name, samples/best, seconds/best, checksum);
+
+    if (verify && resampling) {
+      std::vector<short> reference;
+      unsigned int reference_checksum;
+      long reference_samples;
+
+      render(script, model, method, sample_rate, !block_clocking,
+             &reference, reference_checksum, reference_samples);
+
+      size_t i = 0;
+      while (i < output.size() && i < reference.size() && output[i] == reference[i]) {
+        i++;
+      }
+      if (i == output.size() && i == reference.size()) {
+        printf("  same as %s clocking", block_clocking ? "cycle" : "block");
+      } else {
+        printf("  DIFFERS from %s clocking at sample %lu",
+               block_clocking ? "cycle" : "block", (unsigned long)i);
+      }
+    }
+    printf("\n");
+
+    if (method == SAMPLE_RESAMPLE) {
+      resampled[0].swap(output);
+    } else if (method == SAMPLE_RESAMPLE_TWOSTAGE) {
+      resampled[1].swap(output);
+    }
+  }
+
+  // The default end of passband, see SID::set_sampling_parameters().
+  double pass_freq = 20000;
+  if (2*pass_freq/sample_rate >= 0.9) {
+    pass_freq = 0.9*sample_rate/2;
+  }
+  if (!resampled[0].empty() && !resampled[1].empty()) {
+    compare_spectra(resampled[0], resampled[1], sample_rate, pass_freq);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  double sample_rate = 48000;
+  double seconds = 30;
+  int runs = 1;
+  chip_model model = MOS6581;
+  bool block_clocking = true;
+  bool verify = false;
+  std::vector<const char*> files;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+      if (!set_convolve_kernel(argv[++i])) {
+        fprintf(stderr, "kernel %s not available\n", argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+      sample_rate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+      runs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-8")) {
+      model = MOS8580;
+    } else if (!strcmp(argv[i], "-c")) {
+      block_clocking = false;
+    } else if (!strcmp(argv[i], "-v")) {
+      verify = true;
+    } else if (argv[i][0] != '-') {
+      files.push_back(argv[i]);
+    } else {
+      fprintf(stderr, "usage: %s [-k scalar|sse2|avx2] [-r sample_rate] [-s seconds] [-n runs] [-8] [-c] [-v] [dump files...]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // The first SID builds the static filter tables, which also calls rand().
+  delete new SID;
+
+  const char* clocking = block_clocking ? "block" : "cycle";
+  const char* chip = model == MOS6581 ? "6581" : "8580";
+
+  if (files.empty()) {
+    script_t script = builtin_script(seconds);
+    printf("built-in script, MOS%s, %.0f Hz, %.0f s emulated, %s clocking, convolution kernel %s\n",
+           chip, sample_rate, script_seconds(script), clocking, convolve_kernel());
+    bench(script, model, sample_rate, runs, block_clocking, verify);
+  }
+
+  for (size_t f = 0; f < files.size(); f++) {
+    script_t script;
+    if (!load_dump(files[f], script)) {
+      fprintf(stderr, "can't read %s\n", files[f]);
+      return 1;
+    }
+    printf("%s, MOS%s, %.0f Hz, %.0f s emulated, %s clocking, convolution kernel %s\n",
+           files[f], chip, sample_rate, script_seconds(script), clocking, convolve_kernel());
+    bench(script, model, sample_rate, runs, block_clocking, verify);
+  }
+
+  return 0;
+}
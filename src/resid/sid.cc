@@ -25,6 +25,7 @@
 #endif
 
 #include "sid.h"
+#include "convolve.h"
 #include <cmath>
 #include <cassert>
 
@@ -64,6 +65,8 @@ SID::SID()
   // Initialize pointers.
   sample = 0;
   fir = 0;
+  sample_mid = 0;
+  fir_mid = 0;
   fir_N = 0;
   fir_RES = 0;
   fir_beta = 0;
@@ -86,6 +89,7 @@ SID::SID()
   scaleFactor = 3;
 
   raw_debug_output = false;
+  block_clocking = true;
 }
 
 
@@ -96,6 +100,8 @@ SID::~SID()
 {
   delete[] sample;
   delete[] fir;
+  delete[] sample_mid;
+  delete[] fir_mid;
 }
 
 
@@ -535,6 +541,15 @@ void SID::enable_raw_debug_output(bool enable)
     }
 }
 
+// ----------------------------------------------------------------------------
+// Enable clocking in blocks for resampling, see clock_ring(). Off, every
+// cycle is clocked on its own, for testing.
+// ----------------------------------------------------------------------------
+void SID::enable_block_clocking(bool enable)
+{
+  block_clocking = enable;
+}
+
 // ----------------------------------------------------------------------------
 // I0() computes the 0th order modified Bessel function of the first kind.
 // This function is originally from resample-1.5/filterkit.c by J. O. Smith.
@@ -585,8 +600,11 @@ double SID::I0(double x)
 bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
                         double sample_freq, double pass_freq, double filter_scale)
 {
+  bool resample = method == SAMPLE_RESAMPLE ||
+    method == SAMPLE_RESAMPLE_FASTMEM || method == SAMPLE_RESAMPLE_TWOSTAGE;
+
   // Check resampling constraints.
-  if (method == SAMPLE_RESAMPLE || method == SAMPLE_RESAMPLE_FASTMEM)
+  if (resample)
   {
     // Check whether the sample ring buffer would overfill.
     if (static_cast<int>(static_cast<double>(FIR_N)*clock_freq/sample_freq) >= RINGSIZE) {
@@ -623,8 +641,17 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
   sample_prev = 0;
   sample_now = 0;
 
+  // The intermediate stage is only used for two-stage resampling.
+  if (method != SAMPLE_RESAMPLE_TWOSTAGE)
+  {
+    delete[] sample_mid;
+    delete[] fir_mid;
+    sample_mid = 0;
+    fir_mid = 0;
+  }
+
   // FIR initialization is only necessary for resampling.
-  if (method != SAMPLE_RESAMPLE && method != SAMPLE_RESAMPLE_FASTMEM)
+  if (!resample)
   {
     delete[] sample;
     delete[] fir;
@@ -665,8 +692,65 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
   int N = int((A - 7.95)/(2.285*dw) + 0.5);
   N += N & 1;
 
-  double f_samples_per_cycle = sample_freq/clock_freq;
-  double f_cycles_per_sample = clock_freq/sample_freq;
+  // For two-stage resampling, the fir tables below resample from the
+  // intermediate rate instead of the clock rate, and "cycles" are
+  // intermediate samples.
+  double ring_freq = clock_freq;
+
+  if (method == SAMPLE_RESAMPLE_TWOSTAGE) {
+    // Laurent Ganier's optimal intermediate sampling frequency, see the
+    // comment above clock_resample(). The decimation has to be a whole
+    // number of cycles, so the next higher rate is used. It must stay
+    // above sample_freq for the first stage to have a transition band.
+    double mid_freq = 2*pass_freq + sqrt(2*pass_freq*clock_freq
+                                         *(sample_freq - 2*pass_freq)/sample_freq);
+    mid_decimation = int(clock_freq/mid_freq);
+    while (mid_decimation > 1 && clock_freq/mid_decimation <= sample_freq) {
+      mid_decimation--;
+    }
+    if (mid_decimation < 1) {
+      mid_decimation = 1;
+    }
+    ring_freq = clock_freq/mid_decimation;
+
+    // The first stage keeps the passband and removes everything that would
+    // alias below the start of the stopband of the second stage,
+    // sample_freq - pass_freq.
+    double stop_freq = ring_freq - (sample_freq - pass_freq);
+    double dw_mid = (stop_freq - pass_freq)/clock_freq*pi*2;
+    double wc_mid = (stop_freq + pass_freq)/clock_freq*pi;
+
+    int N_mid = int((A - 7.95)/(2.285*dw_mid) + 0.5);
+    N_mid += N_mid & 1;
+
+    delete[] fir_mid;
+    fir_mid_N = N_mid + 1;
+    fir_mid = new short[fir_mid_N];
+
+    // Check whether the sample ring buffer would overflow.
+    assert(fir_mid_N < RINGSIZE);
+
+    for (int j = -N_mid/2; j <= N_mid/2; j++) {
+      double wt = wc_mid*j;
+      double temp = double(j)/(N_mid/2);
+      double Kaiser = fabs(temp) <= 1 ? I0(beta*sqrt(1 - temp*temp))/I0beta : 0;
+      double sincwt = fabs(wt) >= 1e-6 ? sin(wt)/wt : 1;
+      double val = (1 << FIR_SHIFT)*wc_mid/pi*sincwt*Kaiser;
+      fir_mid[N_mid/2 + j] = (short)round(val);
+    }
+
+    if (!sample_mid) {
+      sample_mid = new short[RINGSIZE*2];
+    }
+    for (int j = 0; j < RINGSIZE*2; j++) {
+      sample_mid[j] = 0;
+    }
+    mid_phase = 0;
+    mid_index = 0;
+  }
+
+  double f_samples_per_cycle = sample_freq/ring_freq;
+  double f_cycles_per_sample = ring_freq/sample_freq;
 
   // The filter length is equal to the filter order + 1.
   // The filter length must be an odd number (sinc is symmetric about x = 0).
@@ -678,8 +762,8 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
 
   // We clamp the filter table resolution to 2^n, making the fixed point
   // sample_offset a whole multiple of the filter table resolution.
-  int res = method == SAMPLE_RESAMPLE ?
-    FIR_RES : FIR_RES_FASTMEM;
+  int res = method == SAMPLE_RESAMPLE_FASTMEM ?
+    FIR_RES_FASTMEM : FIR_RES;
   int n = (int)ceil(log(res/f_cycles_per_sample)/log(2.0f));
   int fir_RES_new = 1 << n;
 
@@ -832,6 +916,112 @@ void SID::clock(cycle_count delta_t)
 }
 
 
+// ----------------------------------------------------------------------------
+// SID clocking - delta_t cycles, with the output of every cycle stored in the
+// sample ring buffer for resampling.
+//
+// The result is the same as from clock() for every cycle, but the voices are
+// clocked for a block of cycles before the filters are. Unless hard sync or
+// ring modulation ties the oscillators together, each voice is clocked on its
+// own, and between rate counter periods its envelope is counted forward in
+// one step.
+// ----------------------------------------------------------------------------
+void SID::clock_ring(cycle_count delta_t)
+{
+  int i;
+
+  // Pipelined writes on the MOS8580 and the raw debug output are only
+  // handled by clock().
+  while (delta_t > 0 &&
+         (unlikely(write_pipeline) || unlikely(raw_debug_output) || !block_clocking)) {
+    clock();
+    sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
+    ++sample_index &= RINGMASK;
+    delta_t--;
+  }
+
+  bool coupled = false;
+  for (i = 0; i < 3; i++) {
+    if (voice[i].wave.sync || voice[i].wave.ring_msb_mask) {
+      coupled = true;
+    }
+  }
+
+  while (delta_t > 0) {
+    cycle_count delta_t_block = delta_t < BLOCKSIZE ? delta_t : BLOCKSIZE;
+
+    if (unlikely(coupled)) {
+      // Clock the voices together, in the same order as clock().
+      for (cycle_count c = 0; c < delta_t_block; c++) {
+        for (i = 0; i < 3; i++) {
+          voice[i].envelope.clock();
+        }
+        for (i = 0; i < 3; i++) {
+          voice[i].wave.clock();
+        }
+        for (i = 0; i < 3; i++) {
+          voice[i].wave.synchronize();
+        }
+        for (i = 0; i < 3; i++) {
+          voice[i].wave.set_waveform_output();
+          voice_block[i][c] = voice[i].output();
+        }
+      }
+    }
+    else {
+      for (i = 0; i < 3; i++) {
+        EnvelopeGenerator& envelope = voice[i].envelope;
+        WaveformGenerator& wave = voice[i].wave;
+        int* out = voice_block[i];
+        cycle_count c = 0;
+
+        while (c < delta_t_block) {
+          cycle_count delta_t_idle = envelope.idle_cycles();
+
+          if (delta_t_idle == 0) {
+            envelope.clock();
+            wave.clock();
+            wave.set_waveform_output();
+            out[c++] = voice[i].output();
+            continue;
+          }
+
+          if (delta_t_idle > delta_t_block - c) {
+            delta_t_idle = delta_t_block - c;
+          }
+
+          // The envelope output is constant while it is idle.
+          envelope.clock_idle(delta_t_idle);
+          int env = envelope.output();
+          int wave_zero = voice[i].wave_zero;
+
+          for (cycle_count end = c + delta_t_idle; c < end; c++) {
+            wave.clock();
+            wave.set_waveform_output();
+            out[c] = (wave.output() - wave_zero)*env;
+          }
+        }
+      }
+    }
+
+    for (cycle_count c = 0; c < delta_t_block; c++) {
+      filter.clock(voice_block[0][c], voice_block[1][c], voice_block[2][c]);
+      extfilt.clock(filter.output());
+      sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
+      ++sample_index &= RINGMASK;
+    }
+
+    // Age bus value.
+    if (bus_value_ttl > 0 && bus_value_ttl <= delta_t_block) {
+      bus_value = 0;
+    }
+    bus_value_ttl -= delta_t_block;
+
+    delta_t -= delta_t_block;
+  }
+}
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling.
 // Fixed point arithmetics are used.
@@ -858,6 +1048,8 @@ int SID::clock(cycle_count& delta_t, short* buf, int n, int interleave)
     return clock_resample(delta_t, buf, n, interleave);
   case SAMPLE_RESAMPLE_FASTMEM:
     return clock_resample_fastmem(delta_t, buf, n, interleave);
+  case SAMPLE_RESAMPLE_TWOSTAGE:
+    return clock_resample_twostage(delta_t, buf, n, interleave);
   }
 }
 
@@ -955,7 +1147,7 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n, int interlea
 // sampling frequency, the implementation below dramatically reduces the
 // computational effort in the filter convolutions, without any loss
 // of accuracy. The filter convolutions are also vectorizable on
-// current hardware.
+// current hardware, convolve() uses SSE2 or AVX2 when the CPU has them.
 //
 // Further possible optimizations are:
 // * An equiripple filter design could yield a lower filter order, see
@@ -970,6 +1162,7 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n, int interlea
 //   to be (via derivation of sum of two steps):
 //     2 * pass_freq + sqrt [ 2 * pass_freq * orig_sample_freq
 //       * (dest_sample_freq - 2 * pass_freq) / dest_sample_freq ]
+//   This is implemented in clock_resample_twostage().
 //
 // NB! the result of right shifting negative numbers is really
 // implementation dependent in the C++ standard.
@@ -986,11 +1179,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
-      ++sample_index &= RINGMASK;
-    }
+    clock_ring(delta_t_sample);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -1005,10 +1194,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+    int v1 = convolve(sample_start, fir_start, fir_N);
 
     // Use next FIR table, wrap around to first FIR table using
     // next sample.
@@ -1019,10 +1205,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     fir_start = fir + fir_offset*fir_N;
 
     // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
-    }
+    int v2 = convolve(sample_start, fir_start, fir_N);
 
     // Linear interpolation.
     // fir_offset_rmd is equal for all samples, it can thus be factorized out:
@@ -1053,11 +1236,7 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = clip(output());
-      ++sample_index &= RINGMASK;
-    }
+    clock_ring(delta_t_sample);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -1071,11 +1250,81 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
     short* sample_start = sample + sample_index - fir_N + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
+    int v = convolve(sample_start, fir_start, fir_N);
+
+    v >>= FIR_SHIFT;
+
+    buf[s*interleave] = amplify(v, scaleFactor);
+  }
+
+  return s;
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking with audio sampling - cycle based with two-stage audio
+// resampling.
+//
+// The first stage filters the cycle rate samples with a short FIR and keeps
+// every mid_decimation'th result, the second stage is clock_resample() run
+// on these intermediate samples. The output is close to clock_resample() at
+// a fraction of the filter work per sample.
+// ----------------------------------------------------------------------------
+int SID::clock_resample_twostage(cycle_count& delta_t, short* buf, int n, int interleave)
+{
+  int s;
+
+  for (s = 0; s < n; s++) {
+    cycle_count next_sample_offset = sample_offset + cycles_per_sample;
+    cycle_count delta_t_sample = next_sample_offset >> FIXP_SHIFT;
+
+    if (delta_t_sample > delta_t) {
+      delta_t_sample = delta_t;
+    }
+
+    clock_ring(delta_t_sample);
+
+    // First stage, one intermediate sample for every mid_decimation cycles.
+    // The oldest one is mid_phase - mid_decimation cycles back.
+    for (mid_phase += delta_t_sample; mid_phase >= mid_decimation; mid_phase -= mid_decimation) {
+      short* mid_start = sample + sample_index - (mid_phase - mid_decimation) - fir_mid_N + RINGSIZE;
+      int v = convolve(mid_start, fir_mid, fir_mid_N);
+      sample_mid[mid_index] = sample_mid[mid_index + RINGSIZE] = clip(v >> FIR_SHIFT);
+      ++mid_index &= RINGMASK;
+    }
+
+    if ((delta_t -= delta_t_sample) == 0) {
+      sample_offset -= delta_t_sample << FIXP_SHIFT;
+      break;
     }
 
+    sample_offset = next_sample_offset & FIXP_MASK;
+
+    // Offset of the sample from the last intermediate sample, in fixed
+    // point intermediate samples.
+    int mid_offset = ((mid_phase << FIXP_SHIFT) + sample_offset)/mid_decimation;
+
+    int fir_offset = mid_offset*fir_RES >> FIXP_SHIFT;
+    int fir_offset_rmd = mid_offset*fir_RES & FIXP_MASK;
+    short* fir_start = fir + fir_offset*fir_N;
+    short* sample_start = sample_mid + mid_index - fir_N - 1 + RINGSIZE;
+
+    // Second stage, convolution with filter impulse response.
+    int v1 = convolve(sample_start, fir_start, fir_N);
+
+    // Use next FIR table, wrap around to first FIR table using
+    // next sample.
+    if (unlikely(++fir_offset == fir_RES)) {
+      fir_offset = 0;
+      ++sample_start;
+    }
+    fir_start = fir + fir_offset*fir_N;
+
+    int v2 = convolve(sample_start, fir_start, fir_N);
+
+    // Linear interpolation.
+    int v = v1 + int((unsigned(fir_offset_rmd)*unsigned(v2 - v1)) >> FIXP_SHIFT);
+
     v >>= FIR_SHIFT;
 
     buf[s*interleave] = amplify(v, scaleFactor);
@@ -51,6 +51,7 @@ public:
   double filter_scale = 0.97);
   void adjust_sampling_frequency(double sample_freq);
   void enable_raw_debug_output(bool enable);
+  void enable_block_clocking(bool enable);
 
   void clock();
   void clock(cycle_count delta_t);
@@ -109,6 +110,8 @@ public:
   int clock_interpolate(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int interleave);
+  int clock_resample_twostage(cycle_count& delta_t, short* buf, int n, int interleave);
+  void clock_ring(cycle_count delta_t);
   void write();
 
   chip_model sid_model;
@@ -149,6 +152,9 @@ public:
     RINGSIZE = 1 << 14,
     RINGMASK = RINGSIZE - 1,
 
+    // Cycles clocked at a time by clock_ring().
+    BLOCKSIZE = 128,
+
     // Fixed point constants (16.16 bits).
     FIXP_SHIFT = 16,
     FIXP_MASK = 0xffff
@@ -172,6 +178,20 @@ public:
   // FIR_RES filter tables (FIR_N*FIR_RES).
   short* fir;
 
+  // Two-stage resampling: every mid_decimation cycles, the ring buffer is
+  // filtered with fir_mid into sample_mid, which is then resampled with
+  // the fir tables.
+  int mid_decimation;
+  int mid_phase;
+  int mid_index;
+  int fir_mid_N;
+  short* fir_mid;
+  short* sample_mid;
+
+  // Voice outputs of the current clock_ring() block.
+  int voice_block[3][BLOCKSIZE];
+  bool block_clocking;
+
   bool raw_debug_output; // FIXME: should be private?
 };
 
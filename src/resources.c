@@ -1063,6 +1063,32 @@ void resources_get_event_safe_list(event_list_state_t *list)
     event_record_in_list(list, EVENT_LIST_END, NULL, 0);
 }
 
+/* get the resources that must be the same for identical emulation (tagged
+   with RES_EVENT_SAME or RES_EVENT_STRICT) as "name=value" lines, in the
+   order they were registered */
+char *resources_write_event_relevant_to_string(const char *delim)
+{
+    unsigned int i;
+    char *list;
+    char *line;
+    char *temp;
+
+    list = lib_strdup("");
+    for (i = 0; i < num_resources; i++) {
+        if (resources[i].event_relevant == RES_EVENT_NO) {
+            continue;
+        }
+        line = string_resource_item((int)i, delim);
+        if (line != NULL) {
+            temp = util_concat(list, line, NULL);
+            lib_free(list);
+            lib_free(line);
+            list = temp;
+        }
+    }
+    return list;
+}
+
 int resources_toggle(const char *name, int *new_value_return)
 {
     resource_ram_t *r = lookup(name);
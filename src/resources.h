@@ -186,6 +186,7 @@ int resources_set_default_string(const char *name, char *value);
 
 int resources_set_event_safe(void);
 void resources_get_event_safe_list(struct event_list_state_s *list);
+char *resources_write_event_relevant_to_string(const char *delim);
 
 /* Register a callback for a resource; use name=NULL to register a callback for all.
    Resource-specific callbacks are always called with a valid resource name as parameter.
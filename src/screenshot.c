@@ -183,15 +183,14 @@ static int screenshot_save_core(screenshot_t *screenshot, gfxoutputdrv_t *drv,
             }
         }
     } else {
-        /* We're recording a movie */
-        if (vsync_get_warp_mode() == 0) {
-            /* skip recording when warpmode is active, this doesn't really work -
-               and unless we significantly change what warpmode does can not work */
-            if ((recording_driver->record)(screenshot) < 0) {
-                log_error(screenshot_log, "Recording failed...");
-                lib_free(screenshot->color_map);
-                return -1;
-            }
+        /* We're recording a movie.  Every emulated frame is passed on, also
+           in warp mode: the sound core keeps feeding the recording device
+           with the emulated samples, so the movie stays in emulated time no
+           matter how fast the host runs. */
+        if ((recording_driver->record)(screenshot) < 0) {
+            log_error(screenshot_log, "Recording failed...");
+            lib_free(screenshot->color_map);
+            return -1;
         }
     }
 
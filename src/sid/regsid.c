@@ -0,0 +1,537 @@
+/*
+ * regsid.c - Register-only SID engine.
+ *
+ * When the SID writes go to ASID or to a hardware SID (see the dump2 sound
+ * devices) nobody listens to the emulated output, so this engine produces
+ * silence and only keeps what the CPU can read back from the chip: OSC3 and
+ * ENV3 of voice 3, the paddle registers and the fading data bus value on
+ * reads of write-only registers.
+ *
+ * Nothing is clocked per cycle or per sample. Voice 3 is brought up to date
+ * from the clock difference when OSC3 or ENV3 is read or one of its
+ * registers is written, in steps of the envelope rate period, and the bus
+ * value simply expires like in reSID. Ring modulation and hard sync from
+ * voice 2 are ignored and combined waveforms are approximated by ANDing
+ * the single waveforms.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lib.h"
+#include "maincpu.h"
+#include "regsid.h"
+#include "resources.h"
+#include "sid-snapshot.h"
+#include "sid.h"
+#include "sound.h"
+#include "types.h"
+
+/* ADSR state */
+#define ATTACK          0
+#define DECAY_SUSTAIN   1
+#define RELEASE         2
+
+/* voice 3 registers */
+#define REG_FREQ_LO     0x0e
+#define REG_FREQ_HI     0x0f
+#define REG_PW_LO       0x10
+#define REG_PW_HI       0x11
+#define REG_CONTROL     0x12
+#define REG_AD          0x13
+#define REG_SR          0x14
+
+#define CONTROL_GATE    0x01
+#define CONTROL_TEST    0x08
+
+/* cycles the last value on the data bus can be read back, as in reSID */
+#define BUS_TTL_6581    0x1d00
+#define BUS_TTL_8580    0xa2000
+
+/* period of the 23 bit noise shift register */
+#define NOISE_PERIOD    0x7fffff
+
+struct sound_s {
+    /* register data */
+    uint8_t d[32];
+
+    /* clock voice 3 was last brought up to date */
+    CLOCK clk;
+
+    /* voice 3 oscillator */
+    uint32_t accumulator;
+    uint32_t shift_register;
+
+    /* voice 3 envelope */
+    int state;
+    int hold_zero;
+    uint8_t envelope_counter;
+    uint8_t exponential_counter;
+    uint8_t exponential_counter_period;
+    uint16_t rate_counter;
+    uint16_t rate_period;
+
+    /* data bus */
+    uint8_t bus_value;
+    CLOCK bus_clk;
+    CLOCK bus_ttl;
+};
+
+/* envelope rate counter periods, from reSID */
+static const uint16_t rate_counter_period[16] = {
+    8, 31, 62, 94, 148, 219, 266, 312, 391, 976, 1953, 3125, 3906, 11719, 19531, 31250
+};
+
+/* ------------------------------------------------------------------------- */
+
+static void regsid_clock_shift_register(sound_t *psid, uint64_t shifts)
+{
+    uint32_t reg = psid->shift_register;
+
+    shifts %= NOISE_PERIOD;
+    while (shifts--) {
+        reg = ((reg << 1) & 0x7fffff) | (((reg >> 22) ^ (reg >> 17)) & 1);
+    }
+    psid->shift_register = reg;
+}
+
+static void regsid_clock_oscillator(sound_t *psid, CLOCK delta_t)
+{
+    uint64_t from, to;
+    uint32_t freq;
+
+    if (psid->d[REG_CONTROL] & CONTROL_TEST) {
+        return;
+    }
+
+    freq = psid->d[REG_FREQ_LO] | (psid->d[REG_FREQ_HI] << 8);
+    from = psid->accumulator;
+    to = from + (uint64_t)freq * delta_t;
+
+    /* the shift register is clocked whenever bit 19 goes high */
+    regsid_clock_shift_register(psid, ((to + 0x80000) >> 20) - ((from + 0x80000) >> 20));
+
+    psid->accumulator = (uint32_t)(to & 0xffffff);
+}
+
+static void regsid_set_exponential_counter(sound_t *psid)
+{
+    switch (psid->envelope_counter) {
+        case 0xff:
+            psid->exponential_counter_period = 1;
+            break;
+        case 0x5d:
+            psid->exponential_counter_period = 2;
+            break;
+        case 0x36:
+            psid->exponential_counter_period = 4;
+            break;
+        case 0x1a:
+            psid->exponential_counter_period = 8;
+            break;
+        case 0x0e:
+            psid->exponential_counter_period = 16;
+            break;
+        case 0x06:
+            psid->exponential_counter_period = 30;
+            break;
+        case 0x00:
+            psid->exponential_counter_period = 1;
+            psid->hold_zero = 1;
+            break;
+    }
+}
+
+/* same stepping as reSID's EnvelopeGenerator::clock(delta_t), without the
+   single cycle pipelines */
+static void regsid_clock_envelope(sound_t *psid, CLOCK delta_t)
+{
+    int rate_step = psid->rate_period - psid->rate_counter;
+
+    /* ADSR delay bug: a period below the counter wraps it at 0x8000 */
+    if (rate_step <= 0) {
+        rate_step += 0x7fff;
+    }
+
+    while (delta_t) {
+        if (delta_t < (CLOCK)rate_step) {
+            psid->rate_counter += (uint16_t)delta_t;
+            if (psid->rate_counter & 0x8000) {
+                psid->rate_counter = (psid->rate_counter + 1) & 0x7fff;
+            }
+            return;
+        }
+
+        psid->rate_counter = 0;
+        delta_t -= rate_step;
+        rate_step = psid->rate_period;
+
+        /* nothing changes any more, skip the remaining rate periods */
+        if (psid->hold_zero
+            || (psid->state == DECAY_SUSTAIN
+                && psid->envelope_counter == (psid->d[REG_SR] >> 4) * 0x11)) {
+            psid->rate_counter = (uint16_t)(delta_t % psid->rate_period);
+            return;
+        }
+
+        if (psid->state != ATTACK
+            && ++psid->exponential_counter != psid->exponential_counter_period) {
+            continue;
+        }
+        psid->exponential_counter = 0;
+
+        switch (psid->state) {
+            case ATTACK:
+                psid->envelope_counter++;
+                if (psid->envelope_counter == 0xff) {
+                    psid->state = DECAY_SUSTAIN;
+                    psid->rate_period = rate_counter_period[psid->d[REG_AD] & 0x0f];
+                    rate_step = psid->rate_period;
+                }
+                break;
+            case DECAY_SUSTAIN:
+                psid->envelope_counter--;
+                break;
+            case RELEASE:
+                psid->envelope_counter--;
+                break;
+        }
+
+        regsid_set_exponential_counter(psid);
+    }
+}
+
+/* bring voice 3 up to the current clock */
+static void regsid_clock(sound_t *psid)
+{
+    CLOCK delta_t = maincpu_clk - psid->clk;
+
+    if (delta_t == 0) {
+        return;
+    }
+    psid->clk = maincpu_clk;
+
+    regsid_clock_oscillator(psid, delta_t);
+    regsid_clock_envelope(psid, delta_t);
+}
+
+/* 12 bit output of the voice 3 waveform generator */
+static uint16_t regsid_waveform(sound_t *psid)
+{
+    uint8_t control = psid->d[REG_CONTROL];
+    uint32_t acc = psid->accumulator;
+    uint32_t reg = psid->shift_register;
+    uint16_t output = 0xfff;
+    uint16_t pw;
+
+    if ((control & 0xf0) == 0) {
+        return 0;
+    }
+    if (control & 0x10) {
+        /* triangle */
+        output &= (uint16_t)((((acc & 0x800000) ? ~acc : acc) >> 11) & 0xfff);
+    }
+    if (control & 0x20) {
+        /* sawtooth */
+        output &= (uint16_t)(acc >> 12);
+    }
+    if (control & 0x40) {
+        /* pulse */
+        pw = psid->d[REG_PW_LO] | ((psid->d[REG_PW_HI] & 0x0f) << 8);
+        if (!(control & CONTROL_TEST) && (acc >> 12) < pw) {
+            output = 0;
+        }
+    }
+    if (control & 0x80) {
+        /* noise */
+        output &= (uint16_t)(((reg & 0x400000) >> 11)
+                             | ((reg & 0x100000) >> 10)
+                             | ((reg & 0x010000) >> 7)
+                             | ((reg & 0x002000) >> 5)
+                             | ((reg & 0x000800) >> 4)
+                             | ((reg & 0x000080) >> 1)
+                             | ((reg & 0x000010) << 1)
+                             | ((reg & 0x000004) << 2));
+    }
+
+    return output;
+}
+
+static void regsid_write_control(sound_t *psid, uint8_t control)
+{
+    uint8_t old = psid->d[REG_CONTROL];
+
+    if (control & CONTROL_TEST) {
+        psid->accumulator = 0;
+        psid->shift_register = 0;
+    } else if (old & CONTROL_TEST) {
+        psid->shift_register = 0x7ffff8;
+    }
+
+    if ((old ^ control) & CONTROL_GATE) {
+        if (control & CONTROL_GATE) {
+            psid->state = ATTACK;
+            psid->hold_zero = 0;
+            psid->rate_period = rate_counter_period[psid->d[REG_AD] >> 4];
+        } else {
+            psid->state = RELEASE;
+            psid->rate_period = rate_counter_period[psid->d[REG_SR] & 0x0f];
+        }
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+static sound_t *regsid_open(uint8_t *sidstate)
+{
+    sound_t *psid;
+
+    psid = lib_calloc(1, sizeof(sound_t));
+
+    memcpy(psid->d, sidstate, 32);
+
+    return psid;
+}
+
+static int regsid_init(sound_t *psid, int speed, int cycles_per_sec, int factor)
+{
+    int sid_model;
+
+    if (resources_get_int("SidModel", &sid_model) < 0) {
+        return 0;
+    }
+
+    switch (sid_model) {
+        case SID_MODEL_8580:
+        case SID_MODEL_8580D:
+            psid->bus_ttl = BUS_TTL_8580;
+            break;
+        default:
+            psid->bus_ttl = BUS_TTL_6581;
+            break;
+    }
+
+    psid->state = RELEASE;
+    psid->hold_zero = 1;
+    psid->exponential_counter_period = 1;
+    psid->rate_period = rate_counter_period[psid->d[REG_SR] & 0x0f];
+    psid->shift_register = 0x7ffff8;
+    psid->clk = maincpu_clk;
+
+    return 1;
+}
+
+static void regsid_close(sound_t *psid)
+{
+    lib_free(psid);
+}
+
+static uint8_t regsid_read(sound_t *psid, uint16_t addr)
+{
+    switch (addr) {
+        case 0x19:
+        case 0x1a:
+            /* pot x/y, the paddles of the first SID are read in sid.c */
+            psid->bus_value = 0xff;
+            break;
+        case 0x1b:
+            regsid_clock(psid);
+            psid->bus_value = (uint8_t)(regsid_waveform(psid) >> 4);
+            break;
+        case 0x1c:
+            regsid_clock(psid);
+            psid->bus_value = psid->envelope_counter;
+            break;
+        default:
+            /* write-only register, the last value on the bus until it fades */
+            if (maincpu_clk - psid->bus_clk > psid->bus_ttl) {
+                psid->bus_value = 0;
+            }
+            return psid->bus_value;
+    }
+
+    psid->bus_clk = maincpu_clk;
+    return psid->bus_value;
+}
+
+static void regsid_store(sound_t *psid, uint16_t addr, uint8_t byte)
+{
+    switch (addr) {
+        case REG_FREQ_LO:
+        case REG_FREQ_HI:
+        case REG_PW_LO:
+        case REG_PW_HI:
+        case REG_SR:
+            regsid_clock(psid);
+            if (addr == REG_SR && psid->state == RELEASE) {
+                psid->rate_period = rate_counter_period[byte & 0x0f];
+            }
+            break;
+        case REG_CONTROL:
+            regsid_clock(psid);
+            regsid_write_control(psid, byte);
+            break;
+        case REG_AD:
+            regsid_clock(psid);
+            if (psid->state == ATTACK) {
+                psid->rate_period = rate_counter_period[byte >> 4];
+            } else if (psid->state == DECAY_SUSTAIN) {
+                psid->rate_period = rate_counter_period[byte & 0x0f];
+            }
+            break;
+        default:
+            break;
+    }
+
+    psid->d[addr] = byte;
+    psid->bus_value = byte;
+    psid->bus_clk = maincpu_clk;
+}
+
+static void regsid_reset(sound_t *psid, CLOCK cpu_clk)
+{
+    memset(psid->d, 0, sizeof(psid->d));
+
+    psid->clk = cpu_clk;
+    psid->accumulator = 0;
+    psid->shift_register = 0x7ffff8;
+    psid->state = RELEASE;
+    psid->hold_zero = 1;
+    psid->envelope_counter = 0;
+    psid->exponential_counter = 0;
+    psid->exponential_counter_period = 1;
+    psid->rate_counter = 0;
+    psid->rate_period = rate_counter_period[0];
+    psid->bus_value = 0;
+    psid->bus_clk = cpu_clk;
+}
+
+#ifdef SOUND_SYSTEM_FLOAT
+static int regsid_calculate_samples(sound_t *psid, float *pbuf, int nr, CLOCK *delta_t)
+{
+    memset(pbuf, 0, nr * sizeof(float));
+    return nr;
+}
+#else
+static int regsid_calculate_samples(sound_t *psid, int16_t *pbuf, int nr, int interleave, CLOCK *delta_t)
+{
+    int i;
+
+    if (interleave == 1) {
+        memset(pbuf, 0, nr * sizeof(int16_t));
+    } else {
+        for (i = 0; i < nr; i++) {
+            pbuf[i * interleave] = 0;
+        }
+    }
+    return nr;
+}
+#endif
+
+static char *regsid_dump_state(sound_t *psid)
+{
+    regsid_clock(psid);
+
+    return lib_msprintf("#SID: clk=%ld osc3=%02x env3=%02x state=%c bus=%02x\n",
+                        (long)maincpu_clk,
+                        (unsigned int)(regsid_waveform(psid) >> 4),
+                        psid->envelope_counter,
+                        "ADR"[psid->state],
+                        psid->bus_value);
+}
+
+/* the state is kept in the reSID snapshot layout, voice 3 only, so OSC3,
+   ENV3 and the bus value survive snapshots and the boot cache */
+static void regsid_resid_state_read(sound_t *psid, sid_snapshot_state_t *sid_state)
+{
+    CLOCK bus_age;
+
+    regsid_clock(psid);
+
+    memset(sid_state, 0, sizeof(sid_snapshot_state_t));
+    memcpy(sid_state->sid_register, psid->d, 32);
+
+    bus_age = maincpu_clk - psid->bus_clk;
+    sid_state->bus_value = psid->bus_value;
+    sid_state->bus_value_ttl = (bus_age < psid->bus_ttl) ? (uint32_t)(psid->bus_ttl - bus_age) : 0;
+
+    sid_state->accumulator[2] = psid->accumulator;
+    sid_state->shift_register[2] = psid->shift_register;
+    sid_state->rate_counter[2] = psid->rate_counter;
+    sid_state->rate_counter_period[2] = psid->rate_period;
+    sid_state->exponential_counter[2] = psid->exponential_counter;
+    sid_state->exponential_counter_period[2] = psid->exponential_counter_period;
+    sid_state->envelope_counter[2] = psid->envelope_counter;
+    sid_state->envelope_state[2] = (uint8_t)psid->state;
+    sid_state->hold_zero[2] = (uint8_t)psid->hold_zero;
+    sid_state->voice_mask = 0x07;
+}
+
+static void regsid_resid_state_write(sound_t *psid, sid_snapshot_state_t *sid_state)
+{
+    memcpy(psid->d, sid_state->sid_register, 32);
+
+    psid->clk = maincpu_clk;
+
+    /* age the bus value so it expires after the remaining ttl */
+    psid->bus_value = sid_state->bus_value;
+    psid->bus_clk = maincpu_clk;
+    if (sid_state->bus_value_ttl == 0) {
+        psid->bus_value = 0;
+    } else if (sid_state->bus_value_ttl < psid->bus_ttl) {
+        psid->bus_clk -= psid->bus_ttl - sid_state->bus_value_ttl;
+    }
+
+    psid->accumulator = sid_state->accumulator[2] & 0xffffff;
+    psid->shift_register = sid_state->shift_register[2] & 0x7fffff;
+    psid->rate_counter = sid_state->rate_counter[2] & 0x7fff;
+    psid->rate_period = sid_state->rate_counter_period[2];
+    psid->exponential_counter = (uint8_t)sid_state->exponential_counter[2];
+    psid->exponential_counter_period = (uint8_t)sid_state->exponential_counter_period[2];
+    psid->envelope_counter = sid_state->envelope_counter[2];
+    psid->state = (sid_state->envelope_state[2] <= RELEASE) ? sid_state->envelope_state[2] : RELEASE;
+    psid->hold_zero = sid_state->hold_zero[2] ? 1 : 0;
+
+    /* a zero period would never let the envelope step again */
+    if (psid->rate_period == 0) {
+        psid->rate_period = rate_counter_period[0];
+    }
+    if (psid->exponential_counter_period == 0) {
+        psid->exponential_counter_period = 1;
+    }
+}
+
+sid_engine_t regsid_hooks =
+{
+    regsid_open,
+    regsid_init,
+    regsid_close,
+    regsid_read,
+    regsid_store,
+    regsid_reset,
+    regsid_calculate_samples,
+    regsid_dump_state,
+    regsid_resid_state_read,
+    regsid_resid_state_write
+};
@@ -151,6 +151,11 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec, int factor)
         method = SAMPLE_RESAMPLE_FASTMEM;
         sprintf(method_text, "resampling, pass to %dHz", (int)passband);
         break;
+      case 4:
+        /* resid-dtv has no two-stage resampling */
+        method = SAMPLE_RESAMPLE;
+        sprintf(method_text, "resampling, pass to %dHz", (int)passband);
+        break;
     }
 
     if (!psid->sid->set_sampling_parameters(cycles_per_sec, method,
@@ -129,6 +129,12 @@ static const struct engine_s engine_match[] = {
     { "usbs", SID_USBSID },
     { "us", SID_USBSID },
 #endif
+    { "2048", SID_REGSID_6581 },
+    { "regsid", SID_REGSID_6581 },
+    { "regsid6581", SID_REGSID_6581 },
+    { "reg", SID_REGSID_6581 },
+    { "2049", SID_REGSID_8580 },
+    { "regsid8580", SID_REGSID_8580 },
     { NULL, -1 }
 };
 
@@ -224,7 +230,7 @@ static const cmdline_option_t resid_cmdline_options[] =
 {
     { "-residsamp", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "SidResidSampling", NULL,
-      "<method>", "reSID sampling method (0: fast, 1: interpolating, 2: resampling, 3: fast resampling)" },
+      "<method>", "reSID sampling method (0: fast, 1: interpolating, 2: resampling, 3: fast resampling, 4: two-stage resampling)" },
     { "-residpass", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "SidResidPassband", NULL,
       "<percent>", "reSID resampling passband in percentage of total bandwidth (0 - 90)" },
@@ -311,6 +317,9 @@ static cmdline_option_t stereo_cmdline_options[] =
     { "-sid8address", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "Sid8AddressStart", NULL,
       "<Base address>", NULL },
+    { "-sidrenderthreads", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "SidRenderThreads", NULL,
+      "<threads>", "Render multiple SIDs of a cycle based engine on <threads> threads (0/1: off)" },
     CMDLINE_LIST_END
 };
 
@@ -458,6 +467,11 @@ static char *build_sid_cmdline_option(int sid_type)
     }
 #endif
 
+    /* add the register-only engine */
+    new = util_concat(old, ", 2048: registers only 6581, 2049: registers only 8580", NULL);
+    lib_free(old);
+    old = new;
+
     /* add ending bracket */
     new = util_concat(old, ")", NULL);
     lib_free(old);
@@ -536,6 +550,11 @@ static char *build_sid_engine_cmdline_option(int sid_type)
     }
 #endif
 
+    /* add the register-only engine */
+    new = util_concat(old, ", 8: registers only", NULL);
+    lib_free(old);
+    old = new;
+
     /* add ending bracket */
     new = util_concat(old, ")", NULL);
     lib_free(old);
@@ -0,0 +1,551 @@
+/** \file   sid-render.c
+ * \brief   Render multiple SIDs on worker threads
+ *
+ * With more than one SID the cycle based engine renders every chip one
+ * after the other on the emulation thread, at the end of every raster line
+ * and before every write to any of them. The chips don't affect each other
+ * though, so when SidRenderThreads is above 1 and a cycle based engine runs
+ * more than one SID, writes are instead queued per chip with their clock and
+ * the chips are only rendered once SID_RENDER_BATCH_CYCLES have passed. Then
+ * each chip plays its queued writes at their clock while producing its
+ * samples, the chips spread over a small pool of threads, and the results
+ * are mixed like the sequential code in sid.c does. This delays the sound by
+ * up to one batch.
+ *
+ * Reading a SID register, dumping its state or reading it for a snapshot
+ * first renders all chips up to the current clock, the samples are kept
+ * until the sound code asks for them.
+ *
+ * Sound chips mixed in after the SIDs, like cartridge sound chips, only get
+ * room for the samples handed out, so they lose the cycles of calls that
+ * return none.
+ *
+ * Without pthreads, or with the float sound system, the queue is never used.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if (defined(USE_VICE_THREAD) || defined(HAVE_PTHREAD)) && !defined(SOUND_SYSTEM_FLOAT)
+#define SID_RENDER_THREADED
+#include <pthread.h>
+#endif
+
+#include "lib.h"
+#include "log.h"
+#include "maincpu.h"
+#include "resources.h"
+#include "sid-render.h"
+#include "sid.h"
+#include "sound.h"
+#include "types.h"
+
+/* cycles collected before the chips are rendered, about one fragment */
+#define SID_RENDER_BATCH_CYCLES 2048
+
+/* writes queued per chip before they are applied right away */
+#define SID_RENDER_QUEUE_MAX    0x10000
+
+typedef struct sid_render_write_s {
+    CLOCK clk;
+    uint16_t addr;
+    uint8_t byte;
+} sid_render_write_t;
+
+typedef struct sid_render_chip_s {
+    sound_t *psid;
+
+    /* queued writes */
+    sid_render_write_t *writes;
+    unsigned int count;
+    unsigned int size;
+
+    /* mono samples rendered but not handed out yet */
+    int16_t *buf;
+    int nr;
+    int blen;
+} sid_render_chip_t;
+
+static sid_render_chip_t chips[SOUND_SIDS_MAX];
+static int render_chips = 0;
+static const sid_engine_t *render_engine = NULL;
+static int render_threads = 1;
+static int render_active = 0;
+
+/* set once render_clk is valid */
+static int render_started = 0;
+
+static log_t sid_render_log = LOG_DEFAULT;
+
+static sid_render_chip_t *sid_render_find(sound_t *psid)
+{
+    int i;
+
+    for (i = 0; i < SOUND_SIDS_MAX; i++) {
+        if (chips[i].psid == psid) {
+            return &chips[i];
+        }
+    }
+    return NULL;
+}
+
+/* apply the queued writes without rendering */
+static void sid_render_flush(sid_render_chip_t *chip)
+{
+    unsigned int i;
+
+    for (i = 0; i < chip->count; i++) {
+        render_engine->store(chip->psid, chip->writes[i].addr, chip->writes[i].byte);
+    }
+    chip->count = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#ifdef SID_RENDER_THREADED
+/* all chips are rendered up to render_clk */
+static CLOCK render_clk;
+/* the clock the sound code asked for samples the last time */
+static CLOCK render_seen;
+/* the clock sid_render_chip() renders up to */
+static CLOCK render_end;
+
+static pthread_t pool[SID_RENDER_THREADS_MAX];
+static int pool_size = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static unsigned int pool_generation = 0;
+static int pool_next = 0;
+static int pool_jobs = 0;
+static int pool_pending = 0;
+static int pool_quit = 0;
+
+/* render cycles into the chip's buffer, growing it as needed */
+static void sid_render_cycles(sid_render_chip_t *chip, CLOCK cycles)
+{
+    CLOCK delta_t = cycles;
+    int nr;
+
+    while (delta_t > 0) {
+        if (chip->nr == chip->blen) {
+            chip->blen = chip->blen ? chip->blen * 2 : 1024;
+            chip->buf = lib_realloc(chip->buf, chip->blen * sizeof(int16_t));
+        }
+        nr = render_engine->calculate_samples(chip->psid, chip->buf + chip->nr, chip->blen - chip->nr, SOUND_OUTPUT_MONO, &delta_t);
+        chip->nr += nr;
+        if (nr == 0 && chip->nr < chip->blen) {
+            /* the engine didn't take the cycles, don't spin on it */
+            break;
+        }
+    }
+}
+
+/* render the chip from render_clk to render_end, playing its queued writes */
+static void sid_render_chip(sid_render_chip_t *chip)
+{
+    CLOCK clk = render_clk;
+    unsigned int i;
+
+    for (i = 0; i < chip->count; i++) {
+        sid_render_write_t *w = &chip->writes[i];
+
+        if (w->clk > clk) {
+            sid_render_cycles(chip, w->clk - clk);
+            clk = w->clk;
+        }
+        render_engine->store(chip->psid, w->addr, w->byte);
+    }
+    chip->count = 0;
+
+    if (render_end > clk) {
+        sid_render_cycles(chip, render_end - clk);
+    }
+}
+
+/* take jobs until none are left, called with pool_lock held */
+static void sid_render_take_jobs(void)
+{
+    while (pool_next < pool_jobs) {
+        int job = pool_next++;
+
+        pthread_mutex_unlock(&pool_lock);
+        sid_render_chip(&chips[job]);
+        pthread_mutex_lock(&pool_lock);
+        if (--pool_pending == 0) {
+            pthread_cond_signal(&pool_done);
+        }
+    }
+}
+
+static void *sid_render_thread(void *param)
+{
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    while (1) {
+        while (generation == pool_generation && !pool_quit) {
+            pthread_cond_wait(&pool_work, &pool_lock);
+        }
+        if (pool_quit) {
+            break;
+        }
+        generation = pool_generation;
+        sid_render_take_jobs();
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    return NULL;
+}
+
+static void sid_render_pool_start(void)
+{
+    pool_quit = 0;
+    while (pool_size < render_threads - 1) {
+        if (pthread_create(&pool[pool_size], NULL, sid_render_thread, NULL) != 0) {
+            log_warning(sid_render_log, "Could not start render thread %d.", pool_size + 1);
+            break;
+        }
+        pool_size++;
+    }
+}
+
+static void sid_render_pool_stop(void)
+{
+    int i;
+
+    if (pool_size == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    pool_quit = 1;
+    pthread_cond_broadcast(&pool_work);
+    pthread_mutex_unlock(&pool_lock);
+
+    for (i = 0; i < pool_size; i++) {
+        pthread_join(pool[i], NULL);
+    }
+    pool_size = 0;
+}
+
+/* render all chips up to end, on the pool and on this thread */
+static void sid_render_all(CLOCK end)
+{
+    if (pool_size == 0) {
+        sid_render_pool_start();
+    }
+
+    render_end = end;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_next = 0;
+    pool_jobs = render_chips;
+    pool_pending = render_chips;
+    pool_generation++;
+    pthread_cond_broadcast(&pool_work);
+
+    sid_render_take_jobs();
+    while (pool_pending > 0) {
+        pthread_cond_wait(&pool_done, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    render_clk = end;
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+
+/** \brief  Set the number of threads rendering SIDs, the emulation thread
+ *          included
+ *
+ * Takes effect when the sound chips are opened the next time.
+ *
+ * \param[in]   threads     1 to render on the emulation thread only
+ *
+ * \return  0 on success, -1 if \a threads is out of range
+ */
+int sid_render_set_threads(int threads)
+{
+    if (threads < 1 || threads > SID_RENDER_THREADS_MAX) {
+        return -1;
+    }
+    render_threads = threads;
+    return 0;
+}
+
+/** \brief  Register a chip opened by a cycle based engine
+ *
+ * Writes are queued once more than one chip is registered and more than one
+ * render thread is configured. The engine must render different chips
+ * independently.
+ *
+ * \param[in]   chipno  chip number
+ * \param[in]   psid    the engine's chip
+ * \param[in]   engine  the engine
+ */
+void sid_render_chip_open(int chipno, sound_t *psid, const sid_engine_t *engine)
+{
+#ifdef SID_RENDER_THREADED
+    int raw_output = 0;
+
+    if (sid_render_log == LOG_DEFAULT) {
+        sid_render_log = log_open("SIDRender");
+    }
+
+    chips[chipno].psid = psid;
+    chips[chipno].count = 0;
+    chips[chipno].nr = 0;
+    if (chipno >= render_chips) {
+        render_chips = chipno + 1;
+    }
+    render_engine = engine;
+    render_started = 0;
+
+    /* the raw output debug file of reSID is shared by all chips */
+    resources_get_int("SidResidEnableRawOutput", &raw_output);
+
+    if (render_threads > 1 && render_chips > 1 && !raw_output && !render_active) {
+        render_active = 1;
+        log_message(sid_render_log, "Rendering the SIDs on %d threads.", render_threads);
+    }
+#endif
+}
+
+/** \brief  Unregister a chip, its queued writes are dropped
+ *
+ * \param[in]   psid    the engine's chip
+ */
+void sid_render_chip_close(sound_t *psid)
+{
+    sid_render_chip_t *chip = sid_render_find(psid);
+
+    if (chip == NULL) {
+        return;
+    }
+
+    chip->psid = NULL;
+    chip->count = 0;
+    chip->nr = 0;
+    lib_free(chip->writes);
+    chip->writes = NULL;
+    chip->size = 0;
+    lib_free(chip->buf);
+    chip->buf = NULL;
+    chip->blen = 0;
+
+    while (render_chips > 0 && chips[render_chips - 1].psid == NULL) {
+        render_chips--;
+    }
+
+    if (render_chips == 0) {
+#ifdef SID_RENDER_THREADED
+        sid_render_pool_stop();
+#endif
+        render_active = 0;
+        render_started = 0;
+    }
+}
+
+/** \brief  Are writes queued instead of rendering up to each write
+ *
+ * \return  boolean
+ */
+int sid_render_active(void)
+{
+    return render_active;
+}
+
+/** \brief  Queue a write for the chip at the current clock
+ *
+ * \param[in]   psid    the engine's chip
+ * \param[in]   addr    register
+ * \param[in]   byte    value
+ */
+void sid_render_store(sound_t *psid, uint16_t addr, uint8_t byte)
+{
+    sid_render_chip_t *chip = sid_render_find(psid);
+
+    if (chip == NULL) {
+        render_engine->store(psid, addr, byte);
+        return;
+    }
+
+    if (chip->count == chip->size) {
+        if (chip->size == SID_RENDER_QUEUE_MAX) {
+            /* nothing renders, e.g. in warp without sound emulation */
+            sid_render_flush(chip);
+        } else {
+            chip->size = chip->size ? chip->size * 2 : 256;
+            chip->writes = lib_realloc(chip->writes, chip->size * sizeof(sid_render_write_t));
+        }
+    }
+
+    chip->writes[chip->count].clk = maincpu_clk;
+    chip->writes[chip->count].addr = addr;
+    chip->writes[chip->count].byte = byte;
+    chip->count++;
+}
+
+/** \brief  Bring the chip up to the current clock
+ *
+ * All chips are rendered so they stay in step.
+ *
+ * \param[in]   psid    the engine's chip
+ */
+void sid_render_sync(sound_t *psid)
+{
+    sid_render_chip_t *chip = sid_render_find(psid);
+
+    if (chip == NULL) {
+        return;
+    }
+
+    if (!render_started) {
+        sid_render_flush(chip);
+        return;
+    }
+
+#ifdef SID_RENDER_THREADED
+    if (maincpu_clk > render_clk) {
+        sid_render_all(maincpu_clk);
+    }
+#endif
+}
+
+/** \brief  Drop the writes and the samples kept for the chip
+ *
+ * \param[in]   psid    the engine's chip
+ */
+void sid_render_reset(sound_t *psid)
+{
+    sid_render_chip_t *chip = sid_render_find(psid);
+
+    if (chip != NULL) {
+        chip->count = 0;
+        chip->nr = 0;
+        render_started = 0;
+    }
+}
+
+#ifndef SOUND_SYSTEM_FLOAT
+/** \brief  Render all chips up to the current clock if a batch is due, and
+ *          mix the samples kept so far
+ *
+ * Same output layout as sid_sound_machine_calculate_samples(): mixed for
+ * mono, and for stereo the even chips go left, the odd ones right and the
+ * last of an odd number of chips to both. Samples that don't fit are kept
+ * for the next call.
+ *
+ * \param[in]       psid        the chips
+ * \param[out]      pbuf        output, \a soc interleaved channels
+ * \param[in]       nr          room in \a pbuf in samples per channel
+ * \param[in]       soc         sound output channels
+ * \param[in]       scc         sound chip channels, number of chips
+ * \param[in,out]   delta_t     cycles since the last call, always set to 0
+ *
+ * \return  samples mixed into \a pbuf per channel
+ */
+int sid_render_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, int soc, int scc, CLOCK *delta_t)
+{
+    int c, i, n;
+
+#ifdef SID_RENDER_THREADED
+    CLOCK start = maincpu_clk - *delta_t;
+
+    if (!render_started || start != render_seen) {
+        /* first call, or the sound code skipped some time */
+        for (c = 0; c < render_chips; c++) {
+            sid_render_flush(&chips[c]);
+        }
+        render_clk = start;
+        render_started = 1;
+    }
+    render_seen = maincpu_clk;
+
+    if (maincpu_clk - render_clk >= SID_RENDER_BATCH_CYCLES) {
+        sid_render_all(maincpu_clk);
+    }
+#endif
+    *delta_t = 0;
+
+    n = nr;
+    for (c = 0; c < scc; c++) {
+        if (chips[c].nr < n) {
+            n = chips[c].nr;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    if (soc != SOUND_OUTPUT_MONO && soc != SOUND_OUTPUT_STEREO) {
+        /* no output channels, e.g. the dummy device */
+        for (c = 0; c < scc; c++) {
+            chips[c].nr = 0;
+        }
+        return 0;
+    }
+
+    if (soc == SOUND_OUTPUT_MONO) {
+        memcpy(pbuf, chips[0].buf, n * sizeof(int16_t));
+        for (c = 1; c < scc; c++) {
+            for (i = 0; i < n; i++) {
+                pbuf[i] = sound_audio_mix(pbuf[i], chips[c].buf[i]);
+            }
+        }
+    } else {
+        for (i = 0; i < n; i++) {
+            pbuf[i * 2] = chips[0].buf[i];
+            pbuf[(i * 2) + 1] = (scc == 1) ? chips[0].buf[i] : chips[1].buf[i];
+        }
+        for (c = 2; c < scc; c++) {
+            int16_t *buf = chips[c].buf;
+
+            if ((scc & 1) && c == scc - 1) {
+                for (i = 0; i < n; i++) {
+                    pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], buf[i]);
+                    pbuf[(i * 2) + 1] = sound_audio_mix(pbuf[(i * 2) + 1], buf[i]);
+                }
+            } else {
+                int side = c & 1;
+
+                for (i = 0; i < n; i++) {
+                    pbuf[(i * 2) + side] = sound_audio_mix(pbuf[(i * 2) + side], buf[i]);
+                }
+            }
+        }
+    }
+
+    for (c = 0; c < scc; c++) {
+        chips[c].nr -= n;
+        memmove(chips[c].buf, chips[c].buf + n, chips[c].nr * sizeof(int16_t));
+    }
+
+    return n;
+}
+#endif
@@ -0,0 +1,50 @@
+/** \file   sid-render.h
+ * \brief   Render multiple SIDs on worker threads - header
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_SID_RENDER_H
+#define VICE_SID_RENDER_H
+
+#include "sid.h"
+#include "sound.h"
+#include "types.h"
+
+/* most threads rendering at the same time, the emulation thread included */
+#define SID_RENDER_THREADS_MAX  SOUND_SIDS_MAX
+
+int sid_render_set_threads(int threads);
+
+void sid_render_chip_open(int chipno, sound_t *psid, const sid_engine_t *engine);
+void sid_render_chip_close(sound_t *psid);
+int sid_render_active(void);
+
+void sid_render_store(sound_t *psid, uint16_t addr, uint8_t byte);
+void sid_render_sync(sound_t *psid);
+void sid_render_reset(sound_t *psid);
+
+#ifndef SOUND_SYSTEM_FLOAT
+int sid_render_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, int soc, int scc, CLOCK *delta_t);
+#endif
+
+#endif
@@ -42,6 +42,7 @@
 #include "usbsid.h"
 #endif
 #include "resources.h"
+#include "sid-render.h"
 #include "sid-resources.h"
 #include "sid.h"
 #include "sound.h"
@@ -83,6 +84,7 @@ unsigned int sid7_address_end;
 unsigned int sid8_address_start;
 unsigned int sid8_address_end;
 static int sid_engine;
+static int sid_render_threads;
 #ifdef HAVE_HARDSID
 static int sid_hardsid_main;
 static int sid_hardsid_right;
@@ -127,6 +129,7 @@ static int set_sid_engine(int set_engine, void *param)
 #ifdef HAVE_USBSID
         case SID_ENGINE_USBSID:
 #endif
+        case SID_ENGINE_REGSID:
             break;
         default:
             return -1;
@@ -188,6 +191,18 @@ static int set_sid_stereo(int val, void *param)
     return 0;
 }
 
+static int set_sid_render_threads(int val, void *param)
+{
+    if (sid_render_set_threads(val < 1 ? 1 : val) < 0) {
+        return -1;
+    }
+    if (val != sid_render_threads) {
+        sid_render_threads = val;
+        sound_state_changed = 1;
+    }
+    return 0;
+}
+
 #define SET_SIDx_ADDRESS(sid_nr)                                        \
     int sid_set_sid##sid_nr##_address(int val, void *param)             \
     {                                                                   \
@@ -258,6 +273,7 @@ static int set_sid_resid_sampling(int val, void *param)
         case SID_RESID_SAMPLING_INTERPOLATION:
         case SID_RESID_SAMPLING_RESAMPLING:
         case SID_RESID_SAMPLING_FAST_RESAMPLING:
+        case SID_RESID_SAMPLING_TWOSTAGE_RESAMPLING:
             break;
         default:
             return -1;
@@ -502,6 +518,8 @@ static const resource_int_t usbsid_resources_int[] = {
 static const resource_int_t stereo_resources_int[] = {
     { "SidStereo", 0, RES_EVENT_SAME, NULL,
       &sid_stereo, set_sid_stereo, NULL },
+    { "SidRenderThreads", 0, RES_EVENT_NO, NULL,
+      &sid_render_threads, set_sid_render_threads, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -639,6 +657,12 @@ static sid_engine_model_t sid_engine_models_usbsid[] = {
 };
 #endif
 
+static sid_engine_model_t sid_engine_models_regsid[] = {
+    { "6581 (registers only)", SID_REGSID_6581 },
+    { "8580 (registers only)", SID_REGSID_8580 },
+    { NULL, -1 }
+};
+
 static void add_sid_engine_models(sid_engine_model_t *sid_engine_models)
 {
     int i = 0;
@@ -693,6 +717,8 @@ sid_engine_model_t **sid_get_engine_model_list(void)
     }
 #endif
 
+    add_sid_engine_models(sid_engine_models_regsid);
+
     sid_engine_model_list[num_sid_engine_models] = NULL;
 
     return sid_engine_model_list;
@@ -721,6 +747,8 @@ static int sid_check_engine_model(int engine, int model)
         case SID_RESID_8580:
         case SID_RESID_8580D:
 #endif
+        case SID_REGSID_6581:
+        case SID_REGSID_8580:
             return 0;
 #ifdef HAVE_RESID_DTV
         case SID_RESID_DTVSID:
@@ -650,9 +650,11 @@ static int sid_snapshot_read_fastsid_module(snapshot_module_t *m, int sidnr)
    BYTE  | write pipeline             | write pipeline
    BYTE  | write address              | write address
    BYTE  | voice mask                 | voice mask
+
+   The register-only engine uses the same format, with only the voice 3
+   oscillator and envelope state filled in.
  */
 
-#ifdef HAVE_RESID
 static int sid_snapshot_write_resid_module(snapshot_module_t *m, int sidnr)
 {
     sid_snapshot_state_t sid_state;
@@ -733,7 +735,6 @@ static int sid_snapshot_read_resid_module(snapshot_module_t *m, int sidnr)
 
     return 0;
 }
-#endif
 
 /* ---------------------------------------------------------------------*/
 
@@ -979,6 +980,11 @@ static int sid_snapshot_write_module_extended(snapshot_t *s, int sidnr)
             }
             break;
 #endif
+        case SID_ENGINE_REGSID:
+            if (sid_snapshot_write_resid_module(m, sidnr) < 0) {
+                goto fail;
+            }
+            break;
 #ifdef HAVE_CATWEASELMKIII
         case SID_ENGINE_CATWEASELMKIII:
             if (sid_snapshot_write_cw3_module(m, sidnr) < 0) {
@@ -1103,6 +1109,11 @@ static int sid_snapshot_read_module_extended(snapshot_t *s, int sidnr)
             }
             break;
 #endif
+        case SID_ENGINE_REGSID:
+            if (sid_snapshot_read_resid_module(m, sidnr) < 0) {
+                goto fail;
+            }
+            break;
 #ifdef HAVE_CATWEASELMKIII
         case SID_ENGINE_CATWEASELMKIII:
             if (sid_snapshot_read_cw3_module(m, sidnr) < 0) {
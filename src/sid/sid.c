@@ -44,7 +44,9 @@
 #include "machine.h"
 #include "maincpu.h"
 #include "parsid.h"
+#include "regsid.h"
 #include "resources.h"
+#include "sid-render.h"
 #include "sid-resources.h"
 #include "sid-snapshot.h"
 #include "sid.h"
@@ -148,6 +150,19 @@ static void sid_write_off(uint16_t addr, uint8_t val, int chipno)
 {
 }
 
+#ifdef HAVE_RESID
+/* while the SIDs are rendered on threads writes are queued with their clock,
+   so nothing needs to be rendered before the write */
+static void sid_sound_store(uint16_t addr, uint8_t val, int chipno)
+{
+    if (sid_render_active()) {
+        sound_store_deferred(addr, val, chipno);
+    } else {
+        sound_store(addr, val, chipno);
+    }
+}
+#endif
+
 /* ------------------------------------------------------------------------- */
 
 /* FIXME: we should really use an alarm to update the POT values every 512
@@ -563,6 +578,11 @@ bool sid_sound_machine_set_engine_hooks(void)
         sid_engine = resid_hooks;
     }
 #endif
+
+    if (sidengine == SID_ENGINE_REGSID) {
+        sid_engine = regsid_hooks;
+    }
+
     if (sidengine >= 0) {
         return true;
     }
@@ -571,11 +591,17 @@ bool sid_sound_machine_set_engine_hooks(void)
 
 sound_t *sid_sound_machine_open(int chipno)
 {
+    sound_t *psid;
+
     if (!sid_sound_machine_set_engine_hooks()) {
         return NULL;
     }
 
-    return sid_engine.open(siddata[chipno]);
+    psid = sid_engine.open(siddata[chipno]);
+    if (psid != NULL && sid_sound_machine_cycle_based()) {
+        sid_render_chip_open(chipno, psid, &sid_engine);
+    }
+    return psid;
 }
 
 /* manage temporary buffers. if the requested size is smaller or equal to the
@@ -637,6 +663,7 @@ int sid_sound_machine_init(sound_t *psid, int speed, int cycles_per_sec)
 
 void sid_sound_machine_close(sound_t *psid)
 {
+    sid_render_chip_close(psid);
     sid_engine.close(psid);
 #ifndef SOUND_SYSTEM_FLOAT
     /* free the temp. buffers */
@@ -683,16 +710,22 @@ void sid_sound_machine_close(sound_t *psid)
 
 uint8_t sid_sound_machine_read(sound_t *psid, uint16_t addr)
 {
+    sid_render_sync(psid);
     return sid_engine.read(psid, addr);
 }
 
 void sid_sound_machine_store(sound_t *psid, uint16_t addr, uint8_t byte)
 {
+    if (sid_render_active()) {
+        sid_render_store(psid, addr, byte);
+        return;
+    }
     sid_engine.store(psid, addr, byte);
 }
 
 void sid_sound_machine_reset(sound_t *psid, CLOCK cpu_clk)
 {
+    sid_render_reset(psid);
     sid_engine.reset(psid, cpu_clk);
     #ifdef HAVE_USBSID
     usbsid_reset(true); /* This is called when the STOP button is pressed */
@@ -719,6 +752,10 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     int tmp_nr = 0;
     CLOCK tmp_delta_t = *delta_t;
 
+    if (sid_render_active()) {
+        return sid_render_calculate_samples(psid, pbuf, nr, soc, scc, delta_t);
+    }
+
     if (soc == SOUND_OUTPUT_MONO && scc == SOUND_1_DEVICE) {
         return sid_engine.calculate_samples(psid[0], pbuf, nr, SOUND_OUTPUT_MONO, delta_t);
     }
@@ -1001,6 +1038,7 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
 
 char *sid_sound_machine_dump_state(sound_t *psid)
 {
+    sid_render_sync(psid);
     return sid_engine.dump_state(psid);
 }
 
@@ -1031,6 +1069,8 @@ int sid_sound_machine_cycle_based(void)
         case SID_ENGINE_USBSID:
             return 0;
 #endif
+        case SID_ENGINE_REGSID:
+            return 0;
     }
 
     return 0;
@@ -1056,10 +1096,15 @@ static void set_sound_func(void)
 #ifdef HAVE_RESID
         if (sid_engine_type == SID_ENGINE_RESID) {
             sid_read_func = sound_read;
-            sid_store_func = sound_store;
+            sid_store_func = sid_sound_store;
             sid_dump_func = sound_dump;
         }
 #endif
+        if (sid_engine_type == SID_ENGINE_REGSID) {
+            sid_read_func = sound_read;
+            sid_store_func = sound_store;
+            sid_dump_func = sound_dump;
+        }
 #ifdef HAVE_CATWEASELMKIII
         if (sid_engine_type == SID_ENGINE_CATWEASELMKIII) {
             sid_read_func = catweaselmkiii_read;
@@ -1165,6 +1210,7 @@ int sid_engine_set(int engine)
 
 void sid_state_read(unsigned int channel, sid_snapshot_state_t *sid_state)
 {
+    sid_render_sync(sound_get_psid(channel));
     sid_engine.state_read(sound_get_psid(channel), sid_state);
 }
 
@@ -1179,6 +1225,7 @@ void sid_state_write(unsigned int channel, sid_snapshot_state_t *sid_state)
             fprintf(stderr, "%s:%d:%s(): sound_get_psid() returned NULL\n",
                     __FILE__, __LINE__, __func__);
         } else {
+            sid_render_reset(psid);
             sid_engine.state_write(psid, sid_state);
         }
     }
@@ -1224,6 +1271,8 @@ int sid_engine_get_max_sids(int engine)
 #endif
         case SID_ENGINE_USBSID:
             return SID_ENGINE_USBSID_NUM_SIDS;
+        case SID_ENGINE_REGSID:
+            return SID_ENGINE_REGSID_NUM_SIDS;
         default:
             /* unknow engine */
             return -1;
@@ -45,7 +45,8 @@ enum {
     SID_ENGINE_CATWEASELMKIII,
     SID_ENGINE_HARDSID,
     SID_ENGINE_PARSID,
-    SID_ENGINE_USBSID = 7
+    SID_ENGINE_USBSID = 7,
+    SID_ENGINE_REGSID
 };
 
 #define SID_ENGINE_DEFAULT       99
@@ -71,11 +72,15 @@ enum {
 /** \brief  Maximum number of supported SIDs for the USBSID engine */
 #define SID_ENGINE_USBSID_NUM_SIDS          4
 
+/** \brief  Maximum number of supported SIDs for the register-only engine */
+#define SID_ENGINE_REGSID_NUM_SIDS          8
+
 enum {
     SID_RESID_SAMPLING_FAST = 0,
     SID_RESID_SAMPLING_INTERPOLATION,
     SID_RESID_SAMPLING_RESAMPLING,
-    SID_RESID_SAMPLING_FAST_RESAMPLING
+    SID_RESID_SAMPLING_FAST_RESAMPLING,
+    SID_RESID_SAMPLING_TWOSTAGE_RESAMPLING
 };
 
 enum {
@@ -100,6 +105,8 @@ enum {
 #define SID_HARDSID               (SID_ENGINE_HARDSID << 8)
 #define SID_PARSID                (SID_ENGINE_PARSID << 8)
 #define SID_USBSID                (SID_ENGINE_USBSID << 8)
+#define SID_REGSID_6581           ((SID_ENGINE_REGSID << 8) | SID_MODEL_6581)
+#define SID_REGSID_8580           ((SID_ENGINE_REGSID << 8) | SID_MODEL_8580)
 
 #define SIDTYPE_SID       0
 #define SIDTYPE_SIDDTV    1
@@ -524,6 +524,48 @@ vice_network_socket_t * vice_network_client(const vice_network_socket_address_t
     return sockfd == INVALID_SOCKET ? NULL : vice_network_alloc_new_socket(sockfd);
 }
 
+/*! \brief Check whether a server is listening on an address
+
+  Used before a server replaces a socket file that may have been left
+  behind, to tell a dead server from one that is running.
+
+  \param server_address
+     The address to connect to
+
+  \return
+     1 if a server accepted the connection; 0 if the connection was
+     refused, and -1 if that could not be determined.
+*/
+int vice_network_server_is_listening(const vice_network_socket_address_t * server_address)
+{
+    int sockfd;
+    int result;
+
+    assert(server_address != NULL);
+
+    if (socket_init() < 0) {
+        return -1;
+    }
+
+    sockfd = (int)socket(server_address->domain, SOCK_STREAM, server_address->protocol);
+    if (sockfd == INVALID_SOCKET) {
+        return -1;
+    }
+
+    if (connect(sockfd, &server_address->address.generic, server_address->len) == 0) {
+        result = 1;
+    } else {
+#ifdef WINDOWS_COMPILE
+        result = (ARCHDEP_SOCKET_ERROR == WSAECONNREFUSED) ? 0 : -1;
+#else
+        result = (ARCHDEP_SOCKET_ERROR == ECONNREFUSED) ? 0 : -1;
+#endif
+    }
+    closesocket(sockfd);
+
+    return result;
+}
+
 /*! \internal \brief Generate an IPv4 socket address
 
   Initialises a socket address with an IPv4 address.
@@ -753,7 +795,6 @@ static int vice_network_address_generate_ipv6(vice_network_socket_address_t * so
 #endif /* #ifdef HAVE_IPV6 */
 }
 
-#if 0
 /*! \internal \brief Generate a unix domain socket address
 
   Initialises a socket address with a unix domain socket address
@@ -812,7 +853,6 @@ static int vice_network_address_generate_local(vice_network_socket_address_t * s
     return -1;
 #endif /* #ifdef HAVE_UNIX_DOMAIN_SOCKETS */
 }
-#endif
 
 /*! \brief Generate a socket address
 
@@ -835,8 +875,8 @@ static int vice_network_address_generate_local(vice_network_socket_address_t * s
      NULL in case of an error.
 
   \remark
-     If address_string starts with a pipe ('|'), then the
-     address_string is treated as a unix domain socket.
+     If address_string starts with unix://, then the rest of
+     address_string is the path of a unix domain socket.
      Otherwise, address_string can be prepended with ip6://
      or ip4://, in which case address_string is treated
      exactly as an IPv6 or IPv4 address, respectively.
@@ -855,15 +895,11 @@ vice_network_socket_address_t * vice_network_address_generate(const char * addre
         if (socket_address == NULL) {
             break;
         }
-#if 0 /* FIXME: "|" as first character indicates that we want to pipe through an external process - if we
-                want to support unix domain socket, this has to use another syntax! */
-        if (address_string && address_string[0] == '|') {
-            if (vice_network_address_generate_local(socket_address, &address_string[1])) {
+        if (address_string && strncmp("unix://", address_string, sizeof "unix://" - 1) == 0) {
+            if (vice_network_address_generate_local(socket_address, &address_string[sizeof "unix://" - 1])) {
                 break;
             }
-        } else
-#endif
-        if (address_string && strncmp("ip6://", address_string, sizeof "ip6://" - 1) == 0) {
+        } else if (address_string && strncmp("ip6://", address_string, sizeof "ip6://" - 1) == 0) {
             if (vice_network_address_generate_ipv6(socket_address, &address_string[sizeof "ip6://" - 1], port)) {
                 break;
             }
@@ -1014,6 +1050,94 @@ ssize_t vice_network_send(vice_network_socket_t *sockfd,
     return ret;
 }
 
+/*! \brief Send data from several buffers on a connected socket without blocking
+
+  Like vice_network_send(), but gathers the data from several buffers with
+  a single system call and sends only what the socket takes right away,
+  for a peer that must not be able to stall the emulator by not reading.
+
+  \param sockfd
+     The connected socket to send to
+
+  \param buffers
+     The buffers which hold the data to send, in order
+
+  \param count
+     The number of buffers, at most VICE_NETWORK_MAX_BUFFERS
+
+  \return
+     the number of bytes send, 0 if the socket can't take any data right
+     now, or -1 on error.
+*/
+ssize_t vice_network_sendv_nonblocking(vice_network_socket_t        *sockfd,
+                                       const vice_network_buffer_t *buffers,
+                                       unsigned int                 count)
+{
+    ssize_t ret;
+    int error;
+    unsigned int i;
+
+    assert(count <= VICE_NETWORK_MAX_BUFFERS);
+
+    signals_pipe_set();
+#if defined(MSG_DONTWAIT)
+    {
+        struct iovec iov[VICE_NETWORK_MAX_BUFFERS];
+        struct msghdr msg;
+
+        for (i = 0; i < count; i++) {
+            iov[i].iov_base = (void *)buffers[i].data;
+            iov[i].iov_len = buffers[i].length;
+        }
+        memset(&msg, 0, sizeof msg);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        ret = sendmsg(sockfd->sockfd, &msg, MSG_DONTWAIT);
+        error = ARCHDEP_SOCKET_ERROR;
+        if (ret < 0 && (error == EAGAIN || error == EWOULDBLOCK)) {
+            ret = 0;
+        }
+    }
+#elif defined(WINDOWS_COMPILE)
+    {
+        WSABUF wsabuf[VICE_NETWORK_MAX_BUFFERS];
+        DWORD sent = 0;
+        u_long mode = 1;
+
+        for (i = 0; i < count; i++) {
+            wsabuf[i].buf = (char *)buffers[i].data;
+            wsabuf[i].len = (ULONG)buffers[i].length;
+        }
+
+        ioctlsocket(sockfd->sockfd, FIONBIO, &mode);
+        ret = (WSASend(sockfd->sockfd, wsabuf, count, &sent, 0, NULL, NULL) == 0) ? (ssize_t)sent : -1;
+        error = ARCHDEP_SOCKET_ERROR;
+        mode = 0;
+        ioctlsocket(sockfd->sockfd, FIONBIO, &mode);
+        if (ret < 0 && error == WSAEWOULDBLOCK) {
+            ret = 0;
+        }
+    }
+#else
+    /* no way to not block, send it all */
+    ret = 0;
+    for (i = 0; i < count; i++) {
+        ssize_t sent = send(sockfd->sockfd, buffers[i].data, buffers[i].length, 0);
+        if (sent < 0) {
+            ret = -1;
+            break;
+        }
+        ret += sent;
+    }
+    error = 0;
+#endif
+    signals_pipe_unset();
+
+    (void)error;
+    return ret;
+}
+
 /*! \brief Receive data from a connected socket
 
   This function receives incoming data from a connected socket.
@@ -1080,6 +1204,60 @@ int vice_network_select_poll_one(vice_network_socket_t * readsockfd)
     return select( readsockfd->sockfd + 1, &fdsockset, NULL, NULL, &timeout);
 }
 
+/*! \brief Wait a limited time for a socket to have incoming data
+
+  \param readsockfd
+     The connected socket to wait for
+
+  \param timeout_us
+     Maximum time to wait, in microseconds
+
+  \return
+     1 if the specified socket has data; 0 if it does not contain
+     any data after the timeout, and -1 in case of an error.
+*/
+int vice_network_select_wait_one(vice_network_socket_t * readsockfd, unsigned long timeout_us)
+{
+    TIMEVAL timeout;
+
+    fd_set fdsockset;
+
+    timeout.tv_sec = (long)(timeout_us / 1000000);
+    timeout.tv_usec = (long)(timeout_us % 1000000);
+
+    FD_ZERO(&fdsockset);
+    FD_SET(readsockfd->sockfd, &fdsockset);
+
+    return select( readsockfd->sockfd + 1, &fdsockset, NULL, NULL, &timeout);
+}
+
+/*! \brief Wait a limited time for a socket to take outgoing data
+
+  \param writesockfd
+     The connected socket to wait for
+
+  \param timeout_us
+     Maximum time to wait, in microseconds
+
+  \return
+     1 if the specified socket can take data; 0 if it can not after the
+     timeout, and -1 in case of an error.
+*/
+int vice_network_select_wait_writable(vice_network_socket_t * writesockfd, unsigned long timeout_us)
+{
+    TIMEVAL timeout;
+
+    fd_set fdsockset;
+
+    timeout.tv_sec = (long)(timeout_us / 1000000);
+    timeout.tv_usec = (long)(timeout_us % 1000000);
+
+    FD_ZERO(&fdsockset);
+    FD_SET(writesockfd->sockfd, &fdsockset);
+
+    return select( writesockfd->sockfd + 1, NULL, &fdsockset, NULL, &timeout);
+}
+
 /*! \brief Monitor multiple sockets
 
   This function blocks for many different connections and returns when any
@@ -1093,10 +1271,32 @@ int vice_network_select_poll_one(vice_network_socket_t * readsockfd)
      any data, and -1 in case of an error.
 */
 int vice_network_select_multiple(vice_network_socket_t ** readsockfd)
+{
+    return vice_network_select_multiple_writable(readsockfd, NULL);
+}
+
+/*! \brief Monitor multiple sockets for data and for room to send
+
+  Like vice_network_select_multiple(), but also returns when any of the
+  sockets in the second list can take data.
+
+  \param readsockfd
+     NULL terminated list of sockets to monitor for data
+
+  \param writesockfd
+     NULL terminated list of sockets to monitor for room to send, or NULL
+
+  \return
+     the number of ready sockets; 0 if none is ready after 250ms, and -1
+     in case of an error.
+*/
+int vice_network_select_multiple_writable(vice_network_socket_t ** readsockfd, vice_network_socket_t ** writesockfd)
 {
     fd_set fdsockset;
+    fd_set fdwritesockset;
     SOCKET max_sockfd = INVALID_SOCKET;
     TIMEVAL time = {0, 250000};
+    int writing = 0;
 
     FD_ZERO(&fdsockset);
     while(*readsockfd != NULL) {
@@ -1107,11 +1307,21 @@ int vice_network_select_multiple(vice_network_socket_t ** readsockfd)
         readsockfd++;
     }
 
+    FD_ZERO(&fdwritesockset);
+    while(writesockfd != NULL && *writesockfd != NULL) {
+        FD_SET((*writesockfd)->sockfd, &fdwritesockset);
+        if((*writesockfd)->sockfd > max_sockfd) {
+            max_sockfd = (*writesockfd)->sockfd;
+        }
+        writing = 1;
+        writesockfd++;
+    }
+
     if(max_sockfd == INVALID_SOCKET) {
         return -1;
     }
 
-    return select(max_sockfd + 1, &fdsockset, NULL, NULL, &time);
+    return select(max_sockfd + 1, &fdsockset, writing ? &fdwritesockset : NULL, NULL, &time);
 }
 
 /*! \brief Get the error of the last socket operation
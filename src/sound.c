@@ -53,6 +53,7 @@
 #include "monitor.h"
 #include "resources.h"
 #include "sound.h"
+#include "soundthread.h"
 #include "types.h"
 #include "uiapi.h"
 #include "util.h"
@@ -137,6 +138,7 @@ static const sound_register_devices_t sound_register_devices[] = {
        rewritten somehow, so it can be used while actually playing sound, ie as
        a record device */
     { "dump", "Sound chip write recording", sound_init_dump_device, SOUND_PLAYBACK_DEVICE },
+    { "sidstream", "Binary sound chip write stream", sound_init_sidstream_device, SOUND_PLAYBACK_DEVICE },
 
     { "fs", "Raw sound recording", sound_init_fs_device, SOUND_RECORD_DEVICE },
     { "wav", "RIFF/WAV sound recording", sound_init_wav_device, SOUND_RECORD_DEVICE },
@@ -549,6 +551,7 @@ static int amp;
 static int fragment_size;
 static int output_option;
 static int sound_emulation_enabled_on_warp;
+static int output_thread_enabled;      /* app_resources.soundOutputThread */
 
 /* divisors for fragment size calculation */
 static const int fragment_divisor[] = {
@@ -612,6 +615,17 @@ static int set_playback_enabled(int value, void *param)
     return 0;
 }
 
+static int set_output_thread_enabled(int value, void *param)
+{
+    int val = value ? 1 : 0;
+
+    if (output_thread_enabled != val) {
+        output_thread_enabled = val;
+        sound_playdev_reopen = TRUE;
+    }
+    return 0;
+}
+
 static int set_sample_rate(int val, void *param)
 {
     if (val <= 0) {
@@ -736,6 +750,8 @@ static const resource_int_t resources_int[] = {
       (void *)&output_option, set_output_option, NULL },
     { "SoundEmulateOnWarp", 1, RES_EVENT_NO, NULL,
       (void *)&sound_emulation_enabled_on_warp, set_sound_emulation_enabled_on_warp, NULL },
+    { "SoundOutputThread", 0, RES_EVENT_NO, NULL,
+      (void *)&output_thread_enabled, set_output_thread_enabled, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -796,6 +812,12 @@ static const cmdline_option_t cmdline_options[] =
     { "-soundwarpmode", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "SoundEmulateOnWarp", NULL,
       "<mode>", "Specify how to handle sound emulation in warp mode: (0: do not emulate the sound chips, 1: keep emulating the sound chips)" },
+    { "-soundthread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundOutputThread", (resource_value_t)1,
+      NULL, "Write to the sound device on a separate thread" },
+    { "+soundthread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "SoundOutputThread", (resource_value_t)0,
+      NULL, "Write to the sound device on the emulation thread" },
     CMDLINE_LIST_END
 };
 
@@ -980,6 +1002,37 @@ static int sound_error_log_only(const char *msg)
 static int16_t *temp_buffer = NULL;
 static int temp_buffer_size = 0;
 
+/* Hand the playback device over to the output thread, see soundthread.c.
+   Only realtime devices are worth it, and nothing is played in warp mode. */
+static void sound_playdev_start_thread(void)
+{
+    if (output_thread_enabled && sound_is_timing_source && !playdev_is_dump
+        && !warp_mode_enabled) {
+        sound_thread_start(snddata.playdev, sample_rate, snddata.fragsize,
+                           snddata.fragnr, snddata.sound_output_channels);
+    }
+}
+
+/* Number of frames the playback device takes now, nr if it blocks */
+static int sound_playdev_bufferspace(int nr)
+{
+    if (sound_thread_is_running()) {
+        return sound_thread_bufferspace();
+    }
+    if (snddata.playdev->bufferspace) {
+        return snddata.playdev->bufferspace();
+    }
+    return nr;
+}
+
+static int sound_playdev_write(int16_t *pbuf, size_t nr)
+{
+    if (sound_thread_is_running()) {
+        return sound_thread_write(pbuf, nr);
+    }
+    return snddata.playdev->write(pbuf, nr);
+}
+
 static int16_t *realloc_buffer(int size)
 {
     if (temp_buffer_size < size) {
@@ -1026,7 +1079,7 @@ static void fill_buffer(int size, int rise)
         }
     }
 
-    i = snddata.playdev->write(p, size * snddata.sound_output_channels);
+    i = sound_playdev_write(p, size * snddata.sound_output_channels);
     if (i) {
         sound_error("write to sound device failed.");
     }
@@ -1229,6 +1282,9 @@ int sound_open(void)
             } else {
                 snddata.sound_output_channels = channels;
             }
+        } else {
+            /* a device without init, like dummy, takes what it gets */
+            snddata.sound_output_channels = channels;
         }
         if (snddata.buffer) {
             lib_free(snddata.buffer);
@@ -1274,6 +1330,8 @@ int sound_open(void)
                 fill_buffer(j, 0);
             }
         }
+
+        sound_playdev_start_thread();
     } else {
         err = lib_msprintf("device '%s' not found or not supported.", playname);
         sound_error(err);
@@ -1333,6 +1391,9 @@ int sound_open(void)
 static void sounddev_close(const sound_device_t **dev)
 {
     if (*dev) {
+        if (dev == &snddata.playdev) {
+            sound_thread_stop(0);
+        }
         log_verbose(sound_log, "Closing device `%s'", (*dev)->name);
         if ((*dev)->close) {
             (*dev)->close();
@@ -1394,8 +1455,9 @@ static int sound_run_sound(void)
         }
     }
 
-    /* if "disable sound emulation on warp" is enabled, exit */
-    if ((sound_emulation_enabled_on_warp == 0) && warp_mode_enabled) {
+    /* if "disable sound emulation on warp" is enabled, exit, unless the
+       samples are recorded */
+    if ((sound_emulation_enabled_on_warp == 0) && warp_mode_enabled && snddata.recdev == NULL) {
         snddata.lastclk = maincpu_clk;
         return 0;
     }
@@ -1537,7 +1599,9 @@ bool sound_flush(void)
         snddata.bufptr = 0;
         goto done;
     }
-    sound_resume();
+    if (!warp_mode_enabled) {
+        sound_resume();
+    }
 
 #if 0
     /* FIXME: This code does not make sense - whatever it is trying to do does
@@ -1572,6 +1636,17 @@ bool sound_flush(void)
         goto done;
     }
 
+    /*
+     * In warp mode nothing is played, but the recording device still gets
+     * every sample so a recording keeps its audio in emulated time.
+     */
+    if (warp_mode_enabled) {
+        if (snddata.recdev->write(snddata.buffer, nr * snddata.sound_output_channels)) {
+            sound_error("write to sound device failed.");
+            goto done;
+        }
+    }
+
     /*
      * At this point we have to block until we have written at least one fragment.
      *
@@ -1580,12 +1655,8 @@ bool sound_flush(void)
 
     while (!warp_mode_enabled) {
 
-        if (snddata.playdev->bufferspace) {
-            space = snddata.playdev->bufferspace();
-        } else {
-            /* We are using a blocking driver like simple pulse - write everything we have. */
-            space = nr;
-        }
+        /* A blocking driver like simple pulse takes everything we have. */
+        space = sound_playdev_bufferspace(nr);
 
         space -= space % snddata.fragsize;
 
@@ -1598,7 +1669,7 @@ bool sound_flush(void)
             mainlock_yield_begin();
 
             /* Flush buffer, all channels are already mixed into it. */
-            if (snddata.playdev->write(snddata.buffer, nr * snddata.sound_output_channels)) {
+            if (sound_playdev_write(snddata.buffer, nr * snddata.sound_output_channels)) {
                 sound_error("write to sound device failed.");
 
                 mainlock_yield_end();
@@ -1657,8 +1728,7 @@ void sound_suspend(void)
     if (snddata.playdev->write && !snddata.issuspended
         && snddata.playdev->need_attenuation) {
         /* fill buffer, but avoid overwriting */
-        if (!snddata.playdev->bufferspace
-            || snddata.playdev->bufferspace() >= snddata.fragsize) {
+        if (sound_playdev_bufferspace(snddata.fragsize) >= snddata.fragsize) {
             fill_buffer(snddata.fragsize, -1);
         } else {
             log_warning(sound_log, "Buffer full during suspend");
@@ -1669,8 +1739,12 @@ void sound_suspend(void)
         }
     }
 
+    /* play what is queued, the thread must not write to a suspended device */
+    sound_thread_stop(1);
+
     if (snddata.playdev->suspend && !snddata.issuspended) {
         if (snddata.playdev->suspend()) {
+            sound_playdev_start_thread();
             return;
         }
     }
@@ -1691,10 +1765,17 @@ void sound_resume(void)
             snddata.issuspended = 0;
         }
 
+        if (!snddata.issuspended) {
+            sound_playdev_start_thread();
+        }
+
         if (snddata.playdev->write && !snddata.issuspended
             && snddata.playdev->need_attenuation) {
             fill_buffer(snddata.fragsize, 1);
         }
+    } else {
+        /* warp mode may have ended without suspending the device */
+        sound_playdev_start_thread();
     }
 }
 
@@ -1773,14 +1854,10 @@ int sound_read(uint16_t addr, int chipno)
     return sound_machine_read(snddata.psid[chipno], addr);
 }
 
-void sound_store(uint16_t addr, uint8_t val, int chipno)
+static void sound_store_chip(uint16_t addr, uint8_t val, int chipno)
 {
     int i;
 
-    if (sound_run_sound()) {
-        return;
-    }
-
     if (chipno >= snddata.sound_chip_channels) {
         return;
     }
@@ -1805,6 +1882,31 @@ void sound_store(uint16_t addr, uint8_t val, int chipno)
     }
 }
 
+void sound_store(uint16_t addr, uint8_t val, int chipno)
+{
+    if (sound_run_sound()) {
+        return;
+    }
+
+    sound_store_chip(addr, val, chipno);
+}
+
+/* Store without rendering the sound chips up to the current clock first,
+   for chips that queue their writes with the clock and render them later
+   (see sid-render.c). */
+void sound_store_deferred(uint16_t addr, uint8_t val, int chipno)
+{
+    if (!playback_enabled) {
+        return;
+    }
+
+    if (!snddata.playdev && sound_open()) {
+        return;
+    }
+
+    sound_store_chip(addr, val, chipno);
+}
+
 
 void sound_set_relative_speed(int value)
 {
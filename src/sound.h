@@ -271,6 +271,7 @@ int sound_init_alsa_device(void);
 int sound_init_asid_device(void);
 int sound_init_dummy_device(void);
 int sound_init_dump_device(void);
+int sound_init_sidstream_device(void);
 int sound_init_fs_device(void);
 int sound_init_wav_device(void);
 int sound_init_sdl_device(void);
@@ -295,6 +296,7 @@ int sound_register_device(const sound_device_t *pdevice);
 /* other internal functions used around sound -code */
 int sound_read(uint16_t addr, int chipno);
 void sound_store(uint16_t addr, uint8_t val, int chipno);
+void sound_store_deferred(uint16_t addr, uint8_t val, int chipno);
 long sound_sample_position(void);
 int sound_dump(int chipno);
 
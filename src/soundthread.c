@@ -0,0 +1,446 @@
+/** \file   soundthread.c
+ * \brief   Play the sound through a ring on a separate thread
+ *
+ * Normally sound_flush() hands every fragment to the write() function of
+ * the playback device on the emulation thread, and that blocks whenever
+ * the buffer of the device is full. With SoundOutputThread the fragments
+ * go into a single-producer/single-consumer ring instead, and a thread of
+ * the playback device takes them out and writes them to the device. The
+ * emulation thread never calls the device then, a device that blocks or
+ * takes long for a write only delays the output thread.
+ *
+ * The ring is lock free: the emulation thread only advances the head and
+ * the output thread only advances the tail, both with release stores that
+ * the other side reads with acquire loads.
+ *
+ * The emulation thread is still paced by the device, it may only fill the
+ * ring up to a latency target and waits in sound_flush() like it did for
+ * the device above that. The target starts at two fragments. Whenever the
+ * device was about to run dry while the ring held less than a fragment,
+ * the output thread counts an underrun and raises the target by one
+ * fragment, up to the size of the ring. After SOUND_THREAD_SETTLE_SECONDS
+ * of playback without one it lowers the target again by one fragment, down
+ * to a single fragment. The counts, the fill level of the ring seen by the
+ * output thread and the target are logged when the thread stops.
+ *
+ * The device callbacks may log from the output thread, log.c serializes
+ * its callers whenever threads are available. The thread itself leaves
+ * logging to the emulation thread: changes of the target and a failed
+ * write are logged the next time it queues samples.
+ *
+ * Without threads sound_thread_start() fails and the device is written
+ * directly.
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(USE_VICE_THREAD) || defined(HAVE_PTHREAD)
+#define SOUND_THREADED
+#include <pthread.h>
+#endif
+
+#include "archdep.h"
+#include "lib.h"
+#include "log.h"
+#include "sound.h"
+#include "soundthread.h"
+#include "types.h"
+
+#ifdef SOUND_THREADED
+
+/* playback without underrun after which the latency target is lowered */
+#define SOUND_THREAD_SETTLE_SECONDS     10
+
+/* values of quit */
+#define SOUND_THREAD_RUN        0
+#define SOUND_THREAD_DRAIN      1
+#define SOUND_THREAD_QUIT       2
+
+static const sound_device_t *device = NULL;
+static int device_speed;
+static int device_fragsize;
+static int device_bufsize;
+static int device_channels;
+
+/* the ring, all sizes and positions are in sample frames */
+static int16_t *ring = NULL;
+static unsigned int ring_size;
+static unsigned int ring_head = 0;      /* written by the emulation thread */
+static unsigned int ring_tail = 0;      /* written by the output thread */
+static unsigned int ring_target;        /* written by the output thread */
+
+static pthread_t thread;
+static int running = 0;
+static int quit = SOUND_THREAD_RUN;
+static int failed = 0;
+
+/* telemetry, only touched by the output thread while it runs */
+static unsigned long stat_fragments;
+static unsigned long stat_writes;
+static unsigned long stat_underruns;
+static unsigned int stat_fill_min;
+static unsigned int stat_fill_max;
+static double stat_fill_sum;
+static unsigned int stat_target_max;
+
+/* frames that did not fit into the ring, counted by the emulation thread */
+static unsigned long stat_dropped;
+
+/* what the emulation thread logged last */
+static unsigned int logged_target;
+static int logged_failed;
+
+static log_t sound_thread_log = LOG_DEFAULT;
+
+
+static double sound_thread_ms(unsigned int frames)
+{
+    return 1000.0 * frames / device_speed;
+}
+
+/* copy frames out of the ring into the device */
+static int sound_thread_play(unsigned int tail, unsigned int frames)
+{
+    unsigned int pos = tail & (ring_size - 1);
+    unsigned int part = ring_size - pos;
+
+    if (part > frames) {
+        part = frames;
+    }
+    if (device->write(ring + pos * device_channels, part * device_channels)) {
+        return -1;
+    }
+    if (part < frames
+        && device->write(ring, (frames - part) * device_channels)) {
+        return -1;
+    }
+    return 0;
+}
+
+/* will the device run out of samples before the next fragment arrives? */
+static int sound_thread_starving(tick_t last_write)
+{
+    double played;
+
+    if (device->bufferspace != NULL) {
+        return device->bufferspace() > device_bufsize - device_fragsize;
+    }
+    /* a blocking device returns from write() with about a full buffer */
+    played = (double)tick_now_delta(last_write) * device_speed / tick_per_second();
+    return played > device_bufsize - device_fragsize;
+}
+
+static void *sound_thread(void *arg)
+{
+    unsigned int tail = ring_tail;
+    unsigned int head;
+    unsigned int fill;
+    unsigned int target;
+    unsigned int frames;
+    int space;
+    unsigned long settled = 0;
+    tick_t last_write = tick_now();
+    tick_t wait = (tick_t)((double)tick_per_second() * device_fragsize / device_speed / 4);
+    int primed = 0;
+    int q;
+
+    while ((q = __atomic_load_n(&quit, __ATOMIC_ACQUIRE)) != SOUND_THREAD_QUIT) {
+        head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+        fill = head - tail;
+
+        if (fill < (unsigned int)device_fragsize) {
+            if (q == SOUND_THREAD_DRAIN) {
+                if (fill > 0 && sound_thread_play(tail, fill) < 0) {
+                    __atomic_store_n(&failed, 1, __ATOMIC_RELEASE);
+                }
+                __atomic_store_n(&ring_tail, head, __ATOMIC_RELEASE);
+                break;
+            }
+            /* count one underrun per dry spell */
+            if (primed && sound_thread_starving(last_write)) {
+                primed = 0;
+                settled = 0;
+                stat_underruns++;
+                target = __atomic_load_n(&ring_target, __ATOMIC_RELAXED);
+                if (target + device_fragsize <= ring_size) {
+                    target += device_fragsize;
+                    __atomic_store_n(&ring_target, target, __ATOMIC_RELAXED);
+                    if (target > stat_target_max) {
+                        stat_target_max = target;
+                    }
+                }
+            }
+            tick_sleep(wait);
+            continue;
+        }
+
+        /* all whole fragments the device takes at once */
+        frames = fill - fill % device_fragsize;
+        if (device->bufferspace != NULL) {
+            space = device->bufferspace();
+            space -= space % device_fragsize;
+            if (space <= 0) {
+                tick_sleep(wait);
+                continue;
+            }
+            if (frames > (unsigned int)space) {
+                frames = (unsigned int)space;
+            }
+        }
+
+        if (fill < stat_fill_min) {
+            stat_fill_min = fill;
+        }
+        if (fill > stat_fill_max) {
+            stat_fill_max = fill;
+        }
+        stat_fill_sum += fill;
+
+        if (sound_thread_play(tail, frames) < 0) {
+            __atomic_store_n(&failed, 1, __ATOMIC_RELEASE);
+            break;
+        }
+        tail += frames;
+        __atomic_store_n(&ring_tail, tail, __ATOMIC_RELEASE);
+        last_write = tick_now();
+        primed = 1;
+        stat_fragments += frames / device_fragsize;
+        stat_writes++;
+
+        settled += frames;
+        if (settled >= (unsigned long)device_speed * SOUND_THREAD_SETTLE_SECONDS) {
+            settled = 0;
+            target = __atomic_load_n(&ring_target, __ATOMIC_RELAXED);
+            if (target > (unsigned int)device_fragsize) {
+                target -= device_fragsize;
+                __atomic_store_n(&ring_target, target, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* log what the output thread changed, on the emulation thread */
+static void sound_thread_report(void)
+{
+    unsigned int target = __atomic_load_n(&ring_target, __ATOMIC_RELAXED);
+
+    if (target > logged_target) {
+        log_verbose(sound_thread_log, "Underrun, latency target raised to %.2fms.",
+                    sound_thread_ms(target));
+    } else if (target < logged_target) {
+        log_verbose(sound_thread_log, "Latency target lowered to %.2fms.",
+                    sound_thread_ms(target));
+    }
+    logged_target = target;
+
+    if (!logged_failed && __atomic_load_n(&failed, __ATOMIC_ACQUIRE)) {
+        log_error(sound_thread_log, "write to sound device failed.");
+        logged_failed = 1;
+    }
+}
+
+/** \brief  Start playing the sound through the ring
+ *
+ * \param[in]   dev         playback device, only written by the thread now
+ * \param[in]   speed       sample rate
+ * \param[in]   fragsize    fragment size in frames
+ * \param[in]   fragnr      number of fragments in the buffer of the device
+ * \param[in]   channels    number of channels
+ *
+ * \return  0 on success, -1 if the device must be written directly
+ */
+int sound_thread_start(const sound_device_t *dev, int speed, int fragsize, int fragnr, int channels)
+{
+    unsigned int size;
+
+    if (running) {
+        return 0;
+    }
+    if (sound_thread_log == LOG_DEFAULT) {
+        sound_thread_log = log_open("SoundThread");
+    }
+
+    device = dev;
+    device_speed = speed;
+    device_fragsize = fragsize;
+    device_bufsize = fragsize * fragnr;
+    device_channels = channels;
+
+    /* room for the buffer of the device, and a few fragments at least */
+    size = (unsigned int)fragsize * 4;
+    if (size < (unsigned int)device_bufsize) {
+        size = (unsigned int)device_bufsize;
+    }
+    for (ring_size = 1; ring_size < size; ring_size <<= 1) {
+    }
+    ring = lib_malloc(ring_size * channels * sizeof *ring);
+    ring_head = 0;
+    ring_tail = 0;
+    ring_target = fragsize * 2;
+
+    quit = SOUND_THREAD_RUN;
+    failed = 0;
+    stat_fragments = 0;
+    stat_writes = 0;
+    stat_underruns = 0;
+    stat_dropped = 0;
+    stat_fill_min = ring_size;
+    stat_fill_max = 0;
+    stat_fill_sum = 0.0;
+    stat_target_max = ring_target;
+    logged_target = ring_target;
+    logged_failed = 0;
+
+    if (pthread_create(&thread, NULL, sound_thread, NULL) != 0) {
+        log_error(sound_thread_log, "Could not start the sound output thread.");
+        lib_free(ring);
+        ring = NULL;
+        return -1;
+    }
+    running = 1;
+
+    log_message(sound_thread_log, "Playing `%s' on a thread, ring of %.2fms.",
+                dev->name, sound_thread_ms(ring_size));
+    return 0;
+}
+
+/** \brief  Stop the output thread, the device is written directly again
+ *
+ * \param[in]   drain   write what is left in the ring to the device first
+ */
+void sound_thread_stop(int drain)
+{
+    if (!running) {
+        return;
+    }
+
+    __atomic_store_n(&quit, drain ? SOUND_THREAD_DRAIN : SOUND_THREAD_QUIT, __ATOMIC_RELEASE);
+    pthread_join(thread, NULL);
+    running = 0;
+
+    sound_thread_report();
+
+    if (stat_fragments > 0) {
+        log_message(sound_thread_log,
+                    "%lu fragments played, %lu underruns, %lu frames dropped, "
+                    "ring fill %.2f..%.2fms (%.2fms average), latency target %.2fms (max %.2fms).",
+                    stat_fragments, stat_underruns, stat_dropped,
+                    sound_thread_ms(stat_fill_min), sound_thread_ms(stat_fill_max),
+                    stat_fill_sum * 1000.0 / stat_writes / device_speed,
+                    sound_thread_ms(ring_target), sound_thread_ms(stat_target_max));
+    }
+
+    lib_free(ring);
+    ring = NULL;
+    device = NULL;
+}
+
+int sound_thread_is_running(void)
+{
+    return running;
+}
+
+/** \brief  Get the number of frames that may be written now
+ *
+ * Like the bufferspace() function of a device, limited by the latency
+ * target.
+ */
+int sound_thread_bufferspace(void)
+{
+    unsigned int fill;
+    unsigned int target;
+
+    fill = ring_head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+    target = __atomic_load_n(&ring_target, __ATOMIC_RELAXED);
+
+    return fill < target ? (int)(target - fill) : 0;
+}
+
+/** \brief  Queue samples for the output thread
+ *
+ * Like the write() function of a device, \a nr counts the samples of all
+ * channels. What does not fit into the ring is dropped.
+ *
+ * \return  0 on success, non-zero once the thread failed to write to the
+ *          device
+ */
+int sound_thread_write(const int16_t *pbuf, size_t nr)
+{
+    unsigned int frames = (unsigned int)(nr / device_channels);
+    unsigned int head = ring_head;
+    unsigned int room;
+    unsigned int pos;
+    unsigned int part;
+
+    room = ring_size - (head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE));
+    if (frames > room) {
+        stat_dropped += frames - room;
+        frames = room;
+    }
+
+    pos = head & (ring_size - 1);
+    part = ring_size - pos;
+    if (part > frames) {
+        part = frames;
+    }
+    memcpy(ring + pos * device_channels, pbuf, part * device_channels * sizeof *ring);
+    memcpy(ring, pbuf + part * device_channels, (frames - part) * device_channels * sizeof *ring);
+    __atomic_store_n(&ring_head, head + frames, __ATOMIC_RELEASE);
+
+    sound_thread_report();
+
+    return __atomic_load_n(&failed, __ATOMIC_ACQUIRE);
+}
+
+#else
+
+int sound_thread_start(const sound_device_t *dev, int speed, int fragsize, int fragnr, int channels)
+{
+    return -1;
+}
+
+void sound_thread_stop(int drain)
+{
+}
+
+int sound_thread_is_running(void)
+{
+    return 0;
+}
+
+int sound_thread_bufferspace(void)
+{
+    return 0;
+}
+
+int sound_thread_write(const int16_t *pbuf, size_t nr)
+{
+    return -1;
+}
+
+#endif
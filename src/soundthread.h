@@ -0,0 +1,40 @@
+/** \file   soundthread.h
+ * \brief   Play the sound through a ring on a separate thread - header
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_SOUNDTHREAD_H
+#define VICE_SOUNDTHREAD_H
+
+#include <stddef.h>
+
+#include "sound.h"
+#include "types.h"
+
+int sound_thread_start(const sound_device_t *dev, int speed, int fragsize, int fragnr, int channels);
+void sound_thread_stop(int drain);
+int sound_thread_is_running(void);
+int sound_thread_bufferspace(void);
+int sound_thread_write(const int16_t *pbuf, size_t nr);
+
+#endif
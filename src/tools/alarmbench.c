@@ -0,0 +1,138 @@
+/** \file   alarmbench.c
+ * \brief   Micro-benchmark for the alarm queue
+ *
+ * Drives an alarm context the way the CPU loop does: advance the clock to
+ * the next pending alarm, dispatch it, and let the callback reschedule the
+ * alarm while a share of the other alarms is reprogrammed, as chip register
+ * writes do. alarmbench is built with the array scan, alarmbench-heap with
+ * ALARM_HEAP, from the same alarm.c the emulators use:
+ *
+ *   make -C src/tools alarmbench alarmbench-heap
+ *   src/tools/alarmbench && src/tools/alarmbench-heap
+ */
+
+/*
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* pick the implementation regardless of how configure was run */
+#undef ALARM_HEAP
+#ifdef ALARM_BENCH_HEAP
+#define ALARM_HEAP
+#endif
+
+/* alarm.c only needs these from lib.h and log.h, which would pull in the
+   rest of the emulator */
+#define VICE_LIB_H
+#define VICE_LOG_H
+#define LOG_DEFAULT 0
+#define lib_malloc(x) malloc(x)
+#define lib_free(x) free(x)
+#define lib_strdup(x) strdup(x)
+#define log_error(log, ...) fprintf(stderr, __VA_ARGS__)
+
+#include "alarm.c"
+
+#define BENCH_DISPATCHES    20000000
+
+/* one in this many dispatches also reprograms some other alarm */
+#define BENCH_REPROGRAM     4
+
+static alarm_t *alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+static CLOCK periods[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+static CLOCK clk;
+static unsigned int num_alarms;
+static unsigned int rnd = 1;
+
+static unsigned int bench_random(void)
+{
+    rnd = rnd * 1103515245 + 12345;
+    return rnd >> 16;
+}
+
+static void bench_callback(CLOCK offset, void *data)
+{
+    unsigned int i = (unsigned int)(uintptr_t)data;
+
+    alarm_set(alarms[i], clk + periods[i]);
+
+    if ((bench_random() % BENCH_REPROGRAM) == 0) {
+        unsigned int other = bench_random() % num_alarms;
+
+        alarm_set(alarms[other], clk + 1 + bench_random() % (periods[other] * 2));
+    }
+}
+
+static double bench_run(unsigned int num)
+{
+    alarm_context_t *context;
+    struct timespec start, end;
+    unsigned int i;
+    long n;
+
+    context = alarm_context_new("bench");
+    num_alarms = num;
+    clk = 0;
+    rnd = 1;
+
+    for (i = 0; i < num; i++) {
+        alarms[i] = alarm_new(context, "bench", bench_callback, (void *)(uintptr_t)i);
+        /* between a few cycles, like a CIA timer, and a frame */
+        periods[i] = 4 + bench_random() % 20000;
+        alarm_set(alarms[i], periods[i]);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (n = 0; n < BENCH_DISPATCHES; n++) {
+        clk = alarm_context_next_pending_clk(context);
+        alarm_context_dispatch(context, clk);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    alarm_context_destroy(context);
+
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_DISPATCHES;
+}
+
+int main(void)
+{
+    static const unsigned int counts[] = { 4, 8, 16, 32, 64, 128, 255 };
+    unsigned int i;
+
+#ifdef ALARM_HEAP
+    printf("alarm queue: binary heap\n");
+#else
+    printf("alarm queue: array scan\n");
+#endif
+    printf("pending  ns/dispatch\n");
+
+    for (i = 0; i < sizeof counts / sizeof counts[0]; i++) {
+        printf("%7u  %11.2f\n", counts[i], bench_run(counts[i]));
+    }
+
+    return 0;
+}
@@ -36,6 +36,14 @@ typedef struct vice_network_socket_s vice_network_socket_t;
 
 typedef struct vice_network_socket_address_s vice_network_socket_address_t;
 
+/* one piece of the data for vice_network_sendv_nonblocking() */
+typedef struct vice_network_buffer_s {
+    const void *data;
+    size_t length;
+} vice_network_buffer_t;
+
+#define VICE_NETWORK_MAX_BUFFERS 4
+
 vice_network_socket_t * vice_network_server(const vice_network_socket_address_t * server_address);
 vice_network_socket_t * vice_network_client(const vice_network_socket_address_t * server_address);
 
@@ -45,12 +53,17 @@ void vice_network_address_close(vice_network_socket_address_t *);
 vice_network_socket_t * vice_network_accept(vice_network_socket_t * sockfd);
 
 int vice_network_socket_close(vice_network_socket_t * sockfd);
+int vice_network_server_is_listening(const vice_network_socket_address_t * server_address);
 
 ssize_t vice_network_send(vice_network_socket_t * sockfd, const void * buffer, size_t buffer_length, int flags);
+ssize_t vice_network_sendv_nonblocking(vice_network_socket_t * sockfd, const vice_network_buffer_t * buffers, unsigned int count);
 ssize_t vice_network_receive(vice_network_socket_t * sockfd, void * buffer, size_t buffer_length, int flags);
 
 int vice_network_select_poll_one(vice_network_socket_t * readsockfd);
+int vice_network_select_wait_one(vice_network_socket_t * readsockfd, unsigned long timeout_us);
+int vice_network_select_wait_writable(vice_network_socket_t * writesockfd, unsigned long timeout_us);
 int vice_network_select_multiple(vice_network_socket_t ** readsockfd);
+int vice_network_select_multiple_writable(vice_network_socket_t ** readsockfd, vice_network_socket_t ** writesockfd);
 
 int vice_network_get_errorcode(void);
 
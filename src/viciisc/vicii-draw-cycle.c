@@ -33,6 +33,7 @@
 #include "vicii-chip-model.h"
 #include "vicii-draw-cycle.h"
 #include "viciitypes.h"
+#include "vsync.h"
 
 /* disable for debugging */
 #define DRAW_INLINE inline
@@ -676,6 +677,27 @@ void vicii_draw_cycle(void)
         vicii.dbuf_offset = 0;
     }
 
+    if (!vsync_render_this_frame) {
+        /* No pixels are needed, only the sprite collisions.  The graphics
+           sequencer only feeds the sprite-background collisions, and it
+           only keeps state for a few cycles, so it can rest until a sprite
+           is displayed. */
+        if (vicii.sprite_display_bits || sprite_active_bits) {
+            draw_graphics8(cycle_flags_pipe);
+        }
+
+        draw_sprites8(cycle_flags_pipe);
+
+        /* keep the color registers up to date for the next drawn frame */
+        if (last_color_reg != 0xff) {
+            cregs[last_color_reg] = last_color_value;
+        }
+        update_cregs();
+
+        cycle_flags_pipe = vicii.cycle_flags;
+        return;
+    }
+
     draw_graphics8(cycle_flags_pipe);
 
     draw_sprites8(cycle_flags_pipe);
@@ -64,6 +64,7 @@
 #endif
 #include "network.h"
 #include "resources.h"
+#include "screenshot.h"
 #include "sound.h"
 #include "types.h"
 #include "videoarch.h"
@@ -164,6 +165,20 @@ static tick_t warp_render_tick_interval;
 /* Triggers the vice thread to update its priorty */
 static volatile int update_thread_priority = 1;
 
+/* "NoRender" resource.  If nonzero, frames are only drawn when asked for. */
+static int no_render_enabled;
+
+/* Frames still to be drawn in no-render mode, see vsync_request_render(). */
+static int render_frames_requested = 0;
+
+/* Whether the video chips draw the current frame. */
+bool vsync_render_this_frame = true;
+
+/* Frames completed since the last one that was drawn from its first line,
+   see vsync_get_frames_since_drawn(). */
+static unsigned int frames_since_drawn = 0;
+static bool frame_drawn_from_start = true;
+
 static int set_relative_speed(int val, void *param)
 {
     if (val == 0) {
@@ -193,6 +208,72 @@ int vsync_get_warp_mode(void)
     return warp_enabled;
 }
 
+static int set_no_render(int val, void *param)
+{
+    no_render_enabled = val ? 1 : 0;
+
+    if (!no_render_enabled) {
+        vsync_render_this_frame = true;
+    }
+
+    return 0;
+}
+
+/** \brief  Draw frames although the NoRender resource is set
+ *
+ * The frame being emulated is drawn from now on, as are the next \a frames
+ * frames, so a frame which is complete at a later vsync can be read from
+ * the draw buffer.
+ *
+ * \param[in]   frames  number of following frames to draw
+ */
+void vsync_request_render(int frames)
+{
+    vsync_render_this_frame = true;
+
+    if (frames > render_frames_requested) {
+        render_frames_requested = frames;
+    }
+}
+
+/** \brief  Tell how old the frame in the draw buffer is
+ *
+ * With NoRender the draw buffer holds the last frame that was drawn, which
+ * can be much older than the last frame emulated.
+ *
+ * \return 0 if the last completed frame was drawn entirely, else the number
+ *         of frames completed since the last one that was
+ */
+unsigned int vsync_get_frames_since_drawn(void)
+{
+    return frames_since_drawn;
+}
+
+/* Account for the frame that just ended, before the vsync hooks run. */
+static void update_frames_since_drawn(void)
+{
+    if (frame_drawn_from_start) {
+        frames_since_drawn = 0;
+    } else if (frames_since_drawn < UINT_MAX) {
+        frames_since_drawn++;
+    }
+}
+
+/* Decide at vsync whether the next frame is drawn. */
+static void update_render_this_frame(void)
+{
+    if (!no_render_enabled || screenshot_is_recording()) {
+        vsync_render_this_frame = true;
+    } else if (render_frames_requested > 0) {
+        render_frames_requested--;
+        vsync_render_this_frame = true;
+    } else {
+        vsync_render_this_frame = false;
+    }
+
+    frame_drawn_from_start = vsync_render_this_frame;
+}
+
 static int set_initial_warp_mode_resource(int val, void *param)
 {
     initial_warp_mode_resource = val ? 1 : 0;
@@ -207,6 +288,8 @@ static const resource_int_t resources_int[] = {
     { "InitialWarpMode", 0, RES_EVENT_STRICT, (resource_value_t)0,
       /* FIXME: maybe RES_EVENT_NO */
       &initial_warp_mode_resource, set_initial_warp_mode_resource, NULL },
+    { "NoRender", 0, RES_EVENT_NO, NULL,
+      &no_render_enabled, set_no_render, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -241,6 +324,12 @@ static const cmdline_option_t cmdline_options[] =
     { "+warp", CALL_FUNCTION, CMDLINE_ATTRIB_NONE,
       set_initial_warp_mode_cmdline, vice_int_to_ptr(0), NULL, NULL,
       NULL, "Do not initially enable warp mode (default)" },
+    { "-norender", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NoRender", (resource_value_t)1,
+      NULL, "Only draw frames the monitor or a recording asks for" },
+    { "+norender", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "NoRender", (resource_value_t)0,
+      NULL, "Draw every frame (default)" },
     CMDLINE_LIST_END
 };
 
@@ -580,7 +669,10 @@ void vsync_do_end_of_line(void)
 
                 /* If we can't rely on the audio device for timing, slow down here. */
                 if (tick_based_sync_timing) {
-                    mainlock_yield_and_sleep(ticks_until_target);
+                    /* a binmon request cuts the sleep short */
+                    if (!monitor_binary_sleep(ticks_until_target)) {
+                        mainlock_yield_and_sleep(ticks_until_target);
+                    }
                 }
             } else if ((tick_t)0 - ticks_until_target > tick_per_second()) {
                 /* We are more than a second behind, reset sync and accept that we're not running at full speed. */
@@ -668,6 +760,8 @@ void vsync_do_vsync(struct video_canvas_s *c)
     tick_t now;
     tick_t network_hook_time = 0;
 
+    update_frames_since_drawn();
+
     monitor_vsync_hook();
 
     /*
@@ -683,6 +777,8 @@ void vsync_do_vsync(struct video_canvas_s *c)
 
     vsync_hook();
 
+    update_render_this_frame();
+
     if (network_connected()) {
         /* TODO - re-eval if any of this network stuff makes sense */
         network_hook_time = tick_now_delta(network_hook_time);
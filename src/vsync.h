@@ -41,6 +41,8 @@ typedef struct vsync_callback {
 
 struct video_canvas_s;
 
+extern bool vsync_render_this_frame;
+
 void vsync_suspend_speed_eval(void);
 void vsync_reset_hook(void);
 int vsync_resources_init(void);
@@ -55,5 +57,7 @@ void vsync_do_vsync(struct video_canvas_s *c);
 void vsync_on_vsync_do(vsync_callback_func_t callback_func, void *callback_param);
 void vsync_set_warp_mode(int val);
 int vsync_get_warp_mode(void);
+void vsync_request_render(int frames);
+unsigned int vsync_get_frames_since_drawn(void);
 
 #endif